@@ -0,0 +1,26 @@
+#-------------------------------------------------
+#
+# AsyncRendererCheck: checks the bitmap exchange and observer
+# handling of CAsyncMapRenderer while it draws maps continuously.
+#
+#-------------------------------------------------
+
+QT -= core gui
+
+TARGET = AsyncRendererCheck
+TEMPLATE = app
+
+CONFIG += console c++11
+CONFIG -= app_bundle qt
+
+DEFINES += NDEBUG
+
+INCLUDEPATH += ../../main/base
+
+SOURCES += main.cpp
+
+HEADERS += ../../main/base/cartotype_async_renderer.h
+
+unix:!macx: LIBS += -L$$PWD/../../main/single_library/unix/bin/ReleaseLicensed/ -lcartotype -lpthread -ldl
+
+unix:!macx: PRE_TARGETDEPS += $$PWD/../../main/single_library/unix/bin/ReleaseLicensed/libcartotype.a
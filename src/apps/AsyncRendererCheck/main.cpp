@@ -0,0 +1,217 @@
+/*
+AsyncRendererCheck: checks CAsyncMapRenderer while it draws maps continuously.
+
+The user interface thread pans the map, posts each new view to the renderer, and reads the front bitmap after every pan.
+Each front bitmap is checksummed when it is obtained, held until the render thread has published two more maps, and checksummed again;
+the checksums must be equal, because the exchange of the three bitmaps must never let the render thread write into the front bitmap.
+
+Observers are added and removed while the render thread is calling them. One observer removes itself from its third callback and
+adds another observer; a second observer is removed by the main thread while maps are being drawn. Every observer checks that it is
+never called while a call to it is in progress, and never called after it has been removed.
+
+Finally the renderer is allowed to become idle, and its front bitmap must be identical to a map drawn by the user interface framework
+itself, because PostView copies the whole view.
+
+The program prints FAILED and returns 1 if any check fails.
+
+Usage: AsyncRendererCheck <map file> <style sheet> <font> [<number of pans>]
+*/
+
+#include <cartotype_async_renderer.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <thread>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace CartoType;
+
+static const int32 KViewWidth = 512;
+static const int32 KViewHeight = 384;
+
+/** Return a checksum of the pixels of a bitmap. */
+static uint64 Checksum(const TBitmap& aBitmap)
+    {
+    uint64 h = 14695981039346656037ULL;
+    const uint8* p = aBitmap.Data();
+    const uint8* end = p + aBitmap.DataBytes();
+    while (p < end)
+        h = (h ^ *p++) * 1099511628211ULL;
+    return h;
+    }
+
+/** Return the number of pixels that differ between two 32-bit color bitmaps of the same size, or -1 if they are not comparable. */
+static int64 DifferentPixelCount(const TBitmap& aA,const TBitmap& aB)
+    {
+    if (aA.Type() != TBitmap::E32BitColor || aB.Type() != TBitmap::E32BitColor || aA.Width() != aB.Width() || aA.Height() != aB.Height())
+        return -1;
+    int64 n = 0;
+    for (int32 y = 0; y < aA.Height(); y++)
+        {
+        const uint32* a = (const uint32*)(aA.Data() + y * aA.RowBytes());
+        const uint32* b = (const uint32*)(aB.Data() + y * aB.RowBytes());
+        for (int32 x = 0; x < aA.Width(); x++)
+            n += a[x] != b[x];
+        }
+    return n;
+    }
+
+/** An observer which checks when it is called, and can remove itself and add another observer from its callback. */
+class TCheckObserver: public MFrameworkObserver
+    {
+    public:
+    void OnViewChange() override { }
+    void OnMainDataChange() override { }
+    void OnDynamicDataChange() override { }
+
+    void OnMapBitmapReady() override
+        {
+        if (m_in_call.exchange(true))
+            m_error = "called during a call";
+        if (m_removed)
+            m_error = "called after being removed";
+        int count = ++m_call_count;
+        if (m_remove_self_after && count == m_remove_self_after)
+            {
+            m_renderer->RemoveObserver(this);
+            m_removed = true;
+            }
+        if (m_add_other)
+            {
+            m_renderer->AddObserver(m_add_other);
+            m_add_other = nullptr;
+            }
+
+        // Make the call last long enough for removals from the main thread to overlap it.
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        m_in_call = false;
+        }
+
+    CAsyncMapRenderer* m_renderer = nullptr;
+    int m_remove_self_after = 0;
+    TCheckObserver* m_add_other = nullptr;
+    std::atomic<bool> m_in_call { false };
+    std::atomic<bool> m_removed { false };
+    std::atomic<int> m_call_count { 0 };
+    std::atomic<const char*> m_error { nullptr };
+    };
+
+static bool Check(bool aCondition,const char* aText)
+    {
+    if (!aCondition)
+        printf("FAILED: %s\n",aText);
+    return aCondition;
+    }
+
+int main(int argc,char** argv)
+    {
+    if (argc != 4 && argc != 5)
+        {
+        fprintf(stderr,"usage: AsyncRendererCheck <map file> <style sheet> <font> [<number of pans>]\n");
+        return 1;
+        }
+    int pans = argc > 4 ? std::max(20,atoi(argv[4])) : 100;
+
+    TResult error = 0;
+    std::unique_ptr<CFramework> framework = CFramework::New(error,argv[1],argv[2],argv[3],KViewWidth,KViewHeight);
+    if (error)
+        {
+        fprintf(stderr,"error %d creating the framework\n",int(error));
+        return 1;
+        }
+
+    // The observers are declared before the renderer so that they outlive it.
+    TCheckObserver self_removing, removed, added;
+    std::unique_ptr<CAsyncMapRenderer> renderer = CAsyncMapRenderer::New(error,*framework);
+    if (error)
+        {
+        fprintf(stderr,"error %d creating the renderer\n",int(error));
+        return 1;
+        }
+    self_removing.m_renderer = removed.m_renderer = added.m_renderer = renderer.get();
+    self_removing.m_remove_self_after = 3;
+    self_removing.m_add_other = &added;
+    renderer->AddObserver(&self_removing);
+    renderer->AddObserver(&removed);
+
+    std::mt19937 rng(1);
+    int changed_while_in_use = 0;
+    int new_maps = 0;
+    int checked = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < pans && !error; i++)
+        {
+        error = framework->Pan(int(rng() % 41) - 20,int(rng() % 41) - 20);
+        if (!error)
+            error = renderer->PostView(*framework);
+        if (i == pans / 2)
+            {
+            renderer->RemoveObserver(&removed);
+            removed.m_removed = true;
+            }
+
+        bool new_map = false;
+        const TBitmap* bitmap = renderer->FrontBitmap(&new_map);
+        new_maps += new_map;
+        uint64 checksum = bitmap ? Checksum(*bitmap) : 0;
+
+        // Hold the front bitmap, as a user interface does while painting it, until two more maps have been published:
+        // with three bitmaps, that is enough for the render thread to have written into every bitmap except the front one.
+        uint64 map_count = renderer->MapCount();
+        auto hold_start = std::chrono::steady_clock::now();
+        while (renderer->MapCount() < map_count + 2 && std::chrono::steady_clock::now() - hold_start < std::chrono::seconds(5))
+            {
+            renderer->Redraw();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        if (bitmap)
+            {
+            if (Checksum(*bitmap) != checksum)
+                changed_while_in_use++;
+            checked++;
+            }
+        }
+    if (error)
+        {
+        fprintf(stderr,"error %d panning the map\n",int(error));
+        return 1;
+        }
+    renderer->WaitUntilIdle();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    renderer->RemoveObserver(&added);
+    added.m_removed = true;
+
+    bool new_map = false;
+    const TBitmap* front = renderer->FrontBitmap(&new_map);
+    new_maps += new_map;
+    const TBitmap* direct = framework->MapBitmap(error);
+    int64 different = front && direct && !error ? DifferentPixelCount(*front,*direct) : -1;
+
+    printf("%d pans in %.2f seconds: %d maps drawn, %d new front bitmaps, %d front bitmaps checked\n",pans,seconds,int(renderer->MapCount()),new_maps,checked);
+    printf("observer calls: %d to the self-removing observer, %d to the observer removed by the main thread, %d to the added observer\n",
+           int(self_removing.m_call_count),int(removed.m_call_count),int(added.m_call_count));
+
+    bool ok = true;
+    ok &= Check(!renderer->LastError(),"the renderer reported an error");
+    ok &= Check(changed_while_in_use == 0,"a front bitmap changed while it was in use");
+    ok &= Check(new_maps > 0 && uint64(new_maps) <= renderer->MapCount(),"the number of new front bitmaps is not between 1 and the number of maps drawn");
+    ok &= Check(self_removing.m_call_count == 3,"the self-removing observer was not called exactly three times");
+    ok &= Check(removed.m_call_count > 0 && added.m_call_count > 0,"an observer was never called");
+    for (const TCheckObserver* p : { &self_removing,&removed,&added })
+        if (p->m_error)
+            ok &= Check(false,p->m_error);
+    if (different != 0)
+        {
+        printf("FAILED: the final map %s a map drawn by the user interface framework",different < 0 ? "cannot be compared with" : "differs from");
+        if (different > 0)
+            printf(" in %d pixels",int(different));
+        printf("\n");
+        ok = false;
+        }
+    if (ok)
+        printf("passed\n");
+    return ok ? 0 : 1;
+    }
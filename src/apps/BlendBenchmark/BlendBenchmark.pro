@@ -0,0 +1,22 @@
+#-------------------------------------------------
+#
+# BlendBenchmark: measures the fill rate of the span blending
+# functions for each instruction set, using a synthetic dense city tile.
+#
+#-------------------------------------------------
+
+QT -= core gui
+
+TARGET = BlendBenchmark
+TEMPLATE = app
+
+CONFIG += console c++11
+CONFIG -= app_bundle qt
+
+DEFINES += NDEBUG
+
+INCLUDEPATH += ../../main/base
+
+SOURCES += main.cpp
+
+HEADERS += ../../main/base/cartotype_pixel_blend.h
@@ -0,0 +1,257 @@
+/*
+BlendBenchmark: measures the fill rate of TPixelBlender for each instruction set.
+
+A synthetic tile resembling a dense city center is drawn: a background, water and park areas,
+thousands of small anti-aliased buildings, a road network with casings, and label bitmaps.
+The shapes are converted to coverage spans once, so only blending is timed. The results for each
+instruction set are checked against the scalar version, which they must match exactly.
+
+Usage: BlendBenchmark [tile size in pixels] [number of frames]
+*/
+
+#include <cartotype_pixel_blend.h>
+
+#include <chrono>
+#include <random>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+using namespace CartoType;
+
+/** A horizontal run of pixels with a coverage value for each. */
+class TSpan
+    {
+    public:
+    int m_x = 0;
+    int m_y = 0;
+    uint32 m_color = 0;
+    std::vector<uint8> m_coverage;
+    };
+
+/** A premultiplied bitmap blended onto the tile, such as a label. */
+class TLabel
+    {
+    public:
+    int m_x = 0;
+    int m_y = 0;
+    int m_opacity = 255;
+    };
+
+class TScene
+    {
+    public:
+    int m_size = 0;
+    uint32 m_background = 0;
+    std::vector<TSpan> m_span;
+    std::vector<TLabel> m_label;
+    int m_label_width = 64;
+    int m_label_height = 16;
+    std::vector<uint32> m_label_bitmap;
+    };
+
+static uint32 Premultiply(uint32 aRed,uint32 aGreen,uint32 aBlue,uint32 aAlpha)
+    {
+    return (aAlpha << 24) | ((aRed * aAlpha / 255) << 16) | ((aGreen * aAlpha / 255) << 8) | (aBlue * aAlpha / 255);
+    }
+
+/** Add the spans of a convex quadrilateral, using 4 x 4 supersampling for anti-aliasing. */
+static void AddQuad(TScene& aScene,const double* aX,const double* aY,uint32 aColor)
+    {
+    double min_x = aX[0], max_x = aX[0], min_y = aY[0], max_y = aY[0];
+    for (int i = 1; i < 4; i++)
+        {
+        min_x = std::min(min_x,aX[i]); max_x = std::max(max_x,aX[i]);
+        min_y = std::min(min_y,aY[i]); max_y = std::max(max_y,aY[i]);
+        }
+    int x0 = std::max(0,int(floor(min_x))), x1 = std::min(aScene.m_size - 1,int(ceil(max_x)));
+    int y0 = std::max(0,int(floor(min_y))), y1 = std::min(aScene.m_size - 1,int(ceil(max_y)));
+    if (x0 > x1 || y0 > y1)
+        return;
+
+    // Find the winding direction so that the inside test works for either.
+    double area = 0;
+    for (int i = 0; i < 4; i++)
+        area += aX[i] * aY[(i + 1) % 4] - aX[(i + 1) % 4] * aY[i];
+    double sign = area < 0 ? -1 : 1;
+
+    for (int y = y0; y <= y1; y++)
+        {
+        TSpan span;
+        span.m_x = x0;
+        span.m_y = y;
+        span.m_color = aColor;
+        for (int x = x0; x <= x1; x++)
+            {
+            int inside = 0;
+            for (int sy = 0; sy < 4; sy++)
+                for (int sx = 0; sx < 4; sx++)
+                    {
+                    double px = x + (sx + 0.5) / 4, py = y + (sy + 0.5) / 4;
+                    bool in = true;
+                    for (int i = 0; i < 4 && in; i++)
+                        {
+                        int j = (i + 1) % 4;
+                        in = sign * ((aX[j] - aX[i]) * (py - aY[i]) - (aY[j] - aY[i]) * (px - aX[i])) >= 0;
+                        }
+                    inside += in;
+                    }
+            span.m_coverage.push_back(uint8(inside * 255 / 16));
+            }
+
+        // Trim uncovered pixels from the ends.
+        size_t start = 0, end = span.m_coverage.size();
+        while (start < end && !span.m_coverage[start])
+            start++;
+        while (end > start && !span.m_coverage[end - 1])
+            end--;
+        if (start == end)
+            continue;
+        span.m_coverage = std::vector<uint8>(span.m_coverage.begin() + start,span.m_coverage.begin() + end);
+        span.m_x += int(start);
+        aScene.m_span.push_back(std::move(span));
+        }
+    }
+
+/** Add a rectangle of width aWidth and height aHeight centered on aCx, aCy, rotated by aAngle radians. */
+static void AddRotatedRect(TScene& aScene,double aCx,double aCy,double aWidth,double aHeight,double aAngle,uint32 aColor)
+    {
+    double c = cos(aAngle), s = sin(aAngle);
+    double dx[4] = { -aWidth / 2, aWidth / 2, aWidth / 2, -aWidth / 2 };
+    double dy[4] = { -aHeight / 2, -aHeight / 2, aHeight / 2, aHeight / 2 };
+    double x[4], y[4];
+    for (int i = 0; i < 4; i++)
+        {
+        x[i] = aCx + dx[i] * c - dy[i] * s;
+        y[i] = aCy + dx[i] * s + dy[i] * c;
+        }
+    AddQuad(aScene,x,y,aColor);
+    }
+
+/** Add a line of width aWidth from aX0, aY0 to aX1, aY1. */
+static void AddLine(TScene& aScene,double aX0,double aY0,double aX1,double aY1,double aWidth,uint32 aColor)
+    {
+    double length = hypot(aX1 - aX0,aY1 - aY0);
+    AddRotatedRect(aScene,(aX0 + aX1) / 2,(aY0 + aY1) / 2,length,aWidth,atan2(aY1 - aY0,aX1 - aX0),aColor);
+    }
+
+static TScene CreateCityScene(int aSize)
+    {
+    TScene scene;
+    scene.m_size = aSize;
+    scene.m_background = Premultiply(242,239,233,255);
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<double> pos(0,aSize);
+    double scale = aSize / 256.0;
+
+    // A river and some parks, partly transparent.
+    AddLine(scene,-10,aSize * 0.7,aSize + 10,aSize * 0.55,30 * scale,Premultiply(170,211,223,255));
+    for (int i = 0; i < 6; i++)
+        AddRotatedRect(scene,pos(rng),pos(rng),40 * scale,30 * scale,pos(rng),Premultiply(200,250,204,200));
+
+    // Buildings in city blocks, with many small shapes of varying orientation and opacity.
+    int building_count = int(4000 * scale * scale);
+    std::uniform_real_distribution<double> building_size(3 * scale,12 * scale);
+    std::uniform_int_distribution<int> building_alpha(160,255);
+    for (int i = 0; i < building_count; i++)
+        {
+        double angle = (i % 7) * 0.2;
+        AddRotatedRect(scene,pos(rng),pos(rng),building_size(rng),building_size(rng),angle,
+                       Premultiply(217,208,201,uint32(building_alpha(rng))));
+        }
+
+    // Roads: casings drawn first, then fills.
+    std::vector<double> road;
+    for (int i = 0; i < int(120 * scale); i++)
+        {
+        double x0 = pos(rng), y0 = pos(rng);
+        double angle = (rng() % 4) * 1.5707963 + 0.1;
+        double length = 20 * scale + pos(rng) / 2;
+        double width = (1 + rng() % 4) * 2 * scale;
+        road.insert(road.end(),{ x0,y0,x0 + cos(angle) * length,y0 + sin(angle) * length,width });
+        }
+    for (size_t i = 0; i < road.size(); i += 5)
+        AddLine(scene,road[i],road[i + 1],road[i + 2],road[i + 3],road[i + 4] + 2,Premultiply(160,160,160,255));
+    for (size_t i = 0; i < road.size(); i += 5)
+        AddLine(scene,road[i],road[i + 1],road[i + 2],road[i + 3],road[i + 4],Premultiply(255,255,255,255));
+
+    // Labels: an anti-aliased text-like bitmap with a halo, blended with varying opacity.
+    scene.m_label_bitmap.resize(scene.m_label_width * scene.m_label_height);
+    for (int y = 0; y < scene.m_label_height; y++)
+        for (int x = 0; x < scene.m_label_width; x++)
+            {
+            uint32 a = uint32((sin(x * 0.9) * cos(y * 0.7) + 1) * 127);
+            scene.m_label_bitmap[y * scene.m_label_width + x] = (y < 2 || y > 13) ? 0 : Premultiply(40,40,40,a);
+            }
+    for (int i = 0; i < int(60 * scale * scale); i++)
+        {
+        TLabel label;
+        label.m_x = int(pos(rng)) % std::max(1,aSize - scene.m_label_width);
+        label.m_y = int(pos(rng)) % std::max(1,aSize - scene.m_label_height);
+        label.m_opacity = i % 3 ? 255 : 192;
+        scene.m_label.push_back(label);
+        }
+    return scene;
+    }
+
+static void DrawScene(const TScene& aScene,const TPixelBlender& aBlender,std::vector<uint32>& aPixels)
+    {
+    int size = aScene.m_size;
+    aPixels.resize(size_t(size) * size);
+    for (int y = 0; y < size; y++)
+        aBlender.FillSpan(aPixels.data() + size_t(y) * size,size,aScene.m_background);
+    for (const auto& span : aScene.m_span)
+        aBlender.FillSpanWithCoverage(aPixels.data() + size_t(span.m_y) * size + span.m_x,span.m_coverage.data(),span.m_coverage.size(),span.m_color);
+    for (const auto& label : aScene.m_label)
+        for (int y = 0; y < aScene.m_label_height; y++)
+            aBlender.BlendSpan(aPixels.data() + size_t(label.m_y + y) * size + label.m_x,
+                               aScene.m_label_bitmap.data() + y * aScene.m_label_width,aScene.m_label_width,label.m_opacity);
+    }
+
+int main(int argc,char** argv)
+    {
+    int size = argc > 1 ? atoi(argv[1]) : 256;
+    int frames = argc > 2 ? atoi(argv[2]) : 200;
+    if (size < 64 || frames < 1)
+        {
+        fprintf(stderr,"usage: BlendBenchmark [tile size >= 64] [frames >= 1]\n");
+        return 1;
+        }
+
+    TScene scene = CreateCityScene(size);
+    size_t pixels_per_frame = size_t(size) * size;
+    for (const auto& span : scene.m_span)
+        pixels_per_frame += span.m_coverage.size();
+    pixels_per_frame += scene.m_label.size() * scene.m_label_width * scene.m_label_height;
+    printf("tile %dx%d: %d spans, %d labels, %.2f million pixels blended per frame\n",
+           size,size,int(scene.m_span.size()),int(scene.m_label.size()),pixels_per_frame / 1e6);
+
+    typedef TPixelBlender::TInstructionSet TSet;
+    const TSet instruction_set[] = { TSet::Scalar, TSet::SSE2, TSet::AVX2, TSet::Neon };
+    const char* const name[] = { "scalar", "SSE2", "AVX2", "NEON" };
+    std::vector<uint32> reference;
+    DrawScene(scene,TPixelBlender(TSet::Scalar),reference);
+    double scalar_time = 0;
+    int errors = 0;
+    for (int i = 0; i < 4; i++)
+        {
+        if (!TPixelBlender::Supported(instruction_set[i]))
+            continue;
+        TPixelBlender blender(instruction_set[i]);
+        std::vector<uint32> pixels;
+        DrawScene(scene,blender,pixels);
+        bool same = pixels == reference;
+        if (!same)
+            errors++;
+        auto start = std::chrono::steady_clock::now();
+        for (int f = 0; f < frames; f++)
+            DrawScene(scene,blender,pixels);
+        double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / frames;
+        if (i == 0)
+            scalar_time = t;
+        printf("%-7s %8.3f ms/tile %8.1f Mpixel/s  x%.2f%s\n",name[i],t * 1000,pixels_per_frame / t / 1e6,scalar_time / t,same ? "" : "  MISMATCH");
+        }
+    printf("best instruction set: %s\n",name[int(TPixelBlender::BestInstructionSet())]);
+    return errors ? 1 : 0;
+    }
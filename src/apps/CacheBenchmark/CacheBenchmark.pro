@@ -0,0 +1,26 @@
+#-------------------------------------------------
+#
+# CacheBenchmark: compares the list-based CCache with
+# the hashed CHashCache and CShardedHashCache at several sizes.
+#
+#-------------------------------------------------
+
+QT -= core gui
+
+TARGET = CacheBenchmark
+TEMPLATE = app
+
+CONFIG += console c++11
+CONFIG -= app_bundle qt
+
+DEFINES += NDEBUG
+
+INCLUDEPATH += ../../main/base
+
+SOURCES += main.cpp
+
+HEADERS += ../../main/base/cartotype_cache.h
+
+unix:!macx: LIBS += -L$$PWD/../../main/single_library/unix/bin/ReleaseLicensed/ -lcartotype -lpthread -ldl
+
+unix:!macx: PRE_TARGETDEPS += $$PWD/../../main/single_library/unix/bin/ReleaseLicensed/libcartotype.a
@@ -0,0 +1,131 @@
+/*
+CacheBenchmark: measures finding and adding items in CCache, CHashCache and CShardedHashCache
+holding 100, 10,000 and 1,000,000 items.
+
+Each cache is filled to its maximum size, then items are found using random keys, all of which are present,
+and then new items are added, each of which causes the least recently used item to be discarded.
+CCache searches a list, so it is given fewer lookups for the larger sizes to keep the running time reasonable.
+CShardedHashCache divides its maximum size equally between its shards, so when keys are not spread quite evenly
+a few items are discarded while filling it, and some lookups do not find their items.
+CShardedHashCache is also measured with several threads finding items at once.
+
+Usage: CacheBenchmark [number of threads]
+*/
+
+#include <cartotype_cache.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace CartoType;
+
+/** An item of size 1 with an integer key. */
+class TTestItem
+    {
+    public:
+    explicit TTestItem(uint32 aKey): m_key(aKey) { }
+    uint32 Key() const { return m_key; }
+    int32 Size() const { return 1; }
+
+    private:
+    uint32 m_key;
+    };
+
+typedef std::chrono::steady_clock TClock;
+
+static double NanosecondsPerOp(TClock::time_point aStart,size_t aOps)
+    {
+    return std::chrono::duration<double,std::nano>(TClock::now() - aStart).count() / double(aOps);
+    }
+
+/** Random keys of items in a cache holding the keys 0...aCount - 1. */
+static std::vector<uint32> RandomKeys(size_t aCount,size_t aKeys)
+    {
+    std::mt19937 rng(1234);
+    std::vector<uint32> key_array(aKeys);
+    for (auto& k : key_array)
+        k = uint32(rng() % aCount);
+    return key_array;
+    }
+
+/** Time finding and adding items in a cache of type TCache, which owns raw pointers or holds shared pointers according to aAddItem. */
+template<class TCache,class TAddItem> static void Measure(const char* aName,TCache& aCache,size_t aCount,size_t aLookups,TAddItem aAddItem)
+    {
+    for (size_t i = 0; i < aCount; i++)
+        aAddItem(aCache,uint32(i));
+    std::vector<uint32> key_array = RandomKeys(aCount,aLookups);
+
+    size_t found = 0;
+    auto start = TClock::now();
+    for (uint32 k : key_array)
+        found += aCache.Find(k) != nullptr;
+    double find_time = NanosecondsPerOp(start,aLookups);
+
+    size_t adds = std::min(aLookups,aCount);
+    start = TClock::now();
+    for (size_t i = 0; i < adds; i++)
+        aAddItem(aCache,uint32(aCount + i));
+    double add_time = NanosecondsPerOp(start,adds);
+
+    printf("  %-20s find %12.1f ns (%d lookups, %d found), add with discard %8.1f ns\n",aName,find_time,int(aLookups),int(found),add_time);
+    }
+
+/** Time finding items in a CShardedHashCache from several threads at once, returning the total number of lookups per second. */
+static double MeasureThreads(size_t aCount,size_t aLookups,size_t aThreadCount)
+    {
+    int32 max_size = int32(aCount);
+    CShardedHashCache<TTestItem,uint32> cache(max_size);
+    for (size_t i = 0; i < aCount; i++)
+        cache.Add(std::make_shared<TTestItem>(uint32(i)));
+    std::vector<uint32> key_array = RandomKeys(aCount,aLookups);
+    std::atomic<size_t> found(0);
+    auto start = TClock::now();
+    std::vector<std::thread> thread_array;
+    for (size_t t = 0; t < aThreadCount; t++)
+        thread_array.emplace_back([&,t]()
+            {
+            size_t n = 0;
+            for (size_t i = t; i < key_array.size(); i += aThreadCount)
+                n += cache.Find(key_array[i]) != nullptr;
+            found += n;
+            });
+    for (auto& t : thread_array)
+        t.join();
+    return double(aLookups) / std::chrono::duration<double>(TClock::now() - start).count();
+    }
+
+int main(int argc,char** argv)
+    {
+    size_t thread_count = argc > 1 ? size_t(std::max(1,atoi(argv[1]))) : std::max(1u,std::min(8u,std::thread::hardware_concurrency()));
+    const size_t KLookups = 1000000;
+
+    for (size_t count : { size_t(100),size_t(10000),size_t(1000000) })
+        {
+        printf("%d items\n",int(count));
+        int32 max_size = int32(count);
+
+        // Searching the list takes time proportional to the position of the item, so use fewer lookups for larger caches.
+        CCache<TTestItem,uint32> list_cache(max_size);
+        Measure("CCache",list_cache,count,std::max(size_t(200),size_t(200000000) / count / 10),
+                [](CCache<TTestItem,uint32>& aCache,uint32 aKey) { aCache.Add(new TTestItem(aKey)); });
+
+        CHashCache<TTestItem,uint32> hash_cache(max_size);
+        Measure("CHashCache",hash_cache,count,KLookups,
+                [](CHashCache<TTestItem,uint32>& aCache,uint32 aKey) { aCache.Add(new TTestItem(aKey)); });
+
+        CShardedHashCache<TTestItem,uint32> sharded_cache(max_size);
+        Measure("CShardedHashCache",sharded_cache,count,KLookups,
+                [](CShardedHashCache<TTestItem,uint32>& aCache,uint32 aKey) { aCache.Add(std::make_shared<TTestItem>(aKey)); });
+
+        double one = MeasureThreads(count,KLookups * 4,1);
+        double many = MeasureThreads(count,KLookups * 4,thread_count);
+        printf("  %-20s %.1f million lookups per second on 1 thread, %.1f million on %d thread(s)\n","CShardedHashCache",one / 1e6,many / 1e6,int(thread_count));
+        }
+    return 0;
+    }
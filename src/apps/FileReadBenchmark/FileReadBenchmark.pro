@@ -0,0 +1,33 @@
+#-------------------------------------------------
+#
+# FileReadBenchmark: measures cold-cache reads of scattered
+# map data blocks, one at a time and in batches using io_uring,
+# and cold-cache tile rendering with and without a batched prefetch.
+#
+#-------------------------------------------------
+
+QT -= core gui
+
+TARGET = FileReadBenchmark
+TEMPLATE = app
+
+CONFIG += console c++11
+CONFIG -= app_bundle qt
+
+DEFINES += NDEBUG
+
+# io_uring needs liburing; remove these lines to measure positional reads only.
+linux: DEFINES += CARTOTYPE_IO_URING
+linux: LIBS += -luring
+
+INCLUDEPATH += ../../main/base
+
+SOURCES += main.cpp
+
+HEADERS += ../../main/base/cartotype_framework.h \
+    ../../main/base/cartotype_io_uring_reader.h \
+    ../../main/base/cartotype_prefetch.h
+
+unix:!macx: LIBS += -L$$PWD/../../main/single_library/unix/bin/ReleaseLicensed/ -lcartotype -lpthread -ldl
+
+unix:!macx: PRE_TARGETDEPS += $$PWD/../../main/single_library/unix/bin/ReleaseLicensed/libcartotype.a
@@ -0,0 +1,317 @@
+/*
+FileReadBenchmark: measures cold-cache reading of map data, one block at a time and in batches.
+
+The first part reads groups of scattered blocks from a file, imitating the dozens of blocks touched when a tile is drawn,
+after removing the file from the page cache. Each group is read by seeking and reading each block, by positional reads
+(CBinaryInputFile::ReadBatch), and by CIoUringFileReader, which submits the whole group at once when io_uring is available.
+
+The second part, used if a style sheet and font are given, draws tiles around a point after removing the map from the page cache,
+then finds the blocks those tiles read, using mincore, and draws the same tiles after removing the map from the page cache again
+and prefetching those blocks with each read method. It also draws them from a warm cache. The difference between the cold and warm
+times is the I/O cost of drawing, which a batched prefetch of the blocks for the next view can hide. The last run does the prefetch
+using CFilePrefetcher with TPrefetchTarget::PageCache, as an application would while the user is panning.
+
+This program works on Linux only, because it uses posix_fadvise and mincore to control and inspect the page cache.
+
+Usage: FileReadBenchmark <map file> [<style sheet> <font> <longitude> <latitude> <zoom> [<tiles>]]
+*/
+
+#include <cartotype_framework.h>
+#include <cartotype_io_uring_reader.h>
+#include <cartotype_prefetch.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace CartoType;
+
+static const size_t KBlockSize = 64 * 1024;
+static const size_t KBlocksPerTile = 48;
+static const size_t KTileCount = 64;
+
+/** Remove a file from the page cache. */
+static void DropFromCache(const char* aFileName)
+    {
+    int fd = open(aFileName,O_RDONLY);
+    if (fd < 0)
+        return;
+    posix_fadvise(fd,0,0,POSIX_FADV_DONTNEED);
+    close(fd);
+    }
+
+/** Return the positions of the blocks of a file which are in the page cache. */
+static std::vector<int64> ResidentBlocks(const char* aFileName)
+    {
+    std::vector<int64> position_array;
+    int fd = open(aFileName,O_RDONLY);
+    if (fd < 0)
+        return position_array;
+    off_t length = lseek(fd,0,SEEK_END);
+    void* map = length > 0 ? mmap(nullptr,size_t(length),PROT_READ,MAP_SHARED,fd,0) : MAP_FAILED;
+    if (map != MAP_FAILED)
+        {
+        size_t page_size = size_t(sysconf(_SC_PAGESIZE));
+        std::vector<unsigned char> resident((size_t(length) + page_size - 1) / page_size);
+        if (!mincore(map,size_t(length),resident.data()))
+            {
+            size_t pages_per_block = KBlockSize / page_size;
+            for (size_t i = 0; i < resident.size(); i++)
+                if ((resident[i] & 1) && (position_array.empty() || position_array.back() != int64(i / pages_per_block * KBlockSize)))
+                    position_array.push_back(int64(i / pages_per_block * KBlockSize));
+            }
+        munmap(map,size_t(length));
+        }
+    close(fd);
+    return position_array;
+    }
+
+/** A way of reading a group of blocks. */
+class TReadMethod
+    {
+    public:
+    const char* m_name;
+    std::function<void(CBinaryInputFile&,TFileReadRequest*,size_t)> m_read;
+    };
+
+static std::vector<TReadMethod> ReadMethods()
+    {
+    std::vector<TReadMethod> method_array;
+    method_array.push_back(TReadMethod { "seek and read",[](CBinaryInputFile& aFile,TFileReadRequest* aRequest,size_t aCount)
+        {
+        for (size_t i = 0; i < aCount; i++)
+            aRequest[i].iBytesRead = aFile.Seek(aRequest[i].iPosition,SEEK_SET) ? 0 : aFile.Read(aRequest[i].iBuffer,aRequest[i].iSize);
+        } });
+    method_array.push_back(TReadMethod { "positional reads",[](CBinaryInputFile& aFile,TFileReadRequest* aRequest,size_t aCount)
+        {
+        aFile.ReadBatch(aRequest,aCount);
+        } });
+    method_array.push_back(TReadMethod { CIoUringFileReader::UsingIoUring() ? "io_uring batch" : "batch (no io_uring)",
+        [](CBinaryInputFile& aFile,TFileReadRequest* aRequest,size_t aCount)
+        {
+        CIoUringFileReader::ReadBatch(aFile,aRequest,aCount);
+        } });
+    return method_array;
+    }
+
+/** Read groups of blocks at the positions in aGroup using aMethod, and return the time taken in seconds. */
+static double ReadGroups(CBinaryInputFile& aFile,const TReadMethod& aMethod,const std::vector<std::vector<int64>>& aGroup,size_t& aBytesRead)
+    {
+    std::vector<uint8> buffer(KBlockSize * KBlocksPerTile);
+    std::vector<TFileReadRequest> request_array;
+    aBytesRead = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (const auto& group : aGroup)
+        {
+        for (size_t i = 0; i < group.size(); i += KBlocksPerTile)
+            {
+            request_array.clear();
+            for (size_t j = i; j < group.size() && j < i + KBlocksPerTile; j++)
+                {
+                TFileReadRequest r;
+                r.iBuffer = buffer.data() + (j - i) * KBlockSize;
+                r.iSize = KBlockSize;
+                r.iPosition = group[j];
+                request_array.push_back(r);
+                }
+            aMethod.m_read(aFile,request_array.data(),request_array.size());
+            for (const auto& r : request_array)
+                aBytesRead += r.iBytesRead;
+            }
+        }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+/** Time cold-cache reads of scattered groups of blocks, each group imitating the blocks read for one tile. */
+static bool ReadBenchmark(const char* aFileName,CBinaryInputFile& aFile,int64 aLength)
+    {
+    std::vector<std::vector<int64>> group_array(KTileCount);
+    std::mt19937 rng(1234);
+    int64 block_count = std::max(int64(1),aLength / int64(KBlockSize));
+    for (auto& group : group_array)
+        {
+        // Each tile's blocks are clustered within a sixteenth of the file, as blocks for nearby objects tend to be.
+        int64 cluster = std::max(int64(1),block_count / 16);
+        int64 base = int64(rng() % uint64(block_count));
+        for (size_t i = 0; i < KBlocksPerTile; i++)
+            group.push_back(std::min(block_count - 1,base + int64(rng() % uint64(cluster))) * int64(KBlockSize));
+        }
+
+    printf("cold-cache reads: %d groups of %d scattered %d KB blocks from a %.1f MB file\n",
+           int(KTileCount),int(KBlocksPerTile),int(KBlockSize / 1024),double(aLength) / (1024 * 1024));
+    size_t expected_bytes = 0;
+    for (const auto& method : ReadMethods())
+        {
+        DropFromCache(aFileName);
+        size_t bytes = 0;
+        double time = ReadGroups(aFile,method,group_array,bytes);
+        if (expected_bytes && bytes != expected_bytes)
+            {
+            printf("%s read %d bytes rather than %d\n",method.m_name,int(bytes),int(expected_bytes));
+            return false;
+            }
+        expected_bytes = bytes;
+        printf("  %-20s %8.1f ms, %6.1f us per block\n",method.m_name,time * 1000,time * 1e6 / double(KTileCount * KBlocksPerTile));
+        }
+    return true;
+    }
+
+static int TileX(double aLong,int aZoom)
+    {
+    int n = 1 << aZoom;
+    int x = (int)floor((aLong + 180.0) / 360.0 * n);
+    return std::max(0,std::min(n - 1,x));
+    }
+
+static int TileY(double aLat,int aZoom)
+    {
+    int n = 1 << aZoom;
+    double lat = std::max(-85.0511,std::min(85.0511,aLat)) * KPiDouble / 180.0;
+    int y = (int)floor((1.0 - log(tan(lat) + 1.0 / cos(lat)) / KPiDouble) / 2.0 * n);
+    return std::max(0,std::min(n - 1,y));
+    }
+
+/** A tile to be drawn. */
+class TTile
+    {
+    public:
+    int m_x;
+    int m_y;
+    };
+
+/** Draw the tiles and return the time taken in seconds, or a negative number on error. */
+static double DrawTiles(CFramework& aFramework,int aZoom,const std::vector<TTile>& aTile)
+    {
+    auto start = std::chrono::steady_clock::now();
+    for (const auto& tile : aTile)
+        {
+        TResult error = 0;
+        aFramework.TileBitmap(error,256,aZoom,tile.m_x,tile.m_y);
+        if (error)
+            {
+            fprintf(stderr,"error %d drawing tile %d/%d/%d\n",int(error),aZoom,tile.m_x,tile.m_y);
+            return -1;
+            }
+        }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+/** Time cold-cache tile drawing, with and without a batched prefetch of the blocks that the tiles read. */
+static bool DrawBenchmark(char** aArg,int aArgCount)
+    {
+    const char* map_file = aArg[0];
+    double longitude = atof(aArg[3]);
+    double latitude = atof(aArg[4]);
+    int zoom = std::max(0,std::min(24,atoi(aArg[5])));
+    int tile_count = std::max(1,std::min(1024,aArgCount > 6 ? atoi(aArg[6]) : 16));
+
+    // Take the tiles in a square around the point.
+    std::vector<TTile> tile_array;
+    int side = int(ceil(sqrt(double(tile_count))));
+    int n = 1 << zoom;
+    int x0 = TileX(longitude,zoom) - side / 2, y0 = TileY(latitude,zoom) - side / 2;
+    for (int i = 0; i < side * side && int(tile_array.size()) < tile_count; i++)
+        {
+        int x = x0 + i % side, y = y0 + i / side;
+        if (x >= 0 && x < n && y >= 0 && y < n)
+            tile_array.push_back(TTile { x,y });
+        }
+
+    // A new framework is used for each run so that no map data is left in its own buffers.
+    auto new_framework = [&]()
+        {
+        TResult error = 0;
+        std::unique_ptr<CFramework> framework = CFramework::New(error,map_file,aArg[1],aArg[2],256,256);
+        if (error)
+            fprintf(stderr,"error %d creating the framework\n",int(error));
+        return framework;
+        };
+
+    printf("\ncold-cache drawing: %d tiles at zoom %d\n",int(tile_array.size()),zoom);
+    std::unique_ptr<CFramework> framework = new_framework();
+    if (!framework)
+        return false;
+    DropFromCache(map_file);
+    double cold_time = DrawTiles(*framework,zoom,tile_array);
+    if (cold_time < 0)
+        return false;
+    std::vector<int64> block_array = ResidentBlocks(map_file);
+    printf("  %-28s %8.1f ms, %d blocks read\n","cold",cold_time * 1000,int(block_array.size()));
+
+    framework = new_framework();
+    double warm_time = framework ? DrawTiles(*framework,zoom,tile_array) : -1;
+    if (warm_time < 0)
+        return false;
+    printf("  %-28s %8.1f ms\n","warm",warm_time * 1000);
+
+    CBinaryInputFile file;
+    if (file.Open(map_file))
+        return false;
+    std::vector<std::vector<int64>> group_array(1,block_array);
+    for (const auto& method : ReadMethods())
+        {
+        framework = new_framework();
+        if (!framework)
+            return false;
+        DropFromCache(map_file);
+        size_t bytes = 0;
+        double read_time = ReadGroups(file,method,group_array,bytes);
+        double draw_time = DrawTiles(*framework,zoom,tile_array);
+        if (draw_time < 0)
+            return false;
+        std::string name = std::string("prefetch by ") + method.m_name;
+        printf("  %-28s %8.1f ms (prefetch %.1f ms, drawing %.1f ms)\n",name.c_str(),(read_time + draw_time) * 1000,read_time * 1000,draw_time * 1000);
+        }
+
+    // Prefetch on the background thread of CFilePrefetcher, waiting for it to finish so that the times can be compared.
+    framework = new_framework();
+    if (!framework)
+        return false;
+    DropFromCache(map_file);
+    auto start = std::chrono::steady_clock::now();
+        {
+        CFilePrefetcher prefetcher(CSharedFileBufferCache::Global(),block_array.size(),TPrefetchTarget::PageCache);
+        for (int64 pos : block_array)
+            prefetcher.Prefetch(map_file,pos,KBlockSize);
+        while (prefetcher.LoadedCount() < block_array.size() && std::chrono::steady_clock::now() - start < std::chrono::seconds(10))
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    double read_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double draw_time = DrawTiles(*framework,zoom,tile_array);
+    if (draw_time < 0)
+        return false;
+    printf("  %-28s %8.1f ms (prefetch %.1f ms, drawing %.1f ms)\n","prefetch by CFilePrefetcher",(read_time + draw_time) * 1000,read_time * 1000,draw_time * 1000);
+    return true;
+    }
+
+int main(int argc,char** argv)
+    {
+    if (argc != 2 && argc != 7 && argc != 8)
+        {
+        fprintf(stderr,"usage: FileReadBenchmark <map file> [<style sheet> <font> <longitude> <latitude> <zoom> [<tiles>]]\n");
+        return 1;
+        }
+
+    CBinaryInputFile file;
+    int64 length = 0;
+    if (file.Open(argv[1]) || file.Seek(0,SEEK_END) || (length = file.Tell()) <= 0)
+        {
+        fprintf(stderr,"cannot read %s\n",argv[1]);
+        return 1;
+        }
+
+    bool ok = ReadBenchmark(argv[1],file,length);
+    if (ok && argc > 2)
+        ok = DrawBenchmark(argv + 1,argc - 1);
+    return ok ? 0 : 1;
+    }
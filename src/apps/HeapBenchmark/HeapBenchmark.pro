@@ -0,0 +1,26 @@
+#-------------------------------------------------
+#
+# HeapBenchmark: compares the open sets used by TDijkstra:
+# CPointerTree, CIndexedHeap and CRadixHeap, on grid graphs.
+#
+#-------------------------------------------------
+
+QT -= core gui
+
+TARGET = HeapBenchmark
+TEMPLATE = app
+
+CONFIG += console c++11
+CONFIG -= app_bundle qt
+
+DEFINES += NDEBUG
+
+INCLUDEPATH += ../../main/base
+
+SOURCES += main.cpp
+
+HEADERS += ../../main/base/cartotype_graph.h
+
+unix:!macx: LIBS += -L$$PWD/../../main/single_library/unix/bin/ReleaseLicensed/ -lcartotype -lpthread -ldl
+
+unix:!macx: PRE_TARGETDEPS += $$PWD/../../main/single_library/unix/bin/ReleaseLicensed/libcartotype.a
@@ -0,0 +1,176 @@
+/*
+HeapBenchmark: measures TDijkstra using each of its open set classes: CPointerTree, the original open set,
+CIndexedHeap and CRadixHeap.
+
+The graph is a square grid, like a street network, with arcs in both directions between neighbouring nodes,
+and random arc costs. For each open set, routes are calculated from a number of random start nodes to every node,
+which is the work done by isochrones, cost matrices and landmark table creation. The costs found must be the same
+whichever open set is used.
+
+Usage: HeapBenchmark [grid side] [number of start nodes]
+*/
+
+#include <cartotype_graph.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace CartoType;
+
+/** A node, with the members needed by all the open sets. */
+class TTestNode
+    {
+    public:
+    uint32 Key() const { return iCost; }
+    static int CompareKeys(uint32 aA,uint32 aB) { return aA < aB ? -1 : (aA > aB ? 1 : 0); }
+
+    uint32 iCost = 0;
+    uint32 iPrevious = 0;      // one more than the index of the previous arc, or zero if the node has not been reached
+    bool iClosed = false;
+    uint32 iIndex = 0;
+    uint32 iHeapIndex = 0;
+    TTestNode* iLeft = nullptr;
+    TTestNode* iRight = nullptr;
+    TTestNode* iParent = nullptr;
+    };
+
+/** An arc to the node with index m_end. */
+class TTestArc
+    {
+    public:
+    uint32 m_end;
+    uint32 m_cost;
+    };
+
+/** A grid graph providing the functions needed by TDijkstra. Only outgoing arcs are supported. */
+class TTestGraph
+    {
+    public:
+    TTestGraph(int32 aSide)
+        {
+        std::mt19937 rng(1234);
+        size_t node_count = size_t(aSide) * aSide;
+        m_node.resize(node_count);
+        m_first_arc.resize(node_count + 1);
+        for (int32 y = 0; y < aSide; y++)
+            for (int32 x = 0; x < aSide; x++)
+                {
+                uint32 i = uint32(y * aSide + x);
+                m_node[i].iIndex = i;
+                m_first_arc[i] = uint32(m_arc.size());
+                const int32 dx[] = { 1, -1, 0, 0 };
+                const int32 dy[] = { 0, 0, 1, -1 };
+                for (int32 d = 0; d < 4; d++)
+                    {
+                    int32 nx = x + dx[d], ny = y + dy[d];
+                    if (nx >= 0 && nx < aSide && ny >= 0 && ny < aSide)
+                        m_arc.push_back(TTestArc { uint32(ny * aSide + nx),uint32(10 + rng() % 990) });
+                    }
+                }
+        m_first_arc[node_count] = uint32(m_arc.size());
+        }
+
+    class TArcIterator
+        {
+        public:
+        TArcIterator(TTestGraph& aGraph,uint32 aNode):
+            m_graph(aGraph),
+            m_arc(aGraph.m_first_arc[aNode] - 1),
+            m_end(aGraph.m_first_arc[aNode + 1])
+            {
+            }
+        bool Next(TResult& aError)
+            {
+            aError = KErrorNone;
+            while (++m_arc < m_end)
+                if (!m_graph.m_node[m_graph.m_arc[m_arc].m_end].iClosed)
+                    return true;
+            return false;
+            }
+        uint32 Arc() const { return m_arc + 1; }
+        uint32 Cost() const { return m_graph.m_arc[m_arc].m_cost; }
+        TTestNode* EndNode() const { return &m_graph.m_node[m_graph.m_arc[m_arc].m_end]; }
+
+        private:
+        TTestGraph& m_graph;
+        uint32 m_arc;
+        uint32 m_end;
+        };
+
+    void Reset()
+        {
+        for (auto& n : m_node)
+            {
+            n.iPrevious = 0;
+            n.iClosed = false;
+            }
+        }
+    void Set(TTestNode* aNode,uint32 aCost,uint32 aPrevArc) { aNode->iCost = aCost; aNode->iPrevious = aPrevArc; }
+    void Close(TTestNode* aNode) { aNode->iClosed = true; }
+    uint32 Cost(TTestNode* aNode) const { return aNode->iCost; }
+    uint32 Previous(TTestNode* aNode) const { return aNode->iPrevious; }
+    TArcIterator ArcIterator(TTestNode* aNode,bool /*aOutgoing*/) { return TArcIterator(*this,aNode->iIndex); }
+    size_t NodeCount() const { return m_node.size(); }
+    TTestNode* Node(size_t aIndex) { return &m_node[aIndex]; }
+
+    private:
+    std::vector<TTestNode> m_node;
+    std::vector<TTestArc> m_arc;
+    std::vector<uint32> m_first_arc;
+    };
+
+/** Calculate routes from each start node to all nodes using the open set TOpenSet, returning the time in milliseconds and appending the costs to aCost. */
+template<class TOpenSet> static double Measure(TTestGraph& aGraph,const std::vector<uint32>& aStart,std::vector<uint32>& aCost)
+    {
+    TDijkstra<TTestGraph,TTestNode,uint32,TOpenSet> dijkstra(aGraph,false,true);
+    double time = 0;
+    for (uint32 start : aStart)
+        {
+        auto t0 = std::chrono::steady_clock::now();
+        TResult error = dijkstra.CalculateRoutes(aGraph.Node(start),INT32_MAX);
+        time += std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now() - t0).count();
+        if (error)
+            {
+            fprintf(stderr,"error %d\n",int(error));
+            exit(1);
+            }
+        for (size_t i = 0; i < aGraph.NodeCount(); i++)
+            aCost.push_back(aGraph.Node(i)->iCost);
+        }
+    return time / double(aStart.size());
+    }
+
+int main(int argc,char** argv)
+    {
+    int32 side = argc > 1 ? std::max(2,atoi(argv[1])) : 0;
+    int32 start_count = argc > 2 ? std::max(1,atoi(argv[2])) : 5;
+    std::vector<int32> side_array;
+    if (side)
+        side_array.push_back(side);
+    else
+        side_array = { 100,300,1000 };
+
+    for (int32 s : side_array)
+        {
+        TTestGraph graph(s);
+        std::mt19937 rng(5678);
+        std::vector<uint32> start_array(start_count);
+        for (auto& n : start_array)
+            n = uint32(rng() % graph.NodeCount());
+
+        std::vector<uint32> tree_cost, indexed_cost, radix_cost;
+        double tree_time = Measure<CPointerTree<TTestNode,uint32>>(graph,start_array,tree_cost);
+        double indexed_time = Measure<CIndexedHeap<TTestNode,uint32>>(graph,start_array,indexed_cost);
+        double radix_time = Measure<CRadixHeap<TTestNode>>(graph,start_array,radix_cost);
+        bool same = tree_cost == indexed_cost && tree_cost == radix_cost;
+        printf("%d nodes: CPointerTree %.2f ms, CIndexedHeap %.2f ms, CRadixHeap %.2f ms per search%s\n",
+               int(graph.NodeCount()),tree_time,indexed_time,radix_time,same ? "" : " - COSTS DIFFER");
+        if (!same)
+            return 1;
+        }
+    return 0;
+    }
@@ -0,0 +1,26 @@
+#-------------------------------------------------
+#
+# IncrementalViewCheck: checks that the map drawn incrementally
+# by CIncrementalMapView matches a full redraw after each pan.
+#
+#-------------------------------------------------
+
+QT -= core gui
+
+TARGET = IncrementalViewCheck
+TEMPLATE = app
+
+CONFIG += console c++11
+CONFIG -= app_bundle qt
+
+DEFINES += NDEBUG
+
+INCLUDEPATH += ../../main/base
+
+SOURCES += main.cpp
+
+HEADERS += ../../main/base/cartotype_incremental_view.h
+
+unix:!macx: LIBS += -L$$PWD/../../main/single_library/unix/bin/ReleaseLicensed/ -lcartotype -lpthread -ldl
+
+unix:!macx: PRE_TARGETDEPS += $$PWD/../../main/single_library/unix/bin/ReleaseLicensed/libcartotype.a
@@ -0,0 +1,154 @@
+/*
+IncrementalViewCheck: checks that CIncrementalMapView draws the same map as a full redraw.
+
+The map is panned by a mixture of small, medium and nearly full-view distances in random directions. After each pan the map
+without labels, as kept by the incremental view, is compared pixel by pixel with the whole view drawn without labels by
+CFramework::TileBitmap. When the pan was done incrementally, the area drawn must be exactly the strips exposed by the pan.
+Labels are not compared, because the incremental view deliberately keeps the labels already shown instead of placing them again.
+
+Antialiasing can make pixels on the edges of the strips differ slightly from a full redraw; the tolerance is the largest
+difference allowed in any color channel, and is zero by default.
+
+The program prints FAILED and returns 1 if any check fails.
+
+Usage: IncrementalViewCheck <map file> <style sheet> <font> [<number of pans> [<tolerance>]]
+*/
+
+#include <cartotype_incremental_view.h>
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace CartoType;
+
+static const int32 KViewWidth = 512;
+static const int32 KViewHeight = 384;
+
+/** Return the number of pixels of two 32-bit color bitmaps of the same size that differ by more than aTolerance in any channel, and the largest difference. */
+static int64 DifferentPixelCount(const TBitmap& aA,const TBitmap& aB,int aTolerance,int& aMaxDifference)
+    {
+    int64 n = 0;
+    for (int32 y = 0; y < aA.Height(); y++)
+        {
+        const uint8* a = aA.Data() + y * aA.RowBytes();
+        const uint8* b = aB.Data() + y * aB.RowBytes();
+        for (int32 x = 0; x < aA.Width(); x++, a += 4, b += 4)
+            {
+            int difference = 0;
+            for (int i = 0; i < 4; i++)
+                difference = std::max(difference,abs(int(a[i]) - int(b[i])));
+            aMaxDifference = std::max(aMaxDifference,difference);
+            n += difference > aTolerance;
+            }
+        }
+    return n;
+    }
+
+int main(int argc,char** argv)
+    {
+    if (argc < 4 || argc > 6)
+        {
+        fprintf(stderr,"usage: IncrementalViewCheck <map file> <style sheet> <font> [<number of pans> [<tolerance>]]\n");
+        return 1;
+        }
+    int pans = argc > 4 ? std::max(1,atoi(argv[4])) : 200;
+    int tolerance = argc > 5 ? std::max(0,atoi(argv[5])) : 0;
+
+    TResult error = 0;
+    std::unique_ptr<CFramework> framework = CFramework::New(error,argv[1],argv[2],argv[3],KViewWidth,KViewHeight);
+    std::unique_ptr<CIncrementalMapView> view;
+    if (!error)
+        view = CIncrementalMapView::New(error,*framework);
+    if (!error)
+        view->MapBitmap(error);
+    if (error)
+        {
+        fprintf(stderr,"error %d creating the view\n",int(error));
+        return 1;
+        }
+
+    // The reference is drawn without labels by sending them to a label handler which discards them.
+    std::vector<TDisplayLabel> discarded_label;
+    TDisplayLabelCollector label_discarder(discarded_label);
+    TTileBitmapParam param;
+    param.iLabelHandler = &label_discarder;
+
+    std::mt19937 rng(1);
+    int incremental_pans = 0;
+    int failed_pans = 0;
+    int wrong_area_pans = 0;
+    int max_difference = 0;
+    int64 drawn_area = 0;
+    for (int i = 0; i < pans; i++)
+        {
+        int32 distance = 0;
+        switch (rng() % 3)
+            {
+            case 0: distance = 1 + int32(rng() % 16); break;
+            case 1: distance = 16 + int32(rng() % 128); break;
+            default: distance = KViewHeight - 8; break;
+            }
+        int32 dx = (rng() % 3 == 0) ? 0 : int32(rng() % (distance + 1)) * (rng() % 2 ? 1 : -1);
+        int32 dy = (dx && rng() % 3 == 0) ? 0 : int32(rng() % (distance + 1)) * (rng() % 2 ? 1 : -1);
+
+        size_t incremental_count = view->IncrementalRedrawCount();
+        error = view->Pan(dx,dy);
+        if (!error)
+            view->MapBitmap(error);
+        if (error)
+            {
+            fprintf(stderr,"error %d panning the map\n",int(error));
+            return 1;
+            }
+        if (view->IncrementalRedrawCount() != incremental_count)
+            {
+            incremental_pans++;
+            int64 expected = int64(abs(dx)) * KViewHeight + int64(abs(dy)) * (KViewWidth - abs(dx));
+            drawn_area += int64(view->DrawnArea());
+            if (int64(view->DrawnArea()) != expected)
+                wrong_area_pans++;
+            }
+
+        const TBitmap* base = view->BaseBitmap();
+        discarded_label.clear();
+        const TBitmap* reference = ViewAreaBitmap(error,*framework,TRect(0,0,KViewWidth,KViewHeight),KViewWidth,KViewHeight,&param);
+        if (error || !base)
+            {
+            fprintf(stderr,"error %d drawing the reference map\n",int(error));
+            return 1;
+            }
+        int64 different = DifferentPixelCount(*base,*reference,tolerance,max_difference);
+        if (different)
+            {
+            printf("pan %d by (%d,%d): %d pixels differ\n",i,int(dx),int(dy),int(different));
+            failed_pans++;
+            }
+        }
+
+    printf("%d pans, %d drawn incrementally, %d full redraws; incremental pans drew %.1f%% of the area of full redraws\n",
+           pans,incremental_pans,int(view->FullRedrawCount()),incremental_pans ? 100.0 * double(drawn_area) / (double(incremental_pans) * KViewWidth * KViewHeight) : 0.0);
+    printf("largest difference in a color channel: %d\n",max_difference);
+    bool ok = true;
+    if (failed_pans)
+        {
+        printf("FAILED: the map differed from a full redraw after %d pans\n",failed_pans);
+        ok = false;
+        }
+    if (wrong_area_pans)
+        {
+        printf("FAILED: %d incremental pans drew more or less than the exposed strips\n",wrong_area_pans);
+        ok = false;
+        }
+    if (!incremental_pans)
+        {
+        printf("FAILED: no pan was drawn incrementally\n");
+        ok = false;
+        }
+    if (ok)
+        printf("passed\n");
+    return ok ? 0 : 1;
+    }
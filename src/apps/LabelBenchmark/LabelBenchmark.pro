@@ -0,0 +1,22 @@
+#-------------------------------------------------
+#
+# LabelBenchmark: measures the speed of the label placer
+# on a dense synthetic set of labels covering a 4K display.
+#
+#-------------------------------------------------
+
+QT -= core gui
+
+TARGET = LabelBenchmark
+TEMPLATE = app
+
+CONFIG += console c++11
+CONFIG -= app_bundle qt
+
+DEFINES += NDEBUG
+
+INCLUDEPATH += ../../main/base
+
+SOURCES += main.cpp
+
+HEADERS += ../../main/base/cartotype_label_placer.h
@@ -0,0 +1,158 @@
+/*
+LabelBenchmark: measures the speed of CLabelPlacer on a dense synthetic set of labels.
+
+The labels imitate a city map at high resolution: many low-priority street and point of interest labels,
+fewer place names with higher priorities, each with up to four possible positions around its anchor point.
+They are placed by a serial pass that tests each label against every label already placed, which is how
+label placement works without a spatial index, then by CLabelPlacer on one thread and on several threads.
+It then uses larger batches, which allow more parallelism when there are many priority levels.
+The results of the placer must not depend on the number of threads, and no two placed labels may overlap.
+
+Usage: LabelBenchmark [width] [height] [number of labels] [number of threads]
+*/
+
+#include <cartotype_label_placer.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace CartoType;
+
+/** A label with up to four possible positions. */
+class TTestLabel
+    {
+    public:
+    int32 m_priority = 0;
+    std::vector<TRect> m_position;
+    };
+
+static std::vector<TTestLabel> CreateLabels(int aWidth,int aHeight,int aCount)
+    {
+    std::vector<TTestLabel> labels(aCount);
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<int32> pos_x(-40,aWidth + 40), pos_y(-20,aHeight + 20);
+    std::uniform_int_distribution<int32> text_length(3,24), level(0,99);
+    for (auto& label : labels)
+        {
+        // Priorities: 70% minor labels at priority 0, the rest spread over 30 levels.
+        int32 l = level(rng);
+        label.m_priority = l < 70 ? 0 : l - 69;
+        int32 x = pos_x(rng), y = pos_y(rng);
+        int32 w = text_length(rng) * (6 + label.m_priority / 6);
+        int32 h = 12 + label.m_priority / 3;
+        int32 positions = label.m_priority == 0 ? 1 : 4;
+        const int32 dx[] = { 4, -4 - w, 4, -4 - w };
+        const int32 dy[] = { -h - 2, -h - 2, 2, 2 };
+        for (int32 i = 0; i < positions; i++)
+            label.m_position.emplace_back(x + dx[i],y + dy[i],x + dx[i] + w,y + dy[i] + h);
+        }
+    return labels;
+    }
+
+/** Place labels in priority order, testing each one against all the labels already placed. */
+static std::vector<int32> PlaceSerially(const std::vector<TTestLabel>& aLabels)
+    {
+    std::vector<uint32> order(aLabels.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = uint32(i);
+    std::stable_sort(order.begin(),order.end(),[&aLabels](uint32 aA,uint32 aB) { return aLabels[aA].m_priority > aLabels[aB].m_priority; });
+    std::vector<int32> placed_position(aLabels.size(),-1);
+    std::vector<TRect> placed;
+    for (auto index : order)
+        {
+        const TTestLabel& label = aLabels[index];
+        for (size_t p = 0; p < label.m_position.size() && placed_position[index] < 0; p++)
+            {
+            bool collides = false;
+            for (const auto& r : placed)
+                if (CLabelCollisionGrid::Overlaps(r,label.m_position[p]))
+                    {
+                    collides = true;
+                    break;
+                    }
+            if (!collides)
+                {
+                placed.push_back(label.m_position[p]);
+                placed_position[index] = int32(p);
+                }
+            }
+        }
+    return placed_position;
+    }
+
+static std::vector<int32> PlaceWithPlacer(CLabelPlacer& aPlacer,const std::vector<TTestLabel>& aLabels,size_t aThreadCount,double& aTime)
+    {
+    auto start = std::chrono::steady_clock::now();
+    aPlacer.Clear();
+    for (const auto& label : aLabels)
+        aPlacer.AddLabel(label.m_priority,label.m_position.data(),label.m_position.size());
+    aPlacer.Place(aThreadCount);
+    aTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::vector<int32> placed_position(aLabels.size());
+    for (size_t i = 0; i < aLabels.size(); i++)
+        placed_position[i] = aPlacer.PlacedPositionIndex(i);
+    return placed_position;
+    }
+
+/** Return true if no two placed labels overlap. */
+static bool NoOverlaps(const std::vector<TTestLabel>& aLabels,const std::vector<int32>& aPlacedPosition,const TRect& aBounds)
+    {
+    CLabelCollisionGrid grid(aBounds);
+    for (size_t i = 0; i < aLabels.size(); i++)
+        if (aPlacedPosition[i] >= 0)
+            {
+            const TRect& r = aLabels[i].m_position[aPlacedPosition[i]];
+            if (grid.Intersects(r))
+                return false;
+            grid.Insert(r);
+            }
+    return true;
+    }
+
+static size_t PlacedCount(const std::vector<int32>& aPlacedPosition)
+    {
+    return aPlacedPosition.size() - std::count(aPlacedPosition.begin(),aPlacedPosition.end(),-1);
+    }
+
+int main(int argc,char** argv)
+    {
+    int width = argc > 1 ? atoi(argv[1]) : 3840;
+    int height = argc > 2 ? atoi(argv[2]) : 2160;
+    int count = argc > 3 ? atoi(argv[3]) : 50000;
+    int threads = argc > 4 ? atoi(argv[4]) : 0;
+    if (width < 16 || height < 16 || count < 1 || threads < 0)
+        {
+        fprintf(stderr,"usage: LabelBenchmark [width >= 16] [height >= 16] [labels >= 1] [threads >= 0]\n");
+        return 1;
+        }
+
+    std::vector<TTestLabel> labels = CreateLabels(width,height,count);
+    TRect bounds(0,0,width,height);
+    printf("%d labels on a %dx%d display\n",count,width,height);
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<int32> serial = PlaceSerially(labels);
+    double serial_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("serial, no index:     %8.1f ms, %d placed\n",serial_time * 1000,int(PlacedCount(serial)));
+
+    CLabelPlacer placer(bounds);
+    double one_thread_time = 0, many_thread_time = 0;
+    std::vector<int32> one_thread = PlaceWithPlacer(placer,labels,1,one_thread_time);
+    printf("placer, 1 thread:     %8.1f ms, %d placed  x%.1f\n",one_thread_time * 1000,int(PlacedCount(one_thread)),serial_time / one_thread_time);
+    std::vector<int32> many_threads = PlaceWithPlacer(placer,labels,threads,many_thread_time);
+    printf("placer, %2d threads:   %8.1f ms, %d placed  x%.1f\n",threads ? threads : int(std::thread::hardware_concurrency()),many_thread_time * 1000,int(PlacedCount(many_threads)),serial_time / many_thread_time);
+
+    placer.SetBatchSize(4096);
+    double batched_time = 0;
+    std::vector<int32> batched = PlaceWithPlacer(placer,labels,threads,batched_time);
+    printf("placer, batches of 4096: %5.1f ms, %d placed  x%.1f\n",batched_time * 1000,int(PlacedCount(batched)),serial_time / batched_time);
+
+    bool ok = one_thread == many_threads && NoOverlaps(labels,one_thread,bounds) && NoOverlaps(labels,batched,bounds);
+    if (!ok)
+        printf("MISMATCH or OVERLAP\n");
+    return ok ? 0 : 1;
+    }
@@ -0,0 +1,26 @@
+#-------------------------------------------------
+#
+# ProgressiveViewCheck: checks that the map drawn in steps by
+# CProgressiveMapRenderer matches a full redraw.
+#
+#-------------------------------------------------
+
+QT -= core gui
+
+TARGET = ProgressiveViewCheck
+TEMPLATE = app
+
+CONFIG += console c++11
+CONFIG -= app_bundle qt
+
+DEFINES += NDEBUG
+
+INCLUDEPATH += ../../main/base
+
+SOURCES += main.cpp
+
+HEADERS += ../../main/base/cartotype_progressive_view.h
+
+unix:!macx: LIBS += -L$$PWD/../../main/single_library/unix/bin/ReleaseLicensed/ -lcartotype -lpthread -ldl
+
+unix:!macx: PRE_TARGETDEPS += $$PWD/../../main/single_library/unix/bin/ReleaseLicensed/libcartotype.a
@@ -0,0 +1,202 @@
+/*
+ProgressiveViewCheck: checks that CProgressiveMapRenderer draws the same map as a full redraw.
+
+The map is drawn by a series of calls to CProgressiveMapRenderer::Draw with a small time budget, and the finished map is compared
+pixel by pixel with the whole view drawn in one piece: the map without labels drawn by CFramework::TileBitmap, with the labels
+for the whole view drawn over it. The map is then panned, which must restart the drawing, and drawn and compared again.
+
+A second renderer with a preview scale of 1, which draws no preview, checks that the bitmap is cleared when drawing restarts:
+after the first step following a pan, no pixels outside the single tile drawn may be left from the previous map.
+
+Antialiasing can make pixels on the edges of the tiles differ slightly from a full redraw; the tolerance is the largest
+difference allowed in any color channel, and is zero by default.
+
+The program prints FAILED and returns 1 if any check fails.
+
+Usage: ProgressiveViewCheck <map file> <style sheet> <font> [<time budget in milliseconds> [<tolerance>]]
+*/
+
+#include <cartotype_progressive_view.h>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace CartoType;
+
+static const int32 KViewWidth = 640;
+static const int32 KViewHeight = 480;
+static const int32 KTileSize = 128;
+
+/** Return the number of pixels of two 32-bit color bitmaps of the same size that differ by more than aTolerance in any channel, and the largest difference. */
+static int64 DifferentPixelCount(const TBitmap& aA,const TBitmap& aB,int aTolerance,int& aMaxDifference)
+    {
+    int64 n = 0;
+    for (int32 y = 0; y < aA.Height(); y++)
+        {
+        const uint8* a = aA.Data() + y * aA.RowBytes();
+        const uint8* b = aB.Data() + y * aB.RowBytes();
+        for (int32 x = 0; x < aA.Width(); x++, a += 4, b += 4)
+            {
+            int difference = 0;
+            for (int i = 0; i < 4; i++)
+                difference = std::max(difference,abs(int(a[i]) - int(b[i])));
+            aMaxDifference = std::max(aMaxDifference,difference);
+            n += difference > aTolerance;
+            }
+        }
+    return n;
+    }
+
+/** Return the number of pixels of a 32-bit color bitmap which are not zero. */
+static int64 NonZeroPixelCount(const TBitmap& aBitmap)
+    {
+    int64 n = 0;
+    for (int32 y = 0; y < aBitmap.Height(); y++)
+        {
+        const uint32* p = (const uint32*)(aBitmap.Data() + y * aBitmap.RowBytes());
+        for (int32 x = 0; x < aBitmap.Width(); x++)
+            n += p[x] != 0;
+        }
+    return n;
+    }
+
+/** Draw the whole view in one piece: the map without labels, with the labels for the whole view drawn over it. */
+static std::unique_ptr<CBitmap> FullMap(TResult& aError,CFramework& aFramework)
+    {
+    TRect view(0,0,KViewWidth,KViewHeight);
+    std::vector<TDisplayLabel> label;
+    TDisplayLabelCollector label_collector(label);
+    TTileBitmapParam param;
+    param.iLabelHandler = &label_collector;
+    const TBitmap* bitmap = ViewAreaBitmap(aError,aFramework,view,KViewWidth,KViewHeight,&param);
+    if (aError)
+        return nullptr;
+    std::unique_ptr<CBitmap> map(new CBitmap(*bitmap));
+
+    // The labels are drawn again with the map objects left out, as the renderer does, so that they are placed for the whole view.
+    label.clear();
+    param.iDrawMapObjects = false;
+    param.iDrawBackground = false;
+    label_collector.iOrigin = view.iTopLeft;
+    ViewAreaBitmap(aError,aFramework,view,KViewWidth,KViewHeight,&param);
+    if (aError)
+        return nullptr;
+    const TPixelBlender& blender = TPixelBlender::Get();
+    for (const auto& l : label)
+        l.Draw(*map,blender);
+    return map;
+    }
+
+/** Draw the map progressively until it is complete; return the finished map, or null if there is an error. */
+static const TBitmap* DrawProgressively(CProgressiveMapRenderer& aRenderer,double aBudget,int& aCalls,double& aMaxCallTime,bool& aProgressOk)
+    {
+    aCalls = 0;
+    aMaxCallTime = 0;
+    aProgressOk = true;
+    double progress = 0;
+    for (;;)
+        {
+        TResult error = KErrorNone;
+        bool complete = false;
+        auto start = std::chrono::steady_clock::now();
+        const TBitmap* bitmap = aRenderer.Draw(error,aBudget,complete);
+        aMaxCallTime = std::max(aMaxCallTime,std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now() - start).count());
+        aCalls++;
+        if (error || !bitmap)
+            {
+            fprintf(stderr,"error %d drawing the map progressively\n",int(error));
+            return nullptr;
+            }
+        if (aRenderer.Progress() < progress)
+            aProgressOk = false;
+        progress = aRenderer.Progress();
+        if (complete)
+            return bitmap;
+        }
+    }
+
+static bool Check(bool aCondition,const char* aText)
+    {
+    if (!aCondition)
+        printf("FAILED: %s\n",aText);
+    return aCondition;
+    }
+
+int main(int argc,char** argv)
+    {
+    if (argc < 4 || argc > 6)
+        {
+        fprintf(stderr,"usage: ProgressiveViewCheck <map file> <style sheet> <font> [<time budget in milliseconds> [<tolerance>]]\n");
+        return 1;
+        }
+    double budget = argc > 4 ? std::max(0.0,atof(argv[4])) : 10;
+    int tolerance = argc > 5 ? std::max(0,atoi(argv[5])) : 0;
+
+    TResult error = 0;
+    std::unique_ptr<CFramework> framework = CFramework::New(error,argv[1],argv[2],argv[3],KViewWidth,KViewHeight);
+    std::unique_ptr<CProgressiveMapRenderer> renderer;
+    if (!error)
+        renderer = CProgressiveMapRenderer::New(error,*framework,KTileSize);
+    if (error)
+        {
+        fprintf(stderr,"error %d creating the renderer\n",int(error));
+        return 1;
+        }
+
+    bool ok = true;
+    int max_difference = 0;
+    for (int pass = 0; pass < 2; pass++)
+        {
+        // The second pass follows a pan, which must restart the drawing.
+        if (pass)
+            {
+            error = framework->Pan(KTileSize / 3,KTileSize / 5);
+            ok &= Check(!error && !renderer->Complete(),"panning did not restart the drawing");
+            }
+
+        int calls = 0;
+        double max_call_time = 0;
+        bool progress_ok = true;
+        const TBitmap* map = DrawProgressively(*renderer,budget,calls,max_call_time,progress_ok);
+        std::unique_ptr<CBitmap> reference = FullMap(error,*framework);
+        if (!map || !reference)
+            {
+            fprintf(stderr,"error %d drawing the map\n",int(error));
+            return 1;
+            }
+        int64 different = DifferentPixelCount(*map,*reference,tolerance,max_difference);
+        printf("%s: %d calls with a budget of %.1f ms, longest call %.1f ms, %d pixels differ from a full redraw\n",
+               pass ? "after panning" : "first view",calls,budget,max_call_time,int(different));
+        ok &= Check(progress_ok,"the progress went backwards");
+        ok &= Check(different == 0,"the finished map differs from a full redraw");
+        }
+    printf("largest difference in a color channel: %d\n",max_difference);
+
+    // Without a preview, the first step after a pan draws a single tile, and the rest of the bitmap must have been cleared.
+    std::unique_ptr<CProgressiveMapRenderer> no_preview_renderer = CProgressiveMapRenderer::New(error,*framework,KTileSize,1);
+    int calls = 0;
+    double max_call_time = 0;
+    bool progress_ok = true;
+    if (!error && DrawProgressively(*no_preview_renderer,budget,calls,max_call_time,progress_ok))
+        error = framework->Pan(KTileSize / 3,KTileSize / 5);
+    else if (!error)
+        error = KErrorGeneral;
+    bool complete = false;
+    const TBitmap* first_step = error ? nullptr : no_preview_renderer->Draw(error,0,complete);
+    if (!first_step)
+        {
+        fprintf(stderr,"error %d drawing the map without a preview\n",int(error));
+        return 1;
+        }
+    int64 left_over = NonZeroPixelCount(*first_step) - int64(KTileSize) * KTileSize;
+    printf("without a preview: %d pixels after the first step lie outside the tile drawn\n",int(std::max(left_over,int64(0))));
+    ok &= Check(!complete && left_over <= 0,"the previous map was left in the bitmap when drawing restarted without a preview");
+
+    if (ok)
+        printf("passed\n");
+    return ok ? 0 : 1;
+    }
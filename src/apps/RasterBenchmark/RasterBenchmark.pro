@@ -0,0 +1,23 @@
+#-------------------------------------------------
+#
+# RasterBenchmark: measures the speed of the analytic rasterizer
+# on a synthetic 4K map with a coastline and land use areas.
+#
+#-------------------------------------------------
+
+QT -= core gui
+
+TARGET = RasterBenchmark
+TEMPLATE = app
+
+CONFIG += console c++11
+CONFIG -= app_bundle qt
+
+DEFINES += NDEBUG
+
+INCLUDEPATH += ../../main/base
+
+SOURCES += main.cpp
+
+HEADERS += ../../main/base/cartotype_analytic_rasterizer.h \
+    ../../main/base/cartotype_pixel_blend.h
@@ -0,0 +1,161 @@
+/*
+RasterBenchmark: measures the speed of CAnalyticRasterizer on a synthetic 4K map.
+
+The map has a sea background, a fractal coastline with hundreds of thousands of vertices enclosing most of the area,
+and thousands of irregular land use polygons. Each frame is drawn twice: once with empty and solid tiles
+skipped, and once with every pixel of every row accumulated, which is how an accumulation rasterizer works without
+tile binning. The two results must be identical.
+
+Usage: RasterBenchmark [width] [height] [number of frames]
+*/
+
+#include <cartotype_analytic_rasterizer.h>
+
+#include <chrono>
+#include <random>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+using namespace CartoType;
+
+/** A filled polygon, in pixels. */
+class TPolygon
+    {
+    public:
+    std::vector<double> m_x;
+    std::vector<double> m_y;
+    uint32 m_color = 0;
+    };
+
+static uint32 Premultiply(uint32 aRed,uint32 aGreen,uint32 aBlue,uint32 aAlpha)
+    {
+    return (aAlpha << 24) | ((aRed * aAlpha / 255) << 16) | ((aGreen * aAlpha / 255) << 8) | (aBlue * aAlpha / 255);
+    }
+
+/** Replace each edge of a closed polygon by two, displacing the new vertex at random, aLevels times. */
+static void Fractalize(TPolygon& aPolygon,int aLevels,double aRoughness,std::mt19937& aRng)
+    {
+    std::normal_distribution<double> noise(0,1);
+    for (int level = 0; level < aLevels; level++)
+        {
+        std::vector<double> x, y;
+        size_t n = aPolygon.m_x.size();
+        for (size_t i = 0; i < n; i++)
+            {
+            size_t j = (i + 1) % n;
+            double dx = aPolygon.m_x[j] - aPolygon.m_x[i];
+            double dy = aPolygon.m_y[j] - aPolygon.m_y[i];
+            double offset = noise(aRng) * aRoughness;
+            x.push_back(aPolygon.m_x[i]);
+            y.push_back(aPolygon.m_y[i]);
+            x.push_back(aPolygon.m_x[i] + dx / 2 - dy * offset);
+            y.push_back(aPolygon.m_y[i] + dy / 2 + dx * offset);
+            }
+        aPolygon.m_x.swap(x);
+        aPolygon.m_y.swap(y);
+        }
+    }
+
+static std::vector<TPolygon> CreateMap(int aWidth,int aHeight)
+    {
+    std::vector<TPolygon> map;
+    std::mt19937 rng(4321);
+
+    // The land: a large fractal island, partly off the edges of the map.
+    TPolygon land;
+    land.m_color = Premultiply(242,239,233,255);
+    const double corner_x[] = { -0.1, 0.75, 1.1, 0.9, 0.1 };
+    const double corner_y[] = { 0.1, -0.1, 0.4, 1.1, 0.85 };
+    for (int i = 0; i < 5; i++)
+        {
+        land.m_x.push_back(corner_x[i] * aWidth);
+        land.m_y.push_back(corner_y[i] * aHeight);
+        }
+    Fractalize(land,15,0.12,rng);
+    map.push_back(std::move(land));
+
+    // Land use areas: irregular polygons of various sizes, some partly transparent.
+    const uint32 color[] = { Premultiply(200,250,204,255), Premultiply(173,209,158,255), Premultiply(224,223,223,255),
+                             Premultiply(255,214,209,220), Premultiply(238,240,213,255), Premultiply(170,211,223,255) };
+    std::uniform_real_distribution<double> pos_x(0,aWidth), pos_y(0,aHeight), unit(0,1);
+    int area_count = int(3000.0 * aWidth * aHeight / (3840.0 * 2160.0));
+    for (int i = 0; i < area_count; i++)
+        {
+        TPolygon area;
+        area.m_color = color[i % 6];
+        double cx = pos_x(rng), cy = pos_y(rng);
+        double radius = 8 + pow(unit(rng),3) * 250;
+        int n = 6 + int(unit(rng) * 10);
+        for (int j = 0; j < n; j++)
+            {
+            double angle = j * 2 * 3.14159265 / n;
+            double r = radius * (0.6 + 0.4 * unit(rng));
+            area.m_x.push_back(cx + cos(angle) * r);
+            area.m_y.push_back(cy + sin(angle) * r);
+            }
+        Fractalize(area,3,0.1,rng);
+        map.push_back(std::move(area));
+        }
+    return map;
+    }
+
+static double DrawMap(const std::vector<TPolygon>& aMap,CAnalyticRasterizer& aRasterizer,TBitmap& aBitmap)
+    {
+    auto start = std::chrono::steady_clock::now();
+    const TPixelBlender& blender = TPixelBlender::Get();
+    uint32 sea = Premultiply(170,211,223,255);
+    for (int32 y = 0; y < aBitmap.Height(); y++)
+        blender.FillSpan((uint32*)(aBitmap.Data() + y * aBitmap.RowBytes()),aBitmap.Width(),sea);
+    for (const auto& polygon : aMap)
+        {
+        aRasterizer.Reset();
+        size_t n = polygon.m_x.size();
+        for (size_t i = 0; i < n; i++)
+            {
+            size_t j = (i + 1) % n;
+            aRasterizer.AddLine(polygon.m_x[i],polygon.m_y[i],polygon.m_x[j],polygon.m_y[j]);
+            }
+        aRasterizer.Fill(aBitmap,polygon.m_color,blender);
+        }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+int main(int argc,char** argv)
+    {
+    int width = argc > 1 ? atoi(argv[1]) : 3840;
+    int height = argc > 2 ? atoi(argv[2]) : 2160;
+    int frames = argc > 3 ? atoi(argv[3]) : 5;
+    if (width < 16 || height < 16 || frames < 1)
+        {
+        fprintf(stderr,"usage: RasterBenchmark [width >= 16] [height >= 16] [frames >= 1]\n");
+        return 1;
+        }
+
+    std::vector<TPolygon> map = CreateMap(width,height);
+    size_t edges = 0;
+    for (const auto& polygon : map)
+        edges += polygon.m_x.size();
+    printf("map %dx%d: %d polygons, %d edges\n",width,height,int(map.size()),int(edges));
+
+    std::vector<uint32> pixels1(size_t(width) * height), pixels2(size_t(width) * height);
+    TBitmap bitmap1(TBitmap::E32BitColor,(uint8*)pixels1.data(),width,height,width * 4);
+    TBitmap bitmap2(TBitmap::E32BitColor,(uint8*)pixels2.data(),width,height,width * 4);
+    CAnalyticRasterizer tiled(width,height);
+    CAnalyticRasterizer untiled(width,height);
+    untiled.SetTileSkipping(false);
+
+    double tiled_time = 0, untiled_time = 0;
+    for (int f = 0; f < frames; f++)
+        {
+        tiled_time += DrawMap(map,tiled,bitmap1);
+        untiled_time += DrawMap(map,untiled,bitmap2);
+        }
+    tiled_time /= frames;
+    untiled_time /= frames;
+    bool same = pixels1 == pixels2;
+    printf("without tile skipping: %8.1f ms/frame\n",untiled_time * 1000);
+    printf("with tile skipping:    %8.1f ms/frame  x%.2f%s\n",tiled_time * 1000,untiled_time / tiled_time,same ? "" : "  MISMATCH");
+    return same ? 0 : 1;
+    }
@@ -0,0 +1,26 @@
+#-------------------------------------------------
+#
+# TaskQueueBenchmark: measures TPriorityTaskQueue and checks
+# it while several threads add, cancel, reprioritize and start tasks.
+#
+#-------------------------------------------------
+
+QT -= core gui
+
+TARGET = TaskQueueBenchmark
+TEMPLATE = app
+
+CONFIG += console c++11
+CONFIG -= app_bundle qt
+
+DEFINES += NDEBUG
+
+INCLUDEPATH += ../../main/base
+
+SOURCES += main.cpp
+
+HEADERS += ../../main/base/cartotype_vector_tile.h
+
+unix:!macx: LIBS += -L$$PWD/../../main/single_library/unix/bin/ReleaseLicensed/ -lcartotype -lpthread -ldl
+
+unix:!macx: PRE_TARGETDEPS += $$PWD/../../main/single_library/unix/bin/ReleaseLicensed/libcartotype.a
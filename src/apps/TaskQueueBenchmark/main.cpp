@@ -0,0 +1,201 @@
+/*
+TaskQueueBenchmark: measures TPriorityTaskQueue, and checks it while several threads use it at once.
+
+The first part adds tasks with random priorities to the queue, then starts and ends them all on one thread,
+reporting the time per operation and checking that tasks are started in order of priority.
+
+The second part is a stress check. One thread adds tasks, sometimes adding a recent task again with a more urgent priority;
+another thread repeatedly cancels some queued tasks and gives the rest new priorities, cancelling some of those;
+and the worker threads start and end the tasks. At the end every task must have been either started or cancelled,
+no task may have been started twice, and no two workers may have performed the same task at once.
+The program prints FAILED and returns 1 if any check fails.
+
+Usage: TaskQueueBenchmark [number of worker threads] [number of tasks]
+*/
+
+#include <cartotype_vector_tile.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace CartoType;
+
+typedef std::chrono::steady_clock TClock;
+typedef TPriorityTaskQueue<int32> TQueue;
+
+static double NanosecondsPerOp(TClock::time_point aStart,size_t aOps)
+    {
+    return std::chrono::duration<double,std::nano>(TClock::now() - aStart).count() / double(aOps);
+    }
+
+/** Time adding aCount tasks, then starting and ending them all, on one thread. Return false if they are not started in order of priority. */
+static bool MeasureOneThread(size_t aCount)
+    {
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<double> priority(0,1000);
+    std::vector<double> priority_array(aCount);
+    for (auto& p : priority_array)
+        p = priority(rng);
+
+    TQueue queue(1);
+    auto start = TClock::now();
+    for (size_t i = 0; i < aCount; i++)
+        queue.Add(int32(i),priority_array[i]);
+    double add_time = NanosecondsPerOp(start,aCount);
+
+    bool in_order = true;
+    double previous = -1;
+    start = TClock::now();
+    for (size_t i = 0; i < aCount; i++)
+        {
+        int32 task = queue.StartTask(0);
+        if (priority_array[task] < previous)
+            in_order = false;
+        previous = priority_array[task];
+        queue.EndTask(task);
+        }
+    double start_time = NanosecondsPerOp(start,aCount);
+
+    printf("%d tasks on one thread: add %.1f ns, start and end %.1f ns%s\n",int(aCount),add_time,start_time,in_order ? "" : " - FAILED: not in order of priority");
+    return in_order;
+    }
+
+/** Run the stress check with aWorkerCount workers and aCount tasks; return true if it passes. */
+static bool StressCheck(size_t aWorkerCount,size_t aCount)
+    {
+    // Tasks are re-added only if they are among the KWindow most recently added, so a worker can end a task once it is older than that.
+    const int32 KWindow = 256;
+
+    TQueue queue(aWorkerCount);
+    std::unique_ptr<std::atomic<int>[]> started(new std::atomic<int>[aCount]);
+    std::unique_ptr<std::atomic<int>[]> cancelled(new std::atomic<int>[aCount]);
+    std::unique_ptr<std::atomic<bool>[]> running(new std::atomic<bool>[aCount]);
+    for (size_t i = 0; i < aCount; i++)
+        {
+        started[i] = 0;
+        cancelled[i] = 0;
+        running[i] = false;
+        }
+    std::atomic<int32> added(0);
+    std::atomic<bool> adding(true);
+    std::atomic<size_t> overlaps(0);
+    std::atomic<size_t> bad_tasks(0);
+
+    auto start = TClock::now();
+    std::vector<std::thread> thread_array;
+    for (size_t w = 0; w < aWorkerCount; w++)
+        thread_array.emplace_back([&,w]()
+            {
+            std::vector<int32> unended;
+            for (;;)
+                {
+                int32 task = queue.StartTask(w);
+                if (task < 0)
+                    break;
+                if (task >= int32(aCount))
+                    {
+                    bad_tasks++;
+                    continue;
+                    }
+                if (running[task].exchange(true))
+                    overlaps++;
+                started[task]++;
+                running[task] = false;
+                unended.push_back(task);
+
+                // End the tasks that can no longer be added again, so that their entries are removed while other threads use the queue.
+                int32 oldest = added - KWindow;
+                auto p = std::partition(unended.begin(),unended.end(),[oldest](int32 aTask) { return aTask >= oldest; });
+                for (auto q = p; q != unended.end(); ++q)
+                    queue.EndTask(*q);
+                unended.erase(p,unended.end());
+                }
+            for (int32 task : unended)
+                queue.EndTask(task);
+            });
+
+    std::thread canceller([&]()
+        {
+        std::mt19937 rng(5678);
+        while (adding)
+            {
+            int32 modulus = int32(rng() % 50) + 50;
+            queue.Cancel([&](int32 aTask)
+                {
+                if (aTask % modulus)
+                    return false;
+                cancelled[aTask]++;
+                return true;
+                });
+            queue.Reprioritize([&](int32 aTask)
+                {
+                if (aTask % (modulus + 1) == 0)
+                    {
+                    cancelled[aTask]++;
+                    return -1.0;
+                    }
+                return double((int64(aTask) * 7919 + modulus) % 1000);
+                });
+            std::this_thread::yield();
+            }
+        });
+
+    std::mt19937 rng(9012);
+    for (int32 i = 0; i < int32(aCount); i++)
+        {
+        queue.Add(i,double(rng() % 1000));
+        if (i > 0 && rng() % 4 == 0)
+            queue.Add(i - 1 - int32(rng() % std::min(i,KWindow)),double(rng() % 1000) - 1000);
+        added = i + 1;
+        }
+    adding = false;
+    canceller.join();
+
+    // The stop tasks are less urgent than any other, so they are started only when the queue is otherwise empty.
+    for (size_t w = 0; w < aWorkerCount; w++)
+        queue.Add(-1 - int32(w),1e9);
+    for (auto& t : thread_array)
+        t.join();
+    double total_time = NanosecondsPerOp(start,aCount);
+
+    size_t lost = 0;
+    size_t started_twice = 0;
+    size_t started_count = 0;
+    size_t cancelled_count = 0;
+    for (size_t i = 0; i < aCount; i++)
+        {
+        if (!started[i] && !cancelled[i])
+            lost++;
+        if (started[i] > 1)
+            started_twice++;
+        started_count += started[i];
+        cancelled_count += cancelled[i];
+        }
+    bool ok = !lost && !started_twice && !overlaps && !bad_tasks && queue.Empty();
+
+    printf("%d tasks on %d worker(s): %d started, %d cancelled, %.1f ns per task\n",int(aCount),int(aWorkerCount),int(started_count),int(cancelled_count),total_time);
+    if (!ok)
+        printf("FAILED: %d lost, %d started twice, %d performed by two workers at once, %d unknown, %d left in the queue\n",
+               int(lost),int(started_twice),int(overlaps),int(bad_tasks),int(queue.QueuedCount()));
+    return ok;
+    }
+
+int main(int argc,char** argv)
+    {
+    size_t worker_count = argc > 1 ? size_t(std::max(1,atoi(argv[1]))) : std::max(1u,std::min(8u,std::thread::hardware_concurrency()));
+    size_t count = argc > 2 ? size_t(std::max(1,atoi(argv[2]))) : 1000000;
+
+    bool ok = MeasureOneThread(count);
+    if (!StressCheck(1,count))
+        ok = false;
+    if (worker_count > 1 && !StressCheck(worker_count,count))
+        ok = false;
+    return ok ? 0 : 1;
+    }
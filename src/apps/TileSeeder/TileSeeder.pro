@@ -0,0 +1,45 @@
+#-------------------------------------------------
+#
+# TileSeeder: command-line tool to pre-generate raster tiles
+# as a z/x/y directory tree or an MBTiles file.
+#
+#-------------------------------------------------
+
+QT -= core gui
+
+TARGET = TileSeeder
+TEMPLATE = app
+
+CONFIG += console c++11
+CONFIG -= app_bundle qt
+
+DEFINES += NDEBUG
+
+INCLUDEPATH += ../../main/base
+
+SOURCES += main.cpp
+
+HEADERS += ../../main/base/cartotype_framework.h \
+    ../../main/base/cartotype_tile_bitmap_pool.h
+
+LIBS += -lsqlite3
+
+unix:!macx: LIBS += -L$$PWD/../../main/single_library/unix/bin/ReleaseLicensed/ -lcartotype -lpthread -ldl
+
+unix:!macx: PRE_TARGETDEPS += $$PWD/../../main/single_library/unix/bin/ReleaseLicensed/libcartotype.a
+
+macx: LIBS += -L$$PWD/../../main/single_library/mac/CartoType/build/Release/ -lCartoType
+
+macx: PRE_TARGETDEPS += $$PWD/../../main/single_library/mac/CartoType/build/Release/libCartoType.a
+
+win32:contains(QMAKE_TARGET.arch, x86_64):
+{
+CONFIG(debug, debug|release): LIBS += -L$$PWD/../../../bin/14.0/x64/DebugDLL/ -lcartotype
+else:CONFIG(release, debug|release): LIBS += -L$$PWD/../../../bin/14.0/x64/ReleaseDLL/ -lcartotype
+}
+
+win32:!contains(QMAKE_TARGET.arch, x86_64):
+{
+CONFIG(debug, debug|release): LIBS += -L$$PWD/../../../bin/14.0/Win32/DebugDLL/ -lcartotype
+else:CONFIG(release, debug|release): LIBS += -L$$PWD/../../../bin/14.0/Win32/ReleaseDLL/ -lcartotype
+}
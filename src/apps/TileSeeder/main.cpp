@@ -0,0 +1,673 @@
+/*
+TileSeeder: pre-generates raster map tiles from CTM1 maps.
+
+Tiles are drawn in metatiles by a pool of render threads sharing the same map data,
+encoded as PNG, and written either to a z/x/y directory tree or to an MBTiles file.
+Tiles that already exist in the output are skipped, so an interrupted run can be resumed
+by running the same command again. Tiles of a single uniform color (for example, empty
+sea or background) are stored only once and referred to by all the tiles that use them.
+*/
+
+#include <cartotype_tile_bitmap_pool.h>
+#include <sqlite3.h>
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <set>
+#include <string>
+#include <thread>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+    #include <direct.h>
+#else
+    #include <unistd.h>
+#endif
+
+/** The command-line options. */
+class TSeederParam
+    {
+    public:
+    std::string m_map_file;
+    std::string m_style_file;
+    std::string m_font_file;
+    std::string m_output;
+    double m_min_long = -180;
+    double m_min_lat = -85.0511;
+    double m_max_long = 180;
+    double m_max_lat = 85.0511;
+    int m_min_zoom = 0;
+    int m_max_zoom = 0;
+    int m_tile_size = 256;
+    int m_metatile_size = 8;
+    int m_thread_count = 0;
+    bool m_mbtiles = false;
+    };
+
+/** The largest number of tiles along each side of a metatile; larger metatiles would need very large bitmaps. */
+static const int KMaxMetatileSize = 16;
+
+/** An encoded tile waiting to be written. */
+class TEncodedTile
+    {
+    public:
+    int m_zoom = 0;
+    int m_x = 0;
+    int m_y = 0;
+    std::vector<uint8_t> m_png;
+    std::string m_uniform_key; // if not empty, the tile is of a single color and is stored once under this key
+    };
+
+/** The range of metatiles to be drawn at a single zoom level. */
+class TZoomRange
+    {
+    public:
+    int m_zoom = 0;
+    int m_min_x = 0;        // the range of tiles requested
+    int m_min_y = 0;
+    int m_max_x = 0;
+    int m_max_y = 0;
+    int m_block_min_x = 0;  // the range of metatiles, in units of the metatile size
+    int m_block_min_y = 0;
+    int m_block_columns = 0;
+    uint64_t m_block_count = 0;
+    uint64_t m_first_block = 0; // the index of the first metatile of this zoom level in the whole job
+    };
+
+/** The interface for the tile stores. Functions may be called from any thread. */
+class MTileStore
+    {
+    public:
+    virtual ~MTileStore() { }
+    /** Return true if all the tiles in the range already exist. */
+    virtual bool TilesExist(int aZoom,int aMinX,int aMinY,int aMaxX,int aMaxY) = 0;
+    virtual bool Write(TEncodedTile& aTile) = 0;
+    virtual bool Finish() { return true; }
+    };
+
+static bool FileExists(const std::string& aFileName)
+    {
+    struct stat s;
+    return stat(aFileName.c_str(),&s) == 0;
+    }
+
+static bool MakeDirectory(const std::string& aName)
+    {
+#ifdef _WIN32
+    return _mkdir(aName.c_str()) == 0 || FileExists(aName);
+#else
+    return mkdir(aName.c_str(),0777) == 0 || FileExists(aName);
+#endif
+    }
+
+static bool WriteFile(const std::string& aFileName,const std::vector<uint8_t>& aData)
+    {
+    // Write to a temporary file and rename it so that an interrupted run never leaves a partial tile.
+    std::string temp_name = aFileName + ".tmp";
+    FILE* file = fopen(temp_name.c_str(),"wb");
+    if (!file)
+        return false;
+    bool ok = fwrite(aData.data(),1,aData.size(),file) == aData.size();
+    ok = fclose(file) == 0 && ok;
+    if (ok)
+        {
+        remove(aFileName.c_str());
+        ok = rename(temp_name.c_str(),aFileName.c_str()) == 0;
+        }
+    if (!ok)
+        remove(temp_name.c_str());
+    return ok;
+    }
+
+/** A tile store writing tiles to a z/x/y.png directory tree. */
+class CDirectoryTileStore: public MTileStore
+    {
+    public:
+    explicit CDirectoryTileStore(const std::string& aRoot):
+        m_root(aRoot)
+        {
+        MakeDirectory(m_root);
+        MakeDirectory(m_root + "/uniform");
+        }
+
+    bool TilesExist(int aZoom,int aMinX,int aMinY,int aMaxX,int aMaxY) override
+        {
+        for (int x = aMinX; x <= aMaxX; x++)
+            for (int y = aMinY; y <= aMaxY; y++)
+                if (!FileExists(TileFileName(aZoom,x,y)))
+                    return false;
+        return true;
+        }
+
+    bool Write(TEncodedTile& aTile) override
+        {
+        std::string dir = m_root + "/" + std::to_string(aTile.m_zoom);
+        MakeDirectory(dir);
+        dir += "/" + std::to_string(aTile.m_x);
+        MakeDirectory(dir);
+        std::string file_name = TileFileName(aTile.m_zoom,aTile.m_x,aTile.m_y);
+        if (aTile.m_uniform_key.empty())
+            return WriteFile(file_name,aTile.m_png);
+
+        // Store uniform tiles once and hard-link to them where possible.
+        std::string uniform_name = m_root + "/uniform/" + aTile.m_uniform_key + ".png";
+            {
+            std::lock_guard<std::mutex> lock(m_uniform_mutex);
+            if (!FileExists(uniform_name) && !WriteFile(uniform_name,aTile.m_png))
+                return false;
+            }
+#ifndef _WIN32
+        remove(file_name.c_str());
+        if (link(uniform_name.c_str(),file_name.c_str()) == 0)
+            return true;
+#endif
+        return WriteFile(file_name,aTile.m_png);
+        }
+
+    private:
+    std::string TileFileName(int aZoom,int aX,int aY) const
+        {
+        return m_root + "/" + std::to_string(aZoom) + "/" + std::to_string(aX) + "/" + std::to_string(aY) + ".png";
+        }
+
+    std::string m_root;
+    std::mutex m_uniform_mutex;
+    };
+
+/**
+A tile store writing tiles to an MBTiles file. The file uses the normalized
+MBTiles schema (a 'map' table referring to an 'images' table, and a 'tiles' view)
+so that uniform tiles can be stored once. Writes are batched into transactions.
+*/
+class CMbTilesStore: public MTileStore
+    {
+    public:
+    static std::unique_ptr<CMbTilesStore> New(const std::string& aFileName,const TSeederParam& aParam)
+        {
+        std::unique_ptr<CMbTilesStore> store(new CMbTilesStore);
+        if (sqlite3_open(aFileName.c_str(),&store->m_db) != SQLITE_OK)
+            {
+            fprintf(stderr,"cannot open %s: %s\n",aFileName.c_str(),sqlite3_errmsg(store->m_db));
+            return nullptr;
+            }
+        const char* schema =
+            "PRAGMA journal_mode=WAL;"
+            "CREATE TABLE IF NOT EXISTS metadata (name TEXT PRIMARY KEY, value TEXT);"
+            "CREATE TABLE IF NOT EXISTS images (tile_id TEXT PRIMARY KEY, tile_data BLOB);"
+            "CREATE TABLE IF NOT EXISTS map (zoom_level INTEGER, tile_column INTEGER, tile_row INTEGER, tile_id TEXT,"
+            " PRIMARY KEY (zoom_level, tile_column, tile_row));"
+            "CREATE VIEW IF NOT EXISTS tiles AS SELECT map.zoom_level AS zoom_level, map.tile_column AS tile_column,"
+            " map.tile_row AS tile_row, images.tile_data AS tile_data FROM map JOIN images ON images.tile_id = map.tile_id;";
+        if (!store->Exec(schema))
+            return nullptr;
+
+        std::string bounds = std::to_string(aParam.m_min_long) + "," + std::to_string(aParam.m_min_lat) + "," +
+                             std::to_string(aParam.m_max_long) + "," + std::to_string(aParam.m_max_lat);
+        std::string metadata =
+            "INSERT OR REPLACE INTO metadata VALUES ('name','" + Quote(aParam.m_map_file) + "');"
+            "INSERT OR REPLACE INTO metadata VALUES ('format','png');"
+            "INSERT OR REPLACE INTO metadata VALUES ('type','baselayer');"
+            "INSERT OR REPLACE INTO metadata VALUES ('bounds','" + bounds + "');"
+            "INSERT OR REPLACE INTO metadata VALUES ('minzoom','" + std::to_string(aParam.m_min_zoom) + "');"
+            "INSERT OR REPLACE INTO metadata VALUES ('maxzoom','" + std::to_string(aParam.m_max_zoom) + "');";
+        if (!store->Exec(metadata.c_str()) ||
+            !store->Prepare(store->m_insert_image,"INSERT OR REPLACE INTO images VALUES (?,?)") ||
+            !store->Prepare(store->m_insert_map,"INSERT OR REPLACE INTO map VALUES (?,?,?,?)") ||
+            !store->Prepare(store->m_count_tiles,"SELECT COUNT(*) FROM map WHERE zoom_level=? AND tile_column BETWEEN ? AND ? AND tile_row BETWEEN ? AND ?") ||
+            !store->Exec("BEGIN"))
+            return nullptr;
+        return store;
+        }
+
+    ~CMbTilesStore()
+        {
+        sqlite3_finalize(m_insert_image);
+        sqlite3_finalize(m_insert_map);
+        sqlite3_finalize(m_count_tiles);
+        sqlite3_close(m_db);
+        }
+
+    bool TilesExist(int aZoom,int aMinX,int aMinY,int aMaxX,int aMaxY) override
+        {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        int max_row = (1 << aZoom) - 1;
+        sqlite3_reset(m_count_tiles);
+        sqlite3_bind_int(m_count_tiles,1,aZoom);
+        sqlite3_bind_int(m_count_tiles,2,aMinX);
+        sqlite3_bind_int(m_count_tiles,3,aMaxX);
+        sqlite3_bind_int(m_count_tiles,4,max_row - aMaxY);
+        sqlite3_bind_int(m_count_tiles,5,max_row - aMinY);
+        if (sqlite3_step(m_count_tiles) != SQLITE_ROW)
+            return false;
+        int64_t expected = int64_t(aMaxX - aMinX + 1) * (aMaxY - aMinY + 1);
+        return sqlite3_column_int64(m_count_tiles,0) == expected;
+        }
+
+    bool Write(TEncodedTile& aTile) override
+        {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::string tile_id = aTile.m_uniform_key;
+        bool store_image = true;
+        if (tile_id.empty())
+            tile_id = std::to_string(aTile.m_zoom) + "/" + std::to_string(aTile.m_x) + "/" + std::to_string(aTile.m_y);
+        else
+            store_image = m_uniform_keys.insert(tile_id).second;
+
+        if (store_image)
+            {
+            sqlite3_reset(m_insert_image);
+            sqlite3_bind_text(m_insert_image,1,tile_id.c_str(),-1,SQLITE_TRANSIENT);
+            sqlite3_bind_blob(m_insert_image,2,aTile.m_png.data(),(int)aTile.m_png.size(),SQLITE_STATIC);
+            if (sqlite3_step(m_insert_image) != SQLITE_DONE)
+                return Error();
+            }
+
+        // MBTiles uses the TMS convention, with row 0 at the bottom.
+        sqlite3_reset(m_insert_map);
+        sqlite3_bind_int(m_insert_map,1,aTile.m_zoom);
+        sqlite3_bind_int(m_insert_map,2,aTile.m_x);
+        sqlite3_bind_int(m_insert_map,3,(1 << aTile.m_zoom) - 1 - aTile.m_y);
+        sqlite3_bind_text(m_insert_map,4,tile_id.c_str(),-1,SQLITE_TRANSIENT);
+        if (sqlite3_step(m_insert_map) != SQLITE_DONE)
+            return Error();
+
+        // Commit regularly so that progress is kept if the run is interrupted.
+        if (++m_uncommitted_tiles >= KTilesPerTransaction)
+            {
+            m_uncommitted_tiles = 0;
+            if (!Exec("COMMIT; BEGIN"))
+                return false;
+            }
+        return true;
+        }
+
+    bool Finish() override
+        {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return Exec("COMMIT");
+        }
+
+    private:
+    CMbTilesStore() = default;
+
+    static std::string Quote(const std::string& aText)
+        {
+        std::string s;
+        for (char c : aText)
+            {
+            s += c;
+            if (c == '\'')
+                s += c;
+            }
+        return s;
+        }
+
+    bool Exec(const char* aSql)
+        {
+        char* message = nullptr;
+        if (sqlite3_exec(m_db,aSql,nullptr,nullptr,&message) == SQLITE_OK)
+            return true;
+        fprintf(stderr,"SQLite error: %s\n",message ? message : "unknown");
+        sqlite3_free(message);
+        return false;
+        }
+
+    bool Prepare(sqlite3_stmt*& aStatement,const char* aSql)
+        {
+        if (sqlite3_prepare_v2(m_db,aSql,-1,&aStatement,nullptr) == SQLITE_OK)
+            return true;
+        return Error();
+        }
+
+    bool Error()
+        {
+        fprintf(stderr,"SQLite error: %s\n",sqlite3_errmsg(m_db));
+        return false;
+        }
+
+    static const int KTilesPerTransaction = 1000;
+
+    sqlite3* m_db = nullptr;
+    sqlite3_stmt* m_insert_image = nullptr;
+    sqlite3_stmt* m_insert_map = nullptr;
+    sqlite3_stmt* m_count_tiles = nullptr;
+    std::set<std::string> m_uniform_keys;
+    int m_uncommitted_tiles = 0;
+    std::mutex m_mutex;
+    };
+
+/**
+A bounded queue passing encoded tiles from the render threads to the writer thread,
+so that PNG encoding and drawing are not held up by the database.
+*/
+class CTileQueue
+    {
+    public:
+    void Add(TEncodedTile&& aTile)
+        {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (m_queue.size() >= KMaxQueuedTiles)
+            m_not_full.wait(lock);
+        m_queue.push_back(std::move(aTile));
+        m_not_empty.notify_one();
+        }
+
+    /** Get the next tile; return false if the queue has been closed and is empty. */
+    bool Remove(TEncodedTile& aTile)
+        {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (m_queue.empty() && !m_closed)
+            m_not_empty.wait(lock);
+        if (m_queue.empty())
+            return false;
+        aTile = std::move(m_queue.front());
+        m_queue.pop_front();
+        m_not_full.notify_one();
+        return true;
+        }
+
+    void Close()
+        {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_not_empty.notify_all();
+        }
+
+    private:
+    static const size_t KMaxQueuedTiles = 4096;
+
+    std::deque<TEncodedTile> m_queue;
+    bool m_closed = false;
+    std::mutex m_mutex;
+    std::condition_variable m_not_empty;
+    std::condition_variable m_not_full;
+    };
+
+/**
+Return a key identifying the color if the bitmap consists of a single color,
+or the empty string if it does not.
+*/
+static std::string UniformKey(const CartoType::TBitmap& aBitmap)
+    {
+    size_t bytes_per_pixel = aBitmap.BitsPerPixel() / 8;
+    if (bytes_per_pixel == 0 || aBitmap.BitsPerPixel() % 8 || aBitmap.Width() <= 0 || aBitmap.Height() <= 0)
+        return std::string();
+    const uint8_t* first_pixel = aBitmap.Data();
+    for (int y = 0; y < aBitmap.Height(); y++)
+        {
+        const uint8_t* p = aBitmap.Data() + (size_t)y * aBitmap.RowBytes();
+        for (int x = 0; x < aBitmap.Width(); x++, p += bytes_per_pixel)
+            if (memcmp(p,first_pixel,bytes_per_pixel))
+                return std::string();
+        }
+    std::string key = std::to_string(aBitmap.Width()) + "x" + std::to_string(aBitmap.Height()) + "-";
+    char buffer[3];
+    for (size_t i = 0; i < bytes_per_pixel; i++)
+        {
+        snprintf(buffer,sizeof(buffer),"%02x",first_pixel[i]);
+        key += buffer;
+        }
+    return key;
+    }
+
+static int TileX(double aLong,int aZoom)
+    {
+    int n = 1 << aZoom;
+    int x = (int)floor((aLong + 180.0) / 360.0 * n);
+    return std::max(0,std::min(n - 1,x));
+    }
+
+static int TileY(double aLat,int aZoom)
+    {
+    int n = 1 << aZoom;
+    double lat = std::max(-85.0511,std::min(85.0511,aLat)) * CartoType::KPiDouble / 180.0;
+    int y = (int)floor((1.0 - log(tan(lat) + 1.0 / cos(lat)) / CartoType::KPiDouble) / 2.0 * n);
+    return std::max(0,std::min(n - 1,y));
+    }
+
+/** The seeding job, shared by the render threads. */
+class CSeeder
+    {
+    public:
+    CSeeder(const TSeederParam& aParam,CartoType::CTileBitmapPool& aPool,MTileStore& aStore):
+        m_param(aParam),
+        m_pool(aPool),
+        m_store(aStore)
+        {
+        int m = m_param.m_metatile_size;
+        for (int zoom = m_param.m_min_zoom; zoom <= m_param.m_max_zoom; zoom++)
+            {
+            TZoomRange r;
+            r.m_zoom = zoom;
+            r.m_min_x = TileX(m_param.m_min_long,zoom);
+            r.m_max_x = TileX(m_param.m_max_long,zoom);
+            r.m_min_y = TileY(m_param.m_max_lat,zoom);
+            r.m_max_y = TileY(m_param.m_min_lat,zoom);
+            r.m_block_min_x = r.m_min_x / m;
+            r.m_block_min_y = r.m_min_y / m;
+            r.m_block_columns = r.m_max_x / m - r.m_block_min_x + 1;
+            r.m_block_count = uint64_t(r.m_block_columns) * (r.m_max_y / m - r.m_block_min_y + 1);
+            r.m_first_block = m_block_count;
+            m_block_count += r.m_block_count;
+            m_tile_count += uint64_t(r.m_max_x - r.m_min_x + 1) * (r.m_max_y - r.m_min_y + 1);
+            m_zoom_range.push_back(r);
+            }
+        }
+
+    /** Draw metatiles until there are none left; called by each render thread. */
+    void Run()
+        {
+        for (;;)
+            {
+            uint64_t index = m_next_block++;
+            if (index >= m_block_count || m_failed)
+                return;
+            size_t i = 0;
+            while (index >= m_zoom_range[i].m_first_block + m_zoom_range[i].m_block_count)
+                i++;
+            if (!DrawBlock(m_zoom_range[i],index - m_zoom_range[i].m_first_block))
+                m_failed = true;
+            }
+        }
+
+    void Write()
+        {
+        TEncodedTile tile;
+        while (m_queue.Remove(tile))
+            {
+            if (!m_failed && !m_store.Write(tile))
+                m_failed = true;
+            uint64_t done = ++m_tiles_done;
+            if (done % 1000 == 0)
+                Report();
+            }
+        }
+
+    void CloseQueue() { m_queue.Close(); }
+    bool Failed() const { return m_failed; }
+    uint64_t TileCount() const { return m_tile_count; }
+    uint64_t TilesDone() const { return m_tiles_done; }
+    uint64_t TilesSkipped() const { return m_tiles_skipped; }
+    uint64_t UniformTiles() const { return m_uniform_tiles; }
+
+    void Report()
+        {
+        fprintf(stderr,"\r%llu of %llu tiles (%llu skipped, %llu uniform)",
+                (unsigned long long)(m_tiles_done + m_tiles_skipped),(unsigned long long)m_tile_count,
+                (unsigned long long)m_tiles_skipped,(unsigned long long)m_uniform_tiles);
+        }
+
+    private:
+    bool DrawBlock(const TZoomRange& aRange,uint64_t aBlockIndex)
+        {
+        int m = m_param.m_metatile_size;
+        int block_x = (aRange.m_block_min_x + int(aBlockIndex % aRange.m_block_columns)) * m;
+        int block_y = (aRange.m_block_min_y + int(aBlockIndex / aRange.m_block_columns)) * m;
+
+        // Clip the block to the requested range and skip it if it has already been written.
+        int min_x = std::max(block_x,aRange.m_min_x);
+        int min_y = std::max(block_y,aRange.m_min_y);
+        int max_x = std::min(block_x + m - 1,aRange.m_max_x);
+        int max_y = std::min(block_y + m - 1,aRange.m_max_y);
+        if (m_store.TilesExist(aRange.m_zoom,min_x,min_y,max_x,max_y))
+            {
+            m_tiles_skipped += uint64_t(max_x - min_x + 1) * (max_y - min_y + 1);
+            return true;
+            }
+
+        CartoType::TResult error = 0;
+        std::vector<CartoType::TTileBitmapItem> tile_array = m_pool.MetaTileBitmaps(error,m_param.m_tile_size,aRange.m_zoom,block_x,block_y,m);
+        if (error)
+            {
+            fprintf(stderr,"\nerror %d drawing metatile %d/%d/%d\n",(int)error,aRange.m_zoom,block_x,block_y);
+            return false;
+            }
+
+        for (auto& item : tile_array)
+            {
+            if (item.m_x < min_x || item.m_x > max_x || item.m_y < min_y || item.m_y > max_y)
+                continue;
+            TEncodedTile tile;
+            tile.m_zoom = aRange.m_zoom;
+            tile.m_x = item.m_x;
+            tile.m_y = item.m_y;
+            tile.m_uniform_key = UniformKey(*item.m_bitmap);
+            if (!tile.m_uniform_key.empty())
+                m_uniform_tiles++;
+            CartoType::CMemoryOutputStream output;
+            error = item.m_bitmap->WritePng(output,false);
+            if (error)
+                {
+                fprintf(stderr,"\nerror %d encoding tile %d/%d/%d\n",(int)error,tile.m_zoom,tile.m_x,tile.m_y);
+                return false;
+                }
+            tile.m_png = output.RemoveData();
+            m_queue.Add(std::move(tile));
+            }
+        return true;
+        }
+
+    const TSeederParam& m_param;
+    CartoType::CTileBitmapPool& m_pool;
+    MTileStore& m_store;
+    CTileQueue m_queue;
+    std::vector<TZoomRange> m_zoom_range;
+    uint64_t m_block_count = 0;
+    uint64_t m_tile_count = 0;
+    std::atomic<uint64_t> m_next_block { 0 };
+    std::atomic<uint64_t> m_tiles_done { 0 };
+    std::atomic<uint64_t> m_tiles_skipped { 0 };
+    std::atomic<uint64_t> m_uniform_tiles { 0 };
+    std::atomic<bool> m_failed { false };
+    };
+
+static void Usage()
+    {
+    fprintf(stderr,
+            "usage: TileSeeder -map <file.ctm1> -style <style.xml> -font <font.ttf> -zoom <min>[-<max>] -out <directory or file.mbtiles>\n"
+            "                  [-bbox <minlong>,<minlat>,<maxlong>,<maxlat>] [-tilesize <pixels>] [-metatile <tiles>] [-threads <count>]\n"
+            "The metatile size, which is the number of tiles along each side of a metatile, is limited to 1...16.\n"
+            "Tiles are written to a z/x/y.png directory tree unless the output name ends in .mbtiles.\n"
+            "Tiles already present in the output are not drawn again, so an interrupted run can be resumed.\n");
+    }
+
+static bool ParseArguments(TSeederParam& aParam,int argc,char** argv)
+    {
+    for (int i = 1; i < argc; i++)
+        {
+        std::string option = argv[i];
+        if (i + 1 >= argc)
+            return false;
+        const char* value = argv[++i];
+        if (option == "-map")
+            aParam.m_map_file = value;
+        else if (option == "-style")
+            aParam.m_style_file = value;
+        else if (option == "-font")
+            aParam.m_font_file = value;
+        else if (option == "-out")
+            aParam.m_output = value;
+        else if (option == "-zoom")
+            {
+            int n = sscanf(value,"%d-%d",&aParam.m_min_zoom,&aParam.m_max_zoom);
+            if (n < 1)
+                return false;
+            if (n == 1)
+                aParam.m_max_zoom = aParam.m_min_zoom;
+            }
+        else if (option == "-bbox")
+            {
+            if (sscanf(value,"%lf,%lf,%lf,%lf",&aParam.m_min_long,&aParam.m_min_lat,&aParam.m_max_long,&aParam.m_max_lat) != 4)
+                return false;
+            }
+        else if (option == "-tilesize")
+            aParam.m_tile_size = atoi(value);
+        else if (option == "-metatile")
+            aParam.m_metatile_size = std::max(1,std::min(KMaxMetatileSize,atoi(value)));
+        else if (option == "-threads")
+            aParam.m_thread_count = atoi(value);
+        else
+            return false;
+        }
+
+    const std::string suffix = ".mbtiles";
+    aParam.m_mbtiles = aParam.m_output.size() > suffix.size() &&
+                       aParam.m_output.compare(aParam.m_output.size() - suffix.size(),suffix.size(),suffix) == 0;
+    return !aParam.m_map_file.empty() && !aParam.m_style_file.empty() && !aParam.m_font_file.empty() && !aParam.m_output.empty() &&
+           aParam.m_min_zoom >= 0 && aParam.m_max_zoom >= aParam.m_min_zoom && aParam.m_max_zoom <= 24 &&
+           aParam.m_tile_size > 0 && aParam.m_metatile_size > 0 && aParam.m_thread_count >= 0 &&
+           aParam.m_min_long < aParam.m_max_long && aParam.m_min_lat < aParam.m_max_lat;
+    }
+
+int main(int argc,char** argv)
+    {
+    TSeederParam param;
+    if (!ParseArguments(param,argc,argv))
+        {
+        Usage();
+        return 1;
+        }
+
+    CartoType::TResult error = 0;
+    std::unique_ptr<CartoType::CFramework> framework = CartoType::CFramework::New(error,param.m_map_file.c_str(),param.m_style_file.c_str(),param.m_font_file.c_str(),
+                                                                                  param.m_tile_size,param.m_tile_size);
+    if (error)
+        {
+        fprintf(stderr,"error %d creating the framework\n",(int)error);
+        return 1;
+        }
+
+    std::unique_ptr<CartoType::CTileBitmapPool> pool = CartoType::CTileBitmapPool::New(error,*framework,param.m_thread_count);
+    if (error)
+        {
+        fprintf(stderr,"error %d creating the render contexts\n",(int)error);
+        return 1;
+        }
+
+    std::unique_ptr<MTileStore> store;
+    if (param.m_mbtiles)
+        store = CMbTilesStore::New(param.m_output,param);
+    else
+        store.reset(new CDirectoryTileStore(param.m_output));
+    if (!store)
+        return 1;
+
+    CSeeder seeder(param,*pool,*store);
+    std::thread writer([&seeder]() { seeder.Write(); });
+    std::vector<std::thread> render_thread_array;
+    for (size_t i = 0; i < pool->ContextCount(); i++)
+        render_thread_array.emplace_back([&seeder]() { seeder.Run(); });
+    for (auto& t : render_thread_array)
+        t.join();
+    seeder.CloseQueue();
+    writer.join();
+
+    bool ok = store->Finish() && !seeder.Failed();
+    seeder.Report();
+    fprintf(stderr,"\n%s\n",ok ? "done" : "failed; run the same command again to resume");
+    return ok ? 0 : 1;
+    }
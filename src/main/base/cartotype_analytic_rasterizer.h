@@ -0,0 +1,434 @@
+/*
+CARTOTYPE_ANALYTIC_RASTERIZER.H
+Copyright (C) 2017 CartoType Ltd.
+See www.cartotype.com for more information.
+*/
+
+#ifndef CARTOTYPE_ANALYTIC_RASTERIZER_H__
+#define CARTOTYPE_ANALYTIC_RASTERIZER_H__
+
+#include <cartotype_path.h>
+#include <cartotype_bitmap.h>
+#include <cartotype_pixel_blend.h>
+#include <math.h>
+#include <vector>
+
+namespace CartoType
+{
+
+/**
+A rasterizer for filled shapes which calculates the exact area of each pixel covered by the shape,
+giving high-quality anti-aliasing without supersampling. It is designed for large complex polygons
+such as coastlines and land use areas.
+
+Each edge adds the area it covers, and the change in area to its right, to an accumulation buffer;
+a running sum along each row then gives the coverage of each pixel. Edges are sorted into bands
+16 pixels high, and for each band the 16 x 16 pixel tiles touched by edges are recorded.
+Other tiles are either completely outside the shape, in which case they are skipped, or completely inside it,
+in which case they are passed on as solid spans without examining their pixels.
+
+Paths are added in 64ths of pixels, as used by CGraphicsContext::DrawShape, or lines can be added directly in pixels.
+All contours are treated as closed. The coverage of pixels containing crossing edges is approximate, because the areas
+on each side of the crossing are added rather than combined using the fill rule.
+*/
+class CAnalyticRasterizer
+    {
+    public:
+    /** Create a rasterizer for an area of aWidth by aHeight pixels with its top left corner at (0,0). */
+    CAnalyticRasterizer(int32 aWidth,int32 aHeight):
+        iWidth(aWidth > 0 ? aWidth : 0),
+        iHeight(aHeight > 0 ? aHeight : 0),
+        iStride(size_t(iWidth) + 2),
+        iTilesAcross((iWidth + KTileSize - 1) / KTileSize),
+        iBand((iHeight + KTileSize - 1) / KTileSize),
+        iAccumulation(iStride * KTileSize),
+        iTouched(iTilesAcross + 1),
+        iCoverage(iWidth)
+        {
+        }
+
+    /** Return the width in pixels. */
+    int32 Width() const { return iWidth; }
+    /** Return the height in pixels. */
+    int32 Height() const { return iHeight; }
+
+    /** Remove all edges so that a new shape can be drawn. */
+    void Reset()
+        {
+        iLine.clear();
+        for (auto& band : iBand)
+            band.clear();
+        iHaveContour = false;
+        }
+
+    /** Use the even-odd fill rule if aEvenOdd is true, otherwise the non-zero winding rule, which is the default. */
+    void SetEvenOdd(bool aEvenOdd) { iEvenOdd = aEvenOdd; }
+
+    /**
+    Enable or disable skipping empty tiles and filling solid tiles without examining their pixels.
+    It is enabled by default; the output is the same either way, so disabling it is useful only for comparison.
+    */
+    void SetTileSkipping(bool aEnable) { iTileSkipping = aEnable; }
+
+    /** Add the contours of a path, with coordinates in 64ths of pixels. */
+    void AddPath(const MPath& aPath)
+        {
+        aPath.Traverse(*this);
+        ClosePath();
+        }
+
+    /** Start a new contour at aPoint, in 64ths of pixels, closing the current one. Used by MPath::Traverse. */
+    void MoveTo(const TPoint& aPoint)
+        {
+        ClosePath();
+        iStartX = iX = aPoint.iX / 64.0;
+        iStartY = iY = aPoint.iY / 64.0;
+        iHaveContour = true;
+        }
+
+    /** Add a line from the current point to aPoint, in 64ths of pixels. Used by MPath::Traverse. */
+    void LineTo(const TPoint& aPoint)
+        {
+        double x = aPoint.iX / 64.0;
+        double y = aPoint.iY / 64.0;
+        AddLine(iX,iY,x,y);
+        iX = x;
+        iY = y;
+        }
+
+    /** Add a quadratic spline from the current point, in 64ths of pixels. Used by MPath::Traverse. */
+    void QuadraticTo(const TPoint& aPoint1,const TPoint& aPoint2)
+        {
+        double x1 = aPoint1.iX / 64.0, y1 = aPoint1.iY / 64.0;
+        double x2 = aPoint2.iX / 64.0, y2 = aPoint2.iY / 64.0;
+        double ddx = iX - 2 * x1 + x2, ddy = iY - 2 * y1 + y2;
+        int32 n = SegmentCount(sqrt(ddx * ddx + ddy * ddy) / 8);
+        double x0 = iX, y0 = iY;
+        for (int32 i = 1; i <= n; i++)
+            {
+            double t = double(i) / n, u = 1 - t;
+            double x = u * u * x0 + 2 * u * t * x1 + t * t * x2;
+            double y = u * u * y0 + 2 * u * t * y1 + t * t * y2;
+            AddLine(iX,iY,x,y);
+            iX = x;
+            iY = y;
+            }
+        }
+
+    /** Add a cubic spline from the current point, in 64ths of pixels. Used by MPath::Traverse. */
+    void CubicTo(const TPoint& aPoint1,const TPoint& aPoint2,const TPoint& aPoint3)
+        {
+        double x1 = aPoint1.iX / 64.0, y1 = aPoint1.iY / 64.0;
+        double x2 = aPoint2.iX / 64.0, y2 = aPoint2.iY / 64.0;
+        double x3 = aPoint3.iX / 64.0, y3 = aPoint3.iY / 64.0;
+        double ddx1 = iX - 2 * x1 + x2, ddy1 = iY - 2 * y1 + y2;
+        double ddx2 = x1 - 2 * x2 + x3, ddy2 = y1 - 2 * y2 + y3;
+        double dd = std::max(sqrt(ddx1 * ddx1 + ddy1 * ddy1),sqrt(ddx2 * ddx2 + ddy2 * ddy2));
+        int32 n = SegmentCount(dd * 3 / 4);
+        double x0 = iX, y0 = iY;
+        for (int32 i = 1; i <= n; i++)
+            {
+            double t = double(i) / n, u = 1 - t;
+            double x = u * u * u * x0 + 3 * u * u * t * x1 + 3 * u * t * t * x2 + t * t * t * x3;
+            double y = u * u * u * y0 + 3 * u * u * t * y1 + 3 * u * t * t * y2 + t * t * t * y3;
+            AddLine(iX,iY,x,y);
+            iX = x;
+            iY = y;
+            }
+        }
+
+    /** Close the current contour, if any, by adding a line back to its start. */
+    void ClosePath()
+        {
+        if (iHaveContour)
+            {
+            AddLine(iX,iY,iStartX,iStartY);
+            iX = iStartX;
+            iY = iStartY;
+            iHaveContour = false;
+            }
+        }
+
+    /** Add a line from (aX0,aY0) to (aX1,aY1), in pixels. */
+    void AddLine(double aX0,double aY0,double aX1,double aY1)
+        {
+        if (aY0 == aY1 || (aY0 <= 0 && aY1 <= 0) || (aY0 >= iHeight && aY1 >= iHeight))
+            return;
+
+        // Split the line where it crosses the left and right edges. Parts to the left are replaced by vertical lines
+        // at x = 0, because they affect the coverage of every pixel to their right. Parts to the right have no effect.
+        // The parts are found working from left to right, but are added in the original direction.
+        bool reversed = aX0 > aX1;
+        if (reversed)
+            {
+            std::swap(aX0,aX1);
+            std::swap(aY0,aY1);
+            }
+        auto add = [this,reversed](double aXa,double aYa,double aXb,double aYb)
+            {
+            if (reversed)
+                AddClippedLine(aXb,aYb,aXa,aYa);
+            else
+                AddClippedLine(aXa,aYa,aXb,aYb);
+            };
+        if (aX1 <= 0)
+            {
+            add(0,aY0,0,aY1);
+            return;
+            }
+        if (aX0 >= iWidth)
+            return;
+        if (aX0 < 0)
+            {
+            double y = aY0 + (aY1 - aY0) * (0 - aX0) / (aX1 - aX0);
+            add(0,aY0,0,y);
+            aX0 = 0;
+            aY0 = y;
+            }
+        if (aX1 > iWidth)
+            {
+            aY1 = aY0 + (aY1 - aY0) * (iWidth - aX0) / (aX1 - aX0);
+            aX1 = iWidth;
+            }
+        add(aX0,aY0,aX1,aY1);
+        }
+
+    /**
+    Calculate the coverage of the shape and pass it to aHandler, row by row, as a series of calls to
+    aHandler(int32 aX,int32 aY,int32 aLength,const uint8* aCoverage), where aCoverage contains a value in the range 0...255
+    for each pixel from aX to aX + aLength - 1 on row aY, or is null if all those pixels are completely covered.
+    Pixels not passed to the handler are not covered at all.
+    */
+    template<class THandler> void Render(THandler aHandler)
+        {
+        for (size_t band_index = 0; band_index < iBand.size(); band_index++)
+            {
+            const std::vector<uint32>& band = iBand[band_index];
+            if (band.empty())
+                continue;
+            int32 band_y = int32(band_index) * KTileSize;
+            int32 band_height = std::min(int32(KTileSize),iHeight - band_y);
+            for (uint32 line_index : band)
+                DrawLine(iLine[line_index],band_y,band_y + band_height);
+            if (!iTileSkipping)
+                std::fill(iTouched.begin(),iTouched.end(),1);
+
+            for (int32 row = 0; row < band_height; row++)
+                {
+                float* a = iAccumulation.data() + row * iStride;
+                RenderRow(a,band_y + row,aHandler);
+                a[iWidth] = a[iWidth + 1] = 0;
+                }
+            std::fill(iTouched.begin(),iTouched.end(),0);
+            }
+        }
+
+    /**
+    Fill the shape in the premultiplied color aColor, blending it into aBitmap, which must have the type TBitmap::E32BitColor
+    and the same size as the rasterizer.
+    */
+    TResult Fill(TBitmap& aBitmap,uint32 aColor,const TPixelBlender& aBlender = TPixelBlender::Get())
+        {
+        if (aBitmap.Type() != TBitmap::E32BitColor)
+            return KErrorUnimplemented;
+        if (aBitmap.Width() != iWidth || aBitmap.Height() != iHeight)
+            return KErrorInvalidArgument;
+        uint8* data = aBitmap.Data();
+        int32 row_bytes = aBitmap.RowBytes();
+        Render([&](int32 aX,int32 aY,int32 aLength,const uint8* aCoverage)
+            {
+            uint32* p = (uint32*)(data + aY * row_bytes) + aX;
+            if (aCoverage)
+                aBlender.FillSpanWithCoverage(p,aCoverage,aLength,aColor);
+            else
+                aBlender.FillSpan(p,aLength,aColor);
+            });
+        return KErrorNone;
+        }
+
+    /** The size of the square tiles into which edges are binned. */
+    static const int32 KTileSize = 16;
+
+    private:
+    /** A line clipped horizontally to the rasterizer, and going downwards. */
+    class TLine
+        {
+        public:
+        float iX0;
+        float iY0;
+        float iX1;
+        float iY1;
+        float iDirection;
+        };
+
+    /** Return the number of line segments needed to approximate a curve deviating from its chord by aDeviation times the square of the segment count. */
+    static int32 SegmentCount(double aDeviation)
+        {
+        // Keep the error below a tenth of a pixel.
+        double n = ceil(sqrt(aDeviation / 0.1));
+        return n < 1 ? 1 : (n > 256 ? 256 : int32(n));
+        }
+
+    void AddClippedLine(double aX0,double aY0,double aX1,double aY1)
+        {
+        if (aY0 == aY1)
+            return;
+        TLine line;
+        line.iDirection = 1;
+        if (aY0 > aY1)
+            {
+            std::swap(aX0,aX1);
+            std::swap(aY0,aY1);
+            line.iDirection = -1;
+            }
+        line.iX0 = float(aX0);
+        line.iY0 = float(aY0);
+        line.iX1 = float(aX1);
+        line.iY1 = float(aY1);
+        int32 first_band = std::max(0,int32(floor(aY0)) / KTileSize);
+        int32 last_band = std::min(int32(iBand.size()) - 1,int32(ceil(aY1) - 1) / KTileSize);
+        if (first_band > last_band)
+            return;
+        uint32 index = uint32(iLine.size());
+        iLine.push_back(line);
+        for (int32 b = first_band; b <= last_band; b++)
+            iBand[b].push_back(index);
+        }
+
+    /** Add the area covered by the part of a line between aTop and aBottom to the accumulation buffer. */
+    void DrawLine(const TLine& aLine,int32 aTop,int32 aBottom)
+        {
+        float top = std::max(aLine.iY0,float(aTop));
+        float bottom = std::min(aLine.iY1,float(aBottom));
+        if (top >= bottom)
+            return;
+        float dxdy = (aLine.iX1 - aLine.iX0) / (aLine.iY1 - aLine.iY0);
+        float x = aLine.iX0 + (top - aLine.iY0) * dxdy;
+        int32 y_end = int32(ceil(bottom));
+        for (int32 y = int32(floor(top)); y < y_end; y++)
+            {
+            float* a = iAccumulation.data() + (y - aTop) * iStride;
+            float dy = std::min(float(y + 1),bottom) - std::max(float(y),top);
+            float x_next = x + dxdy * dy;
+            float d = dy * aLine.iDirection;
+            float x0 = std::max(0.0f,std::min(x,x_next));
+            float x1 = std::min(float(iWidth),std::max(x,x_next));
+            float x0_floor = floor(x0);
+            int32 x0i = int32(x0_floor);
+            float x1_ceil = ceil(x1);
+            int32 x1i = int32(x1_ceil);
+            if (x1i <= x0i + 1)
+                {
+                // The line is within a single pixel on this row.
+                float xmf = 0.5f * (x0 + x1) - x0_floor;
+                a[x0i] += d - d * xmf;
+                a[x0i + 1] += d * xmf;
+                }
+            else
+                {
+                float s = 1.0f / (x1 - x0);
+                float x0f = x0 - x0_floor;
+                float a0 = 0.5f * s * (1 - x0f) * (1 - x0f);
+                float x1f = x1 - x1_ceil + 1;
+                float am = 0.5f * s * x1f * x1f;
+                a[x0i] += d * a0;
+                if (x1i == x0i + 2)
+                    a[x0i + 1] += d * (1 - a0 - am);
+                else
+                    {
+                    float a1 = s * (1.5f - x0f);
+                    a[x0i + 1] += d * (a1 - a0);
+                    for (int32 xi = x0i + 2; xi < x1i - 1; xi++)
+                        a[xi] += d * s;
+                    float a2 = a1 + (x1i - x0i - 3) * s;
+                    a[x1i - 1] += d * (1 - a2 - am);
+                    }
+                a[x1i] += d * am;
+                }
+            int32 last_tile = std::min(x1i / KTileSize,iTilesAcross - 1);
+            for (int32 t = x0i / KTileSize; t <= last_tile; t++)
+                iTouched[t] = 1;
+            x = x_next;
+            }
+        }
+
+    uint8 CoverageValue(float aAccumulation) const
+        {
+        float c = fabs(aAccumulation);
+        if (iEvenOdd)
+            {
+            c = fmod(c,2.0f);
+            if (c > 1)
+                c = 2 - c;
+            }
+        else if (c > 1)
+            c = 1;
+        return uint8(c * 255 + 0.5f);
+        }
+
+    /** Calculate the coverage of one row, clearing the accumulation buffer, and pass it to the handler in runs. */
+    template<class THandler> void RenderRow(float* aAccumulation,int32 aY,THandler& aHandler)
+        {
+        enum { ENone, ECoverage, ESolid } run_type = ENone;
+        int32 run_start = 0;
+        float accumulation = 0;
+        for (int32 tile = 0; tile < iTilesAcross; tile++)
+            {
+            int32 x = tile * KTileSize;
+            int32 end = std::min(x + int32(KTileSize),iWidth);
+            auto type = ENone;
+            if (iTouched[tile])
+                {
+                type = ECoverage;
+                for (int32 i = x; i < end; i++)
+                    {
+                    accumulation += aAccumulation[i];
+                    aAccumulation[i] = 0;
+                    iCoverage[i] = CoverageValue(accumulation);
+                    }
+                }
+            else
+                {
+                // No edge crosses this tile, so its coverage is the same everywhere.
+                uint8 c = CoverageValue(accumulation);
+                if (c == 255)
+                    type = ESolid;
+                else if (c)
+                    {
+                    type = ECoverage;
+                    std::fill(iCoverage.begin() + x,iCoverage.begin() + end,c);
+                    }
+                }
+            if (type != run_type)
+                {
+                if (run_type != ENone)
+                    aHandler(run_start,aY,x - run_start,run_type == ECoverage ? iCoverage.data() + run_start : nullptr);
+                run_type = type;
+                run_start = x;
+                }
+            }
+        if (run_type != ENone)
+            aHandler(run_start,aY,iWidth - run_start,run_type == ECoverage ? iCoverage.data() + run_start : nullptr);
+        }
+
+    int32 iWidth;
+    int32 iHeight;
+    size_t iStride;
+    int32 iTilesAcross;
+    std::vector<TLine> iLine;
+    std::vector<std::vector<uint32>> iBand;
+    std::vector<float> iAccumulation;
+    std::vector<uint8> iTouched;
+    std::vector<uint8> iCoverage;
+    bool iEvenOdd = false;
+    bool iTileSkipping = true;
+    bool iHaveContour = false;
+    double iStartX = 0;
+    double iStartY = 0;
+    double iX = 0;
+    double iY = 0;
+    };
+
+}
+
+#endif
@@ -0,0 +1,298 @@
+/*
+CARTOTYPE_ASYNC_RENDERER.H
+Copyright (C) 2017 CartoType Ltd.
+See www.cartotype.com for more information.
+*/
+
+#ifndef CARTOTYPE_ASYNC_RENDERER_H__
+#define CARTOTYPE_ASYNC_RENDERER_H__
+
+#include <cartotype_framework.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <string.h>
+
+namespace CartoType
+{
+
+/**
+A map renderer that draws on its own thread, so that the user interface thread never waits for the map to be drawn.
+
+The renderer draws using a copy of a framework, made by CFramework::Copy, which shares the map data, fonts and style sheets.
+The user interface thread goes on using the original framework for everything else, such as handling input and finding objects,
+and posts changes to the render thread: PostView copies the view of a framework to the render framework, and Post queues
+any other change as a function to be called on the render thread. Changes posted while a map is being drawn are applied
+together when it has finished, and the map is then drawn again.
+
+Finished maps are published through three bitmaps: the front bitmap, which is being used by the user interface thread,
+the back bitmap, which is being drawn, and a bitmap holding the latest finished map. The render thread exchanges the back bitmap
+with the latest one through an atomic index, and FrontBitmap exchanges the front bitmap with the latest one if it is newer,
+so neither thread ever waits for the other, and the front bitmap is never written to while it is in use.
+
+Observers added by AddObserver are notified through MFrameworkObserver::OnMapBitmapReady, on the render thread, when a new map is ready.
+The observers are called without any lock held, so they may call AddObserver and RemoveObserver, and any other function of the renderer
+except the destructor.
+*/
+class CAsyncMapRenderer
+    {
+    public:
+    /** A change to be made to the render framework on the render thread. */
+    typedef std::function<TResult (CFramework& aFramework)> TCommand;
+
+    /**
+    Create an asynchronous renderer for a framework, which should have been set up (maps loaded, style sheet chosen, etc.)
+    before the renderer is created. The first map is drawn straight away.
+    */
+    static std::unique_ptr<CAsyncMapRenderer> New(TResult& aError,const CFramework& aFramework)
+        {
+        std::unique_ptr<CFramework> framework = aFramework.Copy(aError);
+        if (aError)
+            return nullptr;
+        std::unique_ptr<CAsyncMapRenderer> renderer(new CAsyncMapRenderer(std::move(framework)));
+        return renderer;
+        }
+
+    ~CAsyncMapRenderer()
+        {
+            {
+            std::lock_guard<std::mutex> lock(iMutex);
+            iStop = true;
+            }
+        iCondition.notify_all();
+        iThread.join();
+        }
+
+    /** Post a change to be made to the render framework, and cause the map to be drawn again. */
+    void Post(TCommand aCommand)
+        {
+            {
+            std::lock_guard<std::mutex> lock(iMutex);
+            iCommand.push_back(aCommand);
+            iPostedCount++;
+            }
+        iCondition.notify_all();
+        }
+
+    /** Cause the map to be drawn again without any other change; for example, after changing data shared by the frameworks. */
+    void Redraw()
+        {
+        Post(nullptr);
+        }
+
+    /**
+    Copy the view of aFramework, which is normally the framework used by the user interface, to the render framework:
+    that is, the display size, the position of the center of the view, the scale, the rotation and whether perspective is used.
+    */
+    TResult PostView(CFramework& aFramework)
+        {
+        TRectFP view;
+        TResult error = aFramework.GetView(view,EScreenCoordType);
+        if (error)
+            return error;
+        int32 width = int32(view.iBottomRight.iX - view.iTopLeft.iX + 0.5);
+        int32 height = int32(view.iBottomRight.iY - view.iTopLeft.iY + 0.5);
+        double center_x = (view.iTopLeft.iX + view.iBottomRight.iX) / 2;
+        double center_y = (view.iTopLeft.iY + view.iBottomRight.iY) / 2;
+        error = aFramework.ConvertPoint(center_x,center_y,EScreenCoordType,EMapCoordType);
+        if (error)
+            return error;
+        double scale = aFramework.ScaleDenominator();
+        double rotation = aFramework.Rotation();
+        bool perspective = aFramework.Perspective();
+
+        Post([=](CFramework& aRenderFramework)
+            {
+            TResult e = aRenderFramework.Resize(width,height);
+            if (!e)
+                e = aRenderFramework.SetScaleDenominator(scale);
+            if (!e)
+                e = aRenderFramework.SetRotation(rotation);
+            if (!e)
+                {
+                aRenderFramework.SetPerspective(perspective);
+                e = aRenderFramework.SetViewCenter(center_x,center_y,EMapCoordType);
+                }
+            return e;
+            });
+        return KErrorNone;
+        }
+
+    /**
+    Return the latest finished map, or null if no map has been drawn yet. If aNewMap is non-null, set *aNewMap to true if the
+    map has been drawn since the last call. The bitmap remains valid and unchanged until the next call to FrontBitmap.
+    This function must be called on one thread only, normally the user interface thread.
+    */
+    const TBitmap* FrontBitmap(bool* aNewMap = nullptr)
+        {
+        bool new_map = (iLatest.load() & KNewBit) != 0;
+        if (new_map)
+            iFront = iLatest.exchange(iFront) & KIndexMask;
+        if (aNewMap)
+            *aNewMap = new_map;
+        const CBitmap& bitmap = iBitmap[iFront];
+        return bitmap.Width() ? &bitmap : nullptr;
+        }
+
+    /** Wait until every change posted so far has been applied and the resulting map has been drawn. */
+    void WaitUntilIdle()
+        {
+        std::unique_lock<std::mutex> lock(iMutex);
+        while (iDoneCount != iPostedCount && !iStop)
+            iIdleCondition.wait(lock);
+        }
+
+    /** Return the number of maps drawn. */
+    uint64 MapCount() const { return iMapCount; }
+    /** Return the error from the most recent drawing or change to the render framework. */
+    TResult LastError() const { return iLastError; }
+
+    /** Add an observer to be notified when a new map is ready. */
+    void AddObserver(MFrameworkObserver* aObserver)
+        {
+        std::lock_guard<std::mutex> lock(iObserverMutex);
+        iObserver.push_back(aObserver);
+        }
+
+    /**
+    Remove an observer. When this function returns, the observer will not be called again, and is not being called,
+    unless this function was called by the observer itself, on the render thread, in which case that call is allowed to finish.
+    Because this function waits for a call to the observer to finish, it must not be called from a thread that the observer waits for.
+    */
+    void RemoveObserver(MFrameworkObserver* aObserver)
+        {
+        std::unique_lock<std::mutex> lock(iObserverMutex);
+        iObserver.erase(std::remove(iObserver.begin(),iObserver.end(),aObserver),iObserver.end());
+        if (std::this_thread::get_id() != iThread.get_id())
+            while (iCalledObserver == aObserver)
+                iObserverCondition.wait(lock);
+        }
+
+    private:
+    explicit CAsyncMapRenderer(std::unique_ptr<CFramework> aFramework):
+        iFramework(std::move(aFramework))
+        {
+        // Draw the first map as soon as the thread starts.
+        iPostedCount = 1;
+        iCommand.push_back(nullptr);
+        iThread = std::thread(&CAsyncMapRenderer::Run,this);
+        }
+
+    CAsyncMapRenderer(const CAsyncMapRenderer&) = delete;
+    CAsyncMapRenderer& operator=(const CAsyncMapRenderer&) = delete;
+
+    void Run()
+        {
+        std::vector<TCommand> command;
+        for (;;)
+            {
+            uint64 posted_count = 0;
+                {
+                std::unique_lock<std::mutex> lock(iMutex);
+                while (iCommand.empty() && !iStop)
+                    iCondition.wait(lock);
+                if (iStop)
+                    return;
+                command.swap(iCommand);
+                posted_count = iPostedCount;
+                }
+
+            TResult error = KErrorNone;
+            for (auto& c : command)
+                if (c)
+                    {
+                    TResult e = c(*iFramework);
+                    if (e)
+                        error = e;
+                    }
+            command.clear();
+
+            TResult draw_error = KErrorNone;
+            const TBitmap* bitmap = iFramework->MapBitmap(draw_error);
+            bool drawn = !draw_error && bitmap;
+            if (drawn)
+                {
+                Publish(*bitmap);
+                iMapCount++;
+                }
+            iLastError = error ? error : draw_error;
+            if (drawn)
+                {
+                Notify();
+                }
+
+                {
+                std::lock_guard<std::mutex> lock(iMutex);
+                iDoneCount = posted_count;
+                }
+            iIdleCondition.notify_all();
+            }
+        }
+
+    /**
+    Call the observers without holding the lock, so that they can add and remove observers. A copy of the list is used,
+    and each observer is checked before it is called, so that observers removed by earlier calls, or by other threads, are not called.
+    */
+    void Notify()
+        {
+        std::unique_lock<std::mutex> lock(iObserverMutex);
+        std::vector<MFrameworkObserver*> observer(iObserver);
+        for (auto p : observer)
+            {
+            if (std::find(iObserver.begin(),iObserver.end(),p) == iObserver.end())
+                continue;
+            iCalledObserver = p;
+            lock.unlock();
+            p->OnMapBitmapReady();
+            lock.lock();
+            iCalledObserver = nullptr;
+            iObserverCondition.notify_all();
+            }
+        }
+
+    /** Copy a finished map into the back bitmap and exchange it with the latest bitmap. */
+    void Publish(const TBitmap& aBitmap)
+        {
+        CBitmap& back = iBitmap[iBack];
+        if (back.Type() != aBitmap.Type() || back.Width() != aBitmap.Width() || back.Height() != aBitmap.Height() || back.RowBytes() != aBitmap.RowBytes())
+            back = CBitmap(aBitmap);
+        else
+            memcpy(back.Data(),aBitmap.Data(),size_t(aBitmap.DataBytes()));
+        iBack = iLatest.exchange(iBack | KNewBit) & KIndexMask;
+        }
+
+    // The latest bitmap index is combined with a bit that is set when the latest bitmap is newer than the front bitmap.
+    static const uint32 KIndexMask = 3;
+    static const uint32 KNewBit = 4;
+
+    std::unique_ptr<CFramework> iFramework;     // the framework used by the render thread
+    CBitmap iBitmap[3];
+    uint32 iFront = 0;                          // the index of the front bitmap: used only by the thread calling FrontBitmap
+    uint32 iBack = 1;                           // the index of the back bitmap: used only by the render thread
+    std::atomic<uint32> iLatest { 2 };          // the index of the latest finished map, with KNewBit if it is new
+    std::atomic<uint64> iMapCount { 0 };
+    std::atomic<TResult> iLastError { KErrorNone };
+
+    std::mutex iMutex;
+    std::condition_variable iCondition;
+    std::condition_variable iIdleCondition;
+    std::vector<TCommand> iCommand;
+    uint64 iPostedCount = 0;
+    uint64 iDoneCount = 0;
+    bool iStop = false;
+
+    std::mutex iObserverMutex;
+    std::condition_variable iObserverCondition;
+    std::vector<MFrameworkObserver*> iObserver;
+    MFrameworkObserver* iCalledObserver = nullptr;  // the observer being called by the render thread, if any
+    std::thread iThread;
+    };
+
+}
+
+#endif
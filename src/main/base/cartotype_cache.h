@@ -8,6 +8,10 @@ See www.cartotype.com for more information.
 #define CARTOTYPE_CACHE_H__
 
 #include <cartotype_list.h>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 namespace CartoType
 {
@@ -91,6 +95,320 @@ template<class TCached,class TKey> class CCache
     size_t iMaxSize;
     };
 
+/**
+A cache for objects of type TCached with a key of type TKey, with the same
+rules as CCache, but finding items in constant time using a hash table rather than
+by searching a list. Keys must be hashable by THash as well as comparable for equality.
+
+The least recently used order is kept by links stored in the hash table entries themselves,
+so that finding an item, moving it to the front, and discarding the least recently used item
+are all constant-time operations.
+
+Items may be added as raw pointers, which the cache takes ownership of, as with CCache,
+or as shared pointers, in which case an item found in the cache may be kept in existence
+by the caller after it has been discarded from the cache.
+*/
+template<class TCached,class TKey,class THash = std::hash<TKey>> class CHashCache
+    {
+    public:
+    CHashCache(int32 aMaxSize):
+        iMaxSize(aMaxSize)
+        {
+        Assert(aMaxSize >= 0);
+        iHead.iPrev = iHead.iNext = &iHead;
+        }
+
+    /** Find an item, making it the most recently used item; return null if it is not found. */
+    TCached* Find(const TKey& aKey)
+        {
+        TEntry* p = FindEntry(aKey);
+        return p ? p->iItem.get() : nullptr;
+        }
+
+    /** Find an item, making it the most recently used item, and return a shared pointer to it; return null if it is not found. */
+    std::shared_ptr<TCached> FindShared(const TKey& aKey)
+        {
+        TEntry* p = FindEntry(aKey);
+        return p ? p->iItem : nullptr;
+        }
+
+    /** Return true if there is an item with the key aKey, without making it the most recently used item. */
+    bool Contains(const TKey& aKey) const
+        {
+        return iTable.find(aKey) != iTable.end();
+        }
+
+    /** Find an item without making it the most recently used item; return null if it is not found. */
+    TCached* Peek(const TKey& aKey) const
+        {
+        auto iter = iTable.find(aKey);
+        return iter != iTable.end() ? iter->second.iItem.get() : nullptr;
+        }
+
+    /** Add an item, taking ownership of it. Any existing item with the same key is replaced. */
+    TResult Add(TCached* aItem)
+        {
+        return Add(std::shared_ptr<TCached>(aItem));
+        }
+
+    /** Add an item referred to by a shared pointer. Any existing item with the same key is replaced. */
+    TResult Add(std::shared_ptr<TCached> aItem)
+        {
+        Assert(aItem != nullptr);
+        Trim(); // trim before adding; the rule is that the cache must be able to hold at least one item
+
+        Assert(aItem->Size() >= 0);
+        auto result = iTable.emplace(aItem->Key(),TEntry());
+        TEntry& entry = result.first->second;
+        if (result.second)
+            Link(entry);
+        else
+            {
+            iSize -= entry.iItem->Size();
+            MoveToFront(entry);
+            }
+        entry.iItem = aItem;
+        iSize += aItem->Size();
+        return KErrorNone;
+        }
+
+    /** Remove the item with the key aKey, if any. Return true if an item was removed. */
+    bool Remove(const TKey& aKey)
+        {
+        auto iter = iTable.find(aKey);
+        if (iter == iTable.end())
+            return false;
+        iSize -= iter->second.iItem->Size();
+        Unlink(iter->second);
+        iTable.erase(iter);
+        return true;
+        }
+
+    void Clear()
+        {
+        iTable.clear();
+        iHead.iPrev = iHead.iNext = &iHead;
+        iSize = 0;
+        }
+
+    void SetMaxSize(int32 aMaxSize)
+        {
+        if (aMaxSize < 0)
+            aMaxSize = 0;
+        iMaxSize = aMaxSize;
+        Trim();
+        }
+
+    /** Return the number of items in the cache. */
+    size_t Count() const { return iTable.size(); }
+    /** Return the total size of the items in the cache, in the units used by their Size functions. */
+    size_t Size() const { return iSize; }
+
+    private:
+    class TLink
+        {
+        public:
+        TLink* iPrev = nullptr;
+        TLink* iNext = nullptr;
+        };
+
+    class TEntry: public TLink
+        {
+        public:
+        std::shared_ptr<TCached> iItem;
+        };
+
+    TEntry* FindEntry(const TKey& aKey)
+        {
+        auto iter = iTable.find(aKey);
+        if (iter == iTable.end())
+            return nullptr;
+        MoveToFront(iter->second);
+        return &iter->second;
+        }
+
+    void Link(TLink& aLink)
+        {
+        aLink.iPrev = &iHead;
+        aLink.iNext = iHead.iNext;
+        iHead.iNext->iPrev = &aLink;
+        iHead.iNext = &aLink;
+        }
+
+    static void Unlink(TLink& aLink)
+        {
+        aLink.iPrev->iNext = aLink.iNext;
+        aLink.iNext->iPrev = aLink.iPrev;
+        }
+
+    void MoveToFront(TLink& aLink)
+        {
+        if (iHead.iNext != &aLink)
+            {
+            Unlink(aLink);
+            Link(aLink);
+            }
+        }
+
+    void Trim()
+        {
+        while (iSize > iMaxSize)
+            {
+            Assert(iHead.iPrev != &iHead);
+            TEntry& entry = *static_cast<TEntry*>(iHead.iPrev);
+            Assert(entry.iItem->Size() > 0);
+            iSize -= entry.iItem->Size();
+            Unlink(entry);
+
+            // Erase by iterator: erasing by key would pass a reference to a key owned by the item being destroyed.
+            auto iter = iTable.find(entry.iItem->Key());
+            Assert(iter != iTable.end());
+            iTable.erase(iter);
+            }
+        }
+
+    std::unordered_map<TKey,TEntry,THash> iTable;
+    TLink iHead;    // the list head: iHead.iNext is the most recently used item and iHead.iPrev the least recently used
+    size_t iSize = 0;
+    size_t iMaxSize;
+
+    CHashCache(const CHashCache&) = delete;
+    CHashCache& operator=(const CHashCache&) = delete;
+    };
+
+/**
+A thread-safe cache, with the same rules as CHashCache, divided into a number of shards,
+each protected by its own mutex, so that several threads can use the cache at once
+with little contention. The shard for an item is chosen using the hash of its key,
+and the maximum size is divided equally between the shards.
+
+Items are held by shared pointers, so that an item found by one thread remains valid
+even if another thread causes it to be discarded from the cache.
+*/
+template<class TCached,class TKey,class THash = std::hash<TKey>> class CShardedHashCache
+    {
+    public:
+    CShardedHashCache(int32 aMaxSize,size_t aShardCount = KDefaultShardCount)
+        {
+        Assert(aMaxSize >= 0);
+        if (aShardCount == 0)
+            aShardCount = 1;
+        iShard.reserve(aShardCount);
+        for (size_t i = 0; i < aShardCount; i++)
+            iShard.emplace_back(new TShard(ShardMaxSize(aMaxSize,aShardCount)));
+        }
+
+    /** Find an item, making it the most recently used item in its shard; return null if it is not found. */
+    std::shared_ptr<TCached> Find(const TKey& aKey)
+        {
+        TShard& shard = Shard(aKey);
+        std::lock_guard<std::mutex> lock(shard.iMutex);
+        return shard.iCache.FindShared(aKey);
+        }
+
+    /** Return true if there is an item with the key aKey, without making it the most recently used item in its shard. */
+    bool Contains(const TKey& aKey)
+        {
+        TShard& shard = Shard(aKey);
+        std::lock_guard<std::mutex> lock(shard.iMutex);
+        return shard.iCache.Contains(aKey);
+        }
+
+    /** Add an item. Any existing item with the same key is replaced. */
+    TResult Add(std::shared_ptr<TCached> aItem)
+        {
+        Assert(aItem != nullptr);
+        TShard& shard = Shard(aItem->Key());
+        std::lock_guard<std::mutex> lock(shard.iMutex);
+        return shard.iCache.Add(aItem);
+        }
+
+    /** Remove the item with the key aKey, if any. Return true if an item was removed. */
+    bool Remove(const TKey& aKey)
+        {
+        TShard& shard = Shard(aKey);
+        std::lock_guard<std::mutex> lock(shard.iMutex);
+        return shard.iCache.Remove(aKey);
+        }
+
+    /**
+    Remove the item with the key aKey if aPredicate(item) returns true, testing and removing it
+    while holding the lock on its shard. Return true if an item was removed.
+    An item that is kept is not made the most recently used item in its shard.
+    */
+    template<class TPredicate> bool RemoveIf(const TKey& aKey,TPredicate aPredicate)
+        {
+        TShard& shard = Shard(aKey);
+        std::lock_guard<std::mutex> lock(shard.iMutex);
+        TCached* p = shard.iCache.Peek(aKey);
+        return p && aPredicate(*p) && shard.iCache.Remove(aKey);
+        }
+
+    void Clear()
+        {
+        for (auto& shard : iShard)
+            {
+            std::lock_guard<std::mutex> lock(shard->iMutex);
+            shard->iCache.Clear();
+            }
+        }
+
+    void SetMaxSize(int32 aMaxSize)
+        {
+        if (aMaxSize < 0)
+            aMaxSize = 0;
+        int32 shard_max_size = ShardMaxSize(aMaxSize,iShard.size());
+        for (auto& shard : iShard)
+            {
+            std::lock_guard<std::mutex> lock(shard->iMutex);
+            shard->iCache.SetMaxSize(shard_max_size);
+            }
+        }
+
+    /** Return the number of items in the cache. */
+    size_t Count() const
+        {
+        size_t count = 0;
+        for (auto& shard : iShard)
+            {
+            std::lock_guard<std::mutex> lock(shard->iMutex);
+            count += shard->iCache.Count();
+            }
+        return count;
+        }
+
+    /** The default number of shards. */
+    static const size_t KDefaultShardCount = 16;
+
+    private:
+    class TShard
+        {
+        public:
+        TShard(int32 aMaxSize): iCache(aMaxSize) { }
+
+        CHashCache<TCached,TKey,THash> iCache;
+        mutable std::mutex iMutex;
+        };
+
+    static int32 ShardMaxSize(int32 aMaxSize,size_t aShardCount)
+        {
+        return int32((aMaxSize + aShardCount - 1) / aShardCount);
+        }
+
+    TShard& Shard(const TKey& aKey)
+        {
+        // Mix the bits of the hash so that hash functions returning the identity for integers still give an even distribution.
+        uint64 h = uint64(iHash(aKey));
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return *iShard[size_t(h % iShard.size())];
+        }
+
+    std::vector<std::unique_ptr<TShard>> iShard;
+    THash iHash;
+    };
+
 }
 
 #endif
@@ -0,0 +1,655 @@
+/*
+CARTOTYPE_CUSTOMIZABLE_CH.H
+Copyright (C) 2017 CartoType Ltd.
+See www.cartotype.com for more information.
+*/
+
+#ifndef CARTOTYPE_CUSTOMIZABLE_CH_H__
+#define CARTOTYPE_CUSTOMIZABLE_CH_H__
+
+#include <cartotype_stream.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace CartoType
+{
+
+/**
+A customizable contraction hierarchy (CCH).
+
+An ordinary contraction hierarchy is built for a single route profile, because the choice of shortcuts
+depends on the arc costs. A customizable contraction hierarchy separates the work into two phases.
+The first phase, which is slow but independent of the route profile, takes a node ordering (for example,
+one found by nested dissection when the map file is made) and adds every shortcut that could ever be needed
+for any costs, giving a topology that can be stored in the map file. The second phase, customization, takes arc costs
+for a particular route profile and computes the costs of all the shortcuts; it is fast, and is done in parallel,
+so that a new route profile can be used by calling Customize again. Arcs forbidden by the profile, for example
+because of vehicle restrictions, are given the cost UINT32_MAX.
+
+Every arc of the hierarchy joins a lower-ranked node to a higher-ranked node and has two costs: the forward (upward) cost
+of going from the lower node to the higher node, and the backward (downward) cost of going the other way.
+*/
+class CCustomizableContractionHierarchy
+    {
+    public:
+    /** An arc of the original graph, from iStart to iEnd. */
+    class TInputArc
+        {
+        public:
+        uint32 iStart = 0;
+        uint32 iEnd = 0;
+        };
+
+    /**
+    Create the metric-independent topology from a graph with aNodeCount nodes, the arcs in aArc,
+    and the rank of each node in aRank, which must be a permutation of 0...aNodeCount - 1. Nodes of higher rank are
+    more important.
+    */
+    TResult Create(size_t aNodeCount,const std::vector<TInputArc>& aArc,const std::vector<uint32>& aRank)
+        {
+        Clear();
+        if (aRank.size() != aNodeCount)
+            return KErrorInvalidArgument;
+        std::vector<uint32> node_at_rank(aNodeCount,UINT32_MAX);
+        for (size_t i = 0; i < aNodeCount; i++)
+            {
+            if (aRank[i] >= aNodeCount || node_at_rank[aRank[i]] != UINT32_MAX)
+                return KErrorInvalidArgument;
+            node_at_rank[aRank[i]] = uint32(i);
+            }
+
+        // Get the higher-ranked neighbours of each node, then eliminate the nodes in rank order, joining all the higher neighbours of each one.
+        std::vector<std::vector<uint32>> upper(aNodeCount);
+        for (const auto& a : aArc)
+            {
+            if (a.iStart >= aNodeCount || a.iEnd >= aNodeCount)
+                return KErrorInvalidArgument;
+            if (a.iStart == a.iEnd)
+                continue;
+            if (aRank[a.iStart] < aRank[a.iEnd])
+                upper[a.iStart].push_back(a.iEnd);
+            else
+                upper[a.iEnd].push_back(a.iStart);
+            }
+        for (size_t r = 0; r < aNodeCount; r++)
+            {
+            std::vector<uint32>& u = upper[node_at_rank[r]];
+            std::sort(u.begin(),u.end());
+            u.erase(std::unique(u.begin(),u.end()),u.end());
+            for (size_t i = 0; i < u.size(); i++)
+                for (size_t j = i + 1; j < u.size(); j++)
+                    {
+                    if (aRank[u[i]] < aRank[u[j]])
+                        upper[u[i]].push_back(u[j]);
+                    else
+                        upper[u[j]].push_back(u[i]);
+                    }
+            }
+
+        // Assign levels: each node's level is one more than the highest level of its lower neighbours.
+        std::vector<uint32> level(aNodeCount,0);
+        uint32 level_count = 0;
+        for (size_t r = 0; r < aNodeCount; r++)
+            {
+            uint32 v = node_at_rank[r];
+            level_count = std::max(level_count,level[v] + 1);
+            for (uint32 w : upper[v])
+                level[w] = std::max(level[w],level[v] + 1);
+            }
+
+        // Store the arcs ordered by the level of their lower node, then by lower node and upper node.
+        std::vector<uint32> order(node_at_rank);
+        std::stable_sort(order.begin(),order.end(),[&level](uint32 a,uint32 b) { return level[a] < level[b]; });
+        iNodeCount = aNodeCount;
+        iUpFirst.assign(aNodeCount + 1,0);
+        iLevelStart.assign(level_count + 1,0);
+        std::vector<uint32> up_end(aNodeCount,0);
+        for (uint32 v : order)
+            {
+            iUpFirst[v] = uint32(iArcUpper.size());
+            for (uint32 w : upper[v])
+                {
+                iArcLower.push_back(v);
+                iArcUpper.push_back(w);
+                }
+            up_end[v] = uint32(iArcUpper.size());
+            iLevelStart[level[v] + 1] = uint32(iArcUpper.size());
+            }
+        for (size_t i = 1; i < iLevelStart.size(); i++)
+            iLevelStart[i] = std::max(iLevelStart[i],iLevelStart[i - 1]);
+        iUpEnd.swap(up_end);
+        iUpFirst.resize(aNodeCount);
+
+        // Find the lower triangles of each arc (u,w): the nodes v with arcs (v,u) and (v,w).
+        std::vector<std::vector<uint32>> lower_arcs(aNodeCount);
+        for (uint32 a = 0; a < iArcUpper.size(); a++)
+            lower_arcs[iArcUpper[a]].push_back(a);
+        iTriangleStart.assign(iArcUpper.size() + 1,0);
+        for (uint32 a = 0; a < iArcUpper.size(); a++)
+            {
+            uint32 w = iArcUpper[a];
+            for (uint32 vu : lower_arcs[iArcLower[a]])
+                {
+                uint32 vw = FindArc(iArcLower[vu],w);
+                if (vw != UINT32_MAX)
+                    {
+                    iTriangle.push_back(vu);
+                    iTriangle.push_back(vw);
+                    }
+                }
+            iTriangleStart[a + 1] = uint32(iTriangle.size() / 2);
+            }
+
+        // Map the input arcs to arcs of the hierarchy.
+        iInputArc.resize(aArc.size());
+        for (size_t i = 0; i < aArc.size(); i++)
+            {
+            const auto& a = aArc[i];
+            if (a.iStart == a.iEnd)
+                iInputArc[i] = UINT32_MAX;
+            else if (aRank[a.iStart] < aRank[a.iEnd])
+                iInputArc[i] = FindArc(a.iStart,a.iEnd) << 1;
+            else
+                iInputArc[i] = (FindArc(a.iEnd,a.iStart) << 1) | 1;
+            }
+        return KErrorNone;
+        }
+
+    void Clear()
+        {
+        iNodeCount = 0;
+        iArcLower.clear();
+        iArcUpper.clear();
+        iUpFirst.clear();
+        iUpEnd.clear();
+        iLevelStart.clear();
+        iTriangleStart.clear();
+        iTriangle.clear();
+        iInputArc.clear();
+        }
+
+    /**
+    Customize the hierarchy for a new route profile. On entry aInputArcCost contains the cost of each arc passed to Create,
+    or UINT32_MAX if the arc cannot be used. On exit aForwardCost and aBackwardCost contain the upward and downward
+    costs of every arc in the hierarchy. The work is divided between aThreadCount threads; zero means one for each hardware thread.
+    */
+    TResult Customize(const std::vector<uint32>& aInputArcCost,std::vector<uint32>& aForwardCost,std::vector<uint32>& aBackwardCost,size_t aThreadCount = 0) const
+        {
+        if (aInputArcCost.size() != iInputArc.size())
+            return KErrorInvalidArgument;
+        aForwardCost.assign(iArcUpper.size(),UINT32_MAX);
+        aBackwardCost.assign(iArcUpper.size(),UINT32_MAX);
+        for (size_t i = 0; i < iInputArc.size(); i++)
+            {
+            uint32 a = iInputArc[i];
+            if (a == UINT32_MAX)
+                continue;
+            uint32& cost = (a & 1) ? aBackwardCost[a >> 1] : aForwardCost[a >> 1];
+            cost = std::min(cost,aInputArcCost[i]);
+            }
+
+        if (aThreadCount == 0)
+            aThreadCount = std::thread::hardware_concurrency();
+        if (aThreadCount <= 1 || iTriangle.size() / 2 < KMinTrianglesPerThread * 2)
+            {
+            for (size_t level = 0; level + 1 < iLevelStart.size(); level++)
+                CustomizeArcs(iLevelStart[level],iLevelStart[level + 1],aForwardCost,aBackwardCost);
+            return KErrorNone;
+            }
+
+        /*
+        Arcs in the same level do not depend on each other, so each level is divided between the threads, which wait for each other
+        before starting the next level. The work for an arc is proportional to its number of triangles, so the levels are divided
+        by triangle count, not arc count.
+        */
+        TBarrier barrier(aThreadCount);
+        auto work = [&](size_t aThreadIndex)
+            {
+            for (size_t level = 0; level + 1 < iLevelStart.size(); level++)
+                {
+                size_t start = iLevelStart[level];
+                size_t end = iLevelStart[level + 1];
+                size_t triangles = iTriangleStart[end] - iTriangleStart[start];
+                if (triangles < KMinTrianglesPerThread * 2)
+                    {
+                    if (aThreadIndex == 0)
+                        CustomizeArcs(start,end,aForwardCost,aBackwardCost);
+                    }
+                else
+                    CustomizeArcs(SplitLevel(start,end,aThreadIndex,aThreadCount),SplitLevel(start,end,aThreadIndex + 1,aThreadCount),aForwardCost,aBackwardCost);
+                barrier.Wait();
+                }
+            };
+        RunInParallel(aThreadCount,work);
+        return KErrorNone;
+        }
+
+    /**
+    Reusable working data for queries. Each thread making queries needs its own object.
+    */
+    class CQuery
+        {
+        public:
+        /** Return the cost of the best route from aStart to aEnd, or UINT32_MAX if there is no route, using customized costs. */
+        uint32 Cost(const CCustomizableContractionHierarchy& aCch,const std::vector<uint32>& aForwardCost,const std::vector<uint32>& aBackwardCost,
+                    uint32 aStart,uint32 aEnd)
+            {
+            if (iCost[0].size() != aCch.iNodeCount)
+                {
+                iCost[0].assign(aCch.iNodeCount,UINT32_MAX);
+                iCost[1].assign(aCch.iNodeCount,UINT32_MAX);
+                }
+            uint64 best = UINT32_MAX;
+            TQueue queue[2];
+            Open(0,queue[0],aStart,0);
+            Open(1,queue[1],aEnd,0);
+            while (!queue[0].empty() || !queue[1].empty())
+                {
+                // Take the direction with the smaller minimum cost, stopping when neither can improve on the best route.
+                int d = queue[1].empty() || (!queue[0].empty() && queue[0].top().first <= queue[1].top().first) ? 0 : 1;
+                auto top = queue[d].top();
+                queue[d].pop();
+                if (top.first >= best)
+                    {
+                    queue[d] = TQueue();
+                    continue;
+                    }
+                uint32 v = top.second;
+                if (top.first != iCost[d][v])
+                    continue;
+                if (iCost[1 - d][v] != UINT32_MAX)
+                    best = std::min(best,uint64(top.first) + iCost[1 - d][v]);
+                const std::vector<uint32>& cost = d == 0 ? aForwardCost : aBackwardCost;
+                for (uint32 a = aCch.iUpFirst[v]; a < aCch.iUpEnd[v]; a++)
+                    if (cost[a] != UINT32_MAX)
+                        Open(d,queue[d],aCch.iArcUpper[a],uint64(top.first) + cost[a]);
+                }
+            for (int d = 0; d < 2; d++)
+                {
+                for (uint32 v : iTouched[d])
+                    iCost[d][v] = UINT32_MAX;
+                iTouched[d].clear();
+                }
+            return uint32(best);
+            }
+
+        /**
+        Search upward from aStart, using aForwardCost if aForwards is true and aBackwardCost otherwise, without stopping early,
+        and call aHandler with each node reached and the cost to or from it.
+        */
+        template<class THandler> void UpwardSearch(const CCustomizableContractionHierarchy& aCch,const std::vector<uint32>& aCost,uint32 aStart,THandler aHandler)
+            {
+            if (iCost[0].size() != aCch.iNodeCount)
+                {
+                iCost[0].assign(aCch.iNodeCount,UINT32_MAX);
+                iCost[1].assign(aCch.iNodeCount,UINT32_MAX);
+                }
+            TQueue queue;
+            Open(0,queue,aStart,0);
+            while (!queue.empty())
+                {
+                auto top = queue.top();
+                queue.pop();
+                uint32 v = top.second;
+                if (top.first != iCost[0][v])
+                    continue;
+                aHandler(v,top.first);
+                for (uint32 a = aCch.iUpFirst[v]; a < aCch.iUpEnd[v]; a++)
+                    if (aCost[a] != UINT32_MAX)
+                        Open(0,queue,aCch.iArcUpper[a],uint64(top.first) + aCost[a]);
+                }
+            for (uint32 v : iTouched[0])
+                iCost[0][v] = UINT32_MAX;
+            iTouched[0].clear();
+            }
+
+        private:
+        typedef std::pair<uint32,uint32> TQueueItem;
+        typedef std::priority_queue<TQueueItem,std::vector<TQueueItem>,std::greater<TQueueItem>> TQueue;
+
+        void Open(int aDirection,TQueue& aQueue,uint32 aNode,uint64 aCost)
+            {
+            if (aCost >= iCost[aDirection][aNode])
+                return;
+            if (iCost[aDirection][aNode] == UINT32_MAX)
+                iTouched[aDirection].push_back(aNode);
+            iCost[aDirection][aNode] = uint32(aCost);
+            aQueue.push(TQueueItem(uint32(aCost),aNode));
+            }
+
+        std::vector<uint32> iCost[2];
+        std::vector<uint32> iTouched[2];
+        };
+
+    /**
+    Calculate a matrix of the costs of the best routes from each node in aOrigin to each node in aDestination, using customized costs,
+    by the bucket method: an upward search from each destination leaves its costs in buckets at the nodes it reaches, then an upward search from each origin
+    scans the buckets at the nodes it reaches. The searches are divided between aThreadCount threads; zero means one for each hardware thread.
+
+    The costs are returned in aCost, row by row, so that the cost from aOrigin[i] to aDestination[j] is
+    aCost[i * aDestination.size() + j]. Unreachable destinations get UINT32_MAX.
+    */
+    TResult CostMatrix(const std::vector<uint32>& aForwardCost,const std::vector<uint32>& aBackwardCost,const std::vector<uint32>& aOrigin,const std::vector<uint32>& aDestination,
+                       std::vector<uint32>& aCost,size_t aThreadCount = 0) const
+        {
+        aCost.assign(aOrigin.size() * aDestination.size(),UINT32_MAX);
+        if (aForwardCost.size() != iArcUpper.size() || aBackwardCost.size() != iArcUpper.size())
+            return KErrorInvalidArgument;
+        for (uint32 n : aOrigin)
+            if (n >= iNodeCount)
+                return KErrorInvalidArgument;
+        for (uint32 n : aDestination)
+            if (n >= iNodeCount)
+                return KErrorInvalidArgument;
+        if (aThreadCount == 0)
+            aThreadCount = std::thread::hardware_concurrency();
+        aThreadCount = std::max(size_t(1),std::min(aThreadCount,std::max(aOrigin.size(),aDestination.size())));
+
+        // Fill the buckets by searching upward from the destinations, using the backward costs.
+        std::vector<std::vector<TBucketEntry>> entry_array(aThreadCount);
+        std::atomic<size_t> next(0);
+        RunInParallel(aThreadCount,[&](size_t aThreadIndex)
+            {
+            CQuery query;
+            std::vector<TBucketEntry>& entries = entry_array[aThreadIndex];
+            for (size_t j = next++; j < aDestination.size(); j = next++)
+                query.UpwardSearch(*this,aBackwardCost,aDestination[j],[&](uint32 aNode,uint32 aNodeCost)
+                    {
+                    TBucketEntry e;
+                    e.iNode = aNode;
+                    e.iDestination = uint32(j);
+                    e.iCost = aNodeCost;
+                    entries.push_back(e);
+                    });
+            });
+        std::vector<uint32> bucket_start(iNodeCount + 1,0);
+        for (const auto& entries : entry_array)
+            for (const auto& e : entries)
+                bucket_start[e.iNode + 1]++;
+        for (size_t i = 1; i <= iNodeCount; i++)
+            bucket_start[i] += bucket_start[i - 1];
+        std::vector<TBucketEntry> bucket(bucket_start[iNodeCount]);
+            {
+            std::vector<uint32> end(bucket_start.begin(),bucket_start.end() - 1);
+            for (auto& entries : entry_array)
+                {
+                for (const auto& e : entries)
+                    bucket[end[e.iNode]++] = e;
+                std::vector<TBucketEntry>().swap(entries);
+                }
+            }
+
+        // Search upward from the origins, using the forward costs, and scan the buckets.
+        next = 0;
+        RunInParallel(aThreadCount,[&](size_t /*aThreadIndex*/)
+            {
+            CQuery query;
+            for (size_t i = next++; i < aOrigin.size(); i = next++)
+                {
+                uint32* row = aCost.data() + i * aDestination.size();
+                query.UpwardSearch(*this,aForwardCost,aOrigin[i],[&](uint32 aNode,uint32 aNodeCost)
+                    {
+                    for (uint32 b = bucket_start[aNode]; b < bucket_start[aNode + 1]; b++)
+                        {
+                        uint32 c = AddCosts(aNodeCost,bucket[b].iCost);
+                        if (c < row[bucket[b].iDestination])
+                            row[bucket[b].iDestination] = c;
+                        }
+                    });
+                }
+            });
+        return KErrorNone;
+        }
+
+    /** Return the number of nodes. */
+    size_t NodeCount() const { return iNodeCount; }
+    /** Return the number of arcs in the hierarchy, including shortcuts. */
+    size_t ArcCount() const { return iArcUpper.size(); }
+    /** Return the number of levels, which limits the parallelism of customization. */
+    size_t LevelCount() const { return iLevelStart.empty() ? 0 : iLevelStart.size() - 1; }
+    /** Return the index of the first arc going upward from a node. */
+    uint32 FirstUpwardArc(uint32 aNode) const { return iUpFirst[aNode]; }
+    /** Return one more than the index of the last arc going upward from a node. */
+    uint32 EndUpwardArc(uint32 aNode) const { return iUpEnd[aNode]; }
+    /** Return the higher node of an arc. */
+    uint32 UpperNode(uint32 aArc) const { return iArcUpper[aArc]; }
+    /** Return the lower node of an arc. */
+    uint32 LowerNode(uint32 aArc) const { return iArcLower[aArc]; }
+
+    /** Write the topology to a data stream, for example when creating a map file. */
+    TResult Write(TDataOutputStream& aOutput) const
+        {
+        TResult error = aOutput.WriteUint32(uint32(iNodeCount));
+        if (!error)
+            error = WriteArray(aOutput,iArcLower);
+        if (!error)
+            error = WriteArray(aOutput,iArcUpper);
+        if (!error)
+            error = WriteArray(aOutput,iUpFirst);
+        if (!error)
+            error = WriteArray(aOutput,iUpEnd);
+        if (!error)
+            error = WriteArray(aOutput,iLevelStart);
+        if (!error)
+            error = WriteArray(aOutput,iTriangleStart);
+        if (!error)
+            error = WriteArray(aOutput,iTriangle);
+        if (!error)
+            error = WriteArray(aOutput,iInputArc);
+        return error;
+        }
+
+    /** Read a topology written by Write. */
+    TResult Read(TDataInputStream& aInput)
+        {
+        Clear();
+        TResult error = 0;
+        iNodeCount = aInput.ReadUint32(error);
+        if (!error)
+            error = ReadArray(aInput,iArcLower);
+        if (!error)
+            error = ReadArray(aInput,iArcUpper);
+        if (!error)
+            error = ReadArray(aInput,iUpFirst);
+        if (!error)
+            error = ReadArray(aInput,iUpEnd);
+        if (!error)
+            error = ReadArray(aInput,iLevelStart);
+        if (!error)
+            error = ReadArray(aInput,iTriangleStart);
+        if (!error)
+            error = ReadArray(aInput,iTriangle);
+        if (!error)
+            error = ReadArray(aInput,iInputArc);
+        if (!error && !IsValid())
+            error = KErrorCorrupt;
+        if (error)
+            Clear();
+        return error;
+        }
+
+    private:
+    /** A simple reusable barrier for the customization threads. */
+    class TBarrier
+        {
+        public:
+        TBarrier(size_t aCount): iCount(aCount) { }
+        void Wait()
+            {
+            std::unique_lock<std::mutex> lock(iMutex);
+            size_t generation = iGeneration;
+            if (++iWaiting == iCount)
+                {
+                iWaiting = 0;
+                iGeneration++;
+                iCondition.notify_all();
+                }
+            else
+                {
+                while (generation == iGeneration)
+                    iCondition.wait(lock);
+                }
+            }
+
+        private:
+        std::mutex iMutex;
+        std::condition_variable iCondition;
+        size_t iCount;
+        size_t iWaiting = 0;
+        size_t iGeneration = 0;
+        };
+
+    /** An entry in a bucket used by CostMatrix: the cost from iNode to destination number iDestination. */
+    class TBucketEntry
+        {
+        public:
+        uint32 iNode;
+        uint32 iDestination;
+        uint32 iCost;
+        };
+
+    /** Call aFunction with thread indexes 0...aThreadCount - 1, using a new thread for each index except 0. */
+    template<class TFunction> static void RunInParallel(size_t aThreadCount,TFunction aFunction)
+        {
+        std::vector<std::thread> thread_array;
+        for (size_t i = 1; i < aThreadCount; i++)
+            thread_array.emplace_back(aFunction,i);
+        aFunction(0);
+        for (auto& t : thread_array)
+            t.join();
+        }
+
+    static uint32 AddCosts(uint32 aA,uint32 aB)
+        {
+        uint64 c = uint64(aA) + aB;
+        return c >= UINT32_MAX ? UINT32_MAX : uint32(c);
+        }
+
+    /** Compute the cost of arcs by taking the cheapest of their own cost and the costs of going through their lower triangles. */
+    void CustomizeArcs(size_t aStart,size_t aEnd,std::vector<uint32>& aForwardCost,std::vector<uint32>& aBackwardCost) const
+        {
+        for (size_t a = aStart; a < aEnd; a++)
+            {
+            // For the arc (u,w) and triangle node v: u->w may go u->v->w and w->u may go w->v->u.
+            uint32 forward = aForwardCost[a];
+            uint32 backward = aBackwardCost[a];
+            for (uint32 t = iTriangleStart[a]; t < iTriangleStart[a + 1]; t++)
+                {
+                uint32 vu = iTriangle[t * 2];
+                uint32 vw = iTriangle[t * 2 + 1];
+                forward = std::min(forward,AddCosts(aBackwardCost[vu],aForwardCost[vw]));
+                backward = std::min(backward,AddCosts(aBackwardCost[vw],aForwardCost[vu]));
+                }
+            aForwardCost[a] = forward;
+            aBackwardCost[a] = backward;
+            }
+        }
+
+    /** Return the first arc of part aPart of the arcs aStart...aEnd - 1 divided into aParts parts with about the same number of triangles. */
+    size_t SplitLevel(size_t aStart,size_t aEnd,size_t aPart,size_t aParts) const
+        {
+        if (aPart >= aParts)
+            return aEnd;
+        uint64 first = iTriangleStart[aStart];
+        uint32 target = uint32(first + (iTriangleStart[aEnd] - first) * aPart / aParts);
+        return std::lower_bound(iTriangleStart.begin() + aStart,iTriangleStart.begin() + aEnd,target) - iTriangleStart.begin();
+        }
+
+    /** Return the index of the arc from aLower to aUpper, or UINT32_MAX if there is none. */
+    uint32 FindArc(uint32 aLower,uint32 aUpper) const
+        {
+        auto begin = iArcUpper.begin() + iUpFirst[aLower];
+        auto end = iArcUpper.begin() + iUpEnd[aLower];
+        auto p = std::lower_bound(begin,end,aUpper);
+        return (p != end && *p == aUpper) ? uint32(p - iArcUpper.begin()) : UINT32_MAX;
+        }
+
+    /**
+    Check a topology that has been read, so that the values used as indexes by Customize and the queries are known to be in range.
+    The arcs must be grouped by lower node, with their upper nodes in increasing order, so that FindArc can use a binary search;
+    the levels and triangle lists must be in increasing order and cover all the arcs; and every lower triangle of an arc must be made
+    of arcs in earlier levels, because Customize works on all the arcs of a level at once.
+    */
+    bool IsValid() const
+        {
+        size_t arc_count = iArcUpper.size();
+        if (arc_count > UINT32_MAX / 2 || iArcLower.size() != arc_count || iUpFirst.size() != iNodeCount || iUpEnd.size() != iNodeCount ||
+            iLevelStart.empty() || iTriangleStart.size() != arc_count + 1 || iTriangle.size() % 2)
+            return false;
+
+        size_t grouped_arcs = 0;
+        for (size_t v = 0; v < iNodeCount; v++)
+            {
+            if (iUpFirst[v] > iUpEnd[v] || iUpEnd[v] > arc_count)
+                return false;
+            for (uint32 a = iUpFirst[v]; a < iUpEnd[v]; a++)
+                if (iArcLower[a] != v || iArcUpper[a] >= iNodeCount || iArcUpper[a] == v || (a > iUpFirst[v] && iArcUpper[a] <= iArcUpper[a - 1]))
+                    return false;
+            grouped_arcs += iUpEnd[v] - iUpFirst[v];
+            }
+        if (grouped_arcs != arc_count)
+            return false;
+
+        if (iLevelStart.front() != 0 || iLevelStart.back() != arc_count || !std::is_sorted(iLevelStart.begin(),iLevelStart.end()))
+            return false;
+        if (iTriangleStart.front() != 0 || iTriangleStart.back() != iTriangle.size() / 2 || !std::is_sorted(iTriangleStart.begin(),iTriangleStart.end()))
+            return false;
+        for (size_t level = 0; level + 1 < iLevelStart.size(); level++)
+            for (size_t a = iLevelStart[level]; a < iLevelStart[level + 1]; a++)
+                for (uint32 t = iTriangleStart[a]; t < iTriangleStart[a + 1]; t++)
+                    if (iTriangle[t * 2] >= iLevelStart[level] || iTriangle[t * 2 + 1] >= iLevelStart[level])
+                        return false;
+
+        for (uint32 a : iInputArc)
+            if (a != UINT32_MAX && (a >> 1) >= arc_count)
+                return false;
+        return true;
+        }
+
+    static TResult WriteArray(TDataOutputStream& aOutput,const std::vector<uint32>& aArray)
+        {
+        TResult error = aOutput.WriteUint32(uint32(aArray.size()));
+        for (size_t i = 0; !error && i < aArray.size(); i++)
+            error = aOutput.WriteUint32(aArray[i]);
+        return error;
+        }
+
+    static TResult ReadArray(TDataInputStream& aInput,std::vector<uint32>& aArray)
+        {
+        TResult error = 0;
+        size_t size = aInput.ReadUint32(error);
+
+        // The size has not been checked, so the array grows as values are read, rather than being allocated all at once.
+        aArray.clear();
+        aArray.reserve(std::min(size,size_t(KMaxReadReserve)));
+        for (size_t i = 0; !error && i < size; i++)
+            {
+            uint32 value = aInput.ReadUint32(error);
+            if (!error)
+                aArray.push_back(value);
+            }
+        return error;
+        }
+
+    static const size_t KMinTrianglesPerThread = 4096;
+    static const size_t KMaxReadReserve = 1 << 16;
+
+    size_t iNodeCount = 0;
+    std::vector<uint32> iArcLower;      // the lower-ranked node of each arc
+    std::vector<uint32> iArcUpper;      // the higher-ranked node of each arc
+    std::vector<uint32> iUpFirst;       // the first arc whose lower node is a given node
+    std::vector<uint32> iUpEnd;         // one more than the last arc whose lower node is a given node
+    std::vector<uint32> iLevelStart;    // the first arc of each level; the arcs of level i are iLevelStart[i]...iLevelStart[i + 1] - 1
+    std::vector<uint32> iTriangleStart; // the first lower triangle of each arc, as an index into pairs of values in iTriangle
+    std::vector<uint32> iTriangle;      // the lower triangles as pairs of arcs: for arc (u,w), the arcs (v,u) and (v,w)
+    std::vector<uint32> iInputArc;      // for each input arc, the hierarchy arc times two, plus one if the input arc goes downward
+    };
+
+}
+
+#endif
@@ -249,6 +249,14 @@ class MFrameworkObserver
     inserting or deleting a pushpin or other dynamic map object.
     */
     virtual void OnDynamicDataChange() = 0;
+
+    /**
+    This virtual function is called by CAsyncMapRenderer when a newly drawn map is ready
+    to be fetched by CAsyncMapRenderer::FrontBitmap. It is called on the render thread,
+    so it should do no more than schedule a repaint on the user interface thread.
+    The default implementation does nothing.
+    */
+    virtual void OnMapBitmapReady() { }
     };
 
 /** Parameters used to set the perspective view. */
@@ -0,0 +1,406 @@
+/*
+CARTOTYPE_GLYPH_ATLAS.H
+Copyright (C) 2017 CartoType Ltd.
+See www.cartotype.com for more information.
+*/
+
+#ifndef CARTOTYPE_GLYPH_ATLAS_H__
+#define CARTOTYPE_GLYPH_ATLAS_H__
+
+#include <cartotype_base.h>
+#include <cartotype_string.h>
+#include <cartotype_cache.h>
+#include <cartotype_bitmap.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <math.h>
+#include <string.h>
+
+namespace CartoType
+{
+
+/** The key of a glyph stored in a CGlyphAtlas. */
+class TGlyphAtlasKey
+    {
+    public:
+    bool operator==(const TGlyphAtlasKey& aOther) const
+        {
+        return iTypefaceId == aOther.iTypefaceId && iSize == aOther.iSize && iGlyphId == aOther.iGlyphId &&
+               iSubpixelX == aOther.iSubpixelX && iSubpixelY == aOther.iSubpixelY;
+        }
+
+    /** A number identifying the typeface and any style, such as its address; it must be unique while the typeface exists. */
+    uint64 iTypefaceId = 0;
+    /** The em size in 64ths of a pixel. */
+    int32 iSize = 0;
+    /** The glyph index in the typeface. */
+    uint32 iGlyphId = 0;
+    /** The horizontal position of the glyph origin within a pixel, in units of 1 / CGlyphAtlas::KSubpixelSteps, as returned by CGlyphAtlas::SubpixelOffset. */
+    uint8 iSubpixelX = 0;
+    /** The vertical position of the glyph origin within a pixel, in units of 1 / CGlyphAtlas::KSubpixelSteps. */
+    uint8 iSubpixelY = 0;
+    };
+
+/** A hash function for TGlyphAtlasKey. */
+class TGlyphAtlasKeyHash
+    {
+    public:
+    size_t operator()(const TGlyphAtlasKey& aKey) const
+        {
+        uint64 h = aKey.iTypefaceId * 0x9E3779B97F4A7C15ULL;
+        h ^= (uint64(uint32(aKey.iSize)) << 32) | aKey.iGlyphId;
+        h ^= uint64(aKey.iSubpixelX) << 56 ^ uint64(aKey.iSubpixelY) << 60;
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 33;
+        return size_t(h);
+        }
+    };
+
+/** A page of a glyph atlas: an eight-bit bitmap into which glyph images are packed in horizontal shelves. */
+class CGlyphAtlasPage
+    {
+    public:
+    CGlyphAtlasPage(int32 aWidth,int32 aHeight):
+        iWidth(aWidth),
+        iHeight(aHeight),
+        iData(size_t(aWidth) * aHeight)
+        {
+        }
+
+    /** Return the width in pixels. */
+    int32 Width() const { return iWidth; }
+    /** Return the height in pixels. */
+    int32 Height() const { return iHeight; }
+    /** Return the pixel data, with one byte per pixel and Width() bytes per row. */
+    const uint8* Data() const { return iData.data(); }
+    /** Return true if the page has been discarded from the atlas. Its glyphs remain valid while the page is referenced. */
+    bool Retired() const { return iRetired; }
+
+    private:
+    friend class CGlyphAtlas;
+
+    class TShelf
+        {
+        public:
+        int32 iY;
+        int32 iHeight;
+        int32 iX;
+        };
+
+    /** Find space for an image of aWidth by aHeight pixels, returning false if there is none. */
+    bool Allocate(int32 aWidth,int32 aHeight,int32& aX,int32& aY)
+        {
+        // Leave a blank pixel between glyphs so that they can be drawn with bilinear filtering.
+        aWidth++;
+        aHeight++;
+
+        // Use the shelf that wastes least height, among those tall enough and with room.
+        TShelf* best = nullptr;
+        for (auto& shelf : iShelf)
+            if (shelf.iHeight >= aHeight && iWidth - shelf.iX >= aWidth && (!best || shelf.iHeight < best->iHeight))
+                best = &shelf;
+
+        // Start a new shelf if no shelf is suitable, or the best one is much too tall; shelf heights are rounded up to reduce their number.
+        if (!best || best->iHeight > aHeight * 3 / 2 + 4)
+            {
+            int32 height = (aHeight + 3) & ~3;
+            if (iNextShelfY + height <= iHeight && aWidth <= iWidth)
+                {
+                TShelf shelf;
+                shelf.iY = iNextShelfY;
+                shelf.iHeight = height;
+                shelf.iX = 0;
+                iShelf.push_back(shelf);
+                iNextShelfY += height;
+                best = &iShelf.back();
+                }
+            }
+        if (!best)
+            return false;
+        aX = best->iX;
+        aY = best->iY;
+        best->iX += aWidth;
+        return true;
+        }
+
+    int32 iWidth;
+    int32 iHeight;
+    std::vector<uint8> iData;
+    std::vector<TShelf> iShelf;
+    int32 iNextShelfY = 0;
+    std::atomic<bool> iRetired { false };
+    std::vector<TGlyphAtlasKey> iKey;
+    };
+
+/**
+A glyph found in a CGlyphAtlas: the position of its image in an atlas page, and the offset of the image from the glyph origin.
+The glyph holds a reference to the page, so its image remains valid even if the page is discarded from the atlas.
+*/
+class TGlyphAtlasGlyph
+    {
+    public:
+    /** Return a pointer to the top left pixel of the glyph image. */
+    const uint8* Data() const { return iPage->Data() + size_t(iY) * iPage->Width() + iX; }
+    /** Return the number of bytes per row of the glyph image. */
+    int32 RowBytes() const { return iPage->Width(); }
+    /** Return the glyph image as an eight-bit monochrome bitmap which must not be written to. */
+    TBitmap Bitmap() const { return TBitmap(TBitmap::E8BitMono,const_cast<uint8*>(Data()),iWidth,iHeight,RowBytes()); }
+
+    /** The page containing the image. */
+    std::shared_ptr<const CGlyphAtlasPage> iPage;
+    /** The left edge of the image in the page. */
+    int32 iX = 0;
+    /** The top edge of the image in the page. */
+    int32 iY = 0;
+    /** The width of the image in pixels. */
+    int32 iWidth = 0;
+    /** The height of the image in pixels. */
+    int32 iHeight = 0;
+    /** The horizontal offset of the left edge of the image from the glyph origin in pixels. */
+    int32 iLeft = 0;
+    /** The vertical offset of the top edge of the image from the glyph origin in pixels; negative for glyphs above the baseline. */
+    int32 iTop = 0;
+    /** The advance width in 64ths of a pixel. */
+    int32 iAdvance = 0;
+    };
+
+/**
+A thread-safe cache of rasterized glyph images, packed into a few large eight-bit bitmaps (pages) so that they take little memory,
+can be drawn quickly, and are shared between frames and between threads, such as the worker threads of a CVectorTileServer.
+
+Glyphs are keyed by typeface, size, glyph index and subpixel position. The index is a CShardedHashCache, so lookups from different
+threads rarely contend. When all the pages are full, the oldest page is discarded and its glyphs are removed from the index;
+glyphs from it that are still being drawn remain valid because they hold references to it.
+The numbers of hits and misses are counted so that the atlas can be sized to give a good hit rate.
+*/
+class CGlyphAtlas
+    {
+    public:
+    /** Create an atlas with a maximum total size of aMaxBytes, made of pages of aPageSize by aPageSize pixels. */
+    CGlyphAtlas(size_t aMaxBytes = KDefaultMaxBytes,int32 aPageSize = KDefaultPageSize):
+        iPageSize(aPageSize >= 64 ? aPageSize : 64),
+        iMaxPages(MaxPages(aMaxBytes)),
+        iIndex(MaxIndexSize())
+        {
+        }
+
+    /** Return the atlas shared by the whole process. */
+    static CGlyphAtlas& Global()
+        {
+        static CGlyphAtlas atlas;
+        return atlas;
+        }
+
+    /**
+    Return the subpixel offset for a coordinate, as used in TGlyphAtlasKey, and set aPixel to the pixel containing the coordinate,
+    adjusted if the coordinate is rounded up to the next pixel.
+    */
+    static uint8 SubpixelOffset(double aCoordinate,int32& aPixel)
+        {
+        double pixel = floor(aCoordinate);
+        int32 offset = int32((aCoordinate - pixel) * KSubpixelSteps + 0.5);
+        if (offset == KSubpixelSteps)
+            {
+            offset = 0;
+            pixel += 1;
+            }
+        aPixel = int32(pixel);
+        return uint8(offset);
+        }
+
+    /** Find a glyph. Return true and set aGlyph if it is found, otherwise return false. */
+    bool Find(const TGlyphAtlasKey& aKey,TGlyphAtlasGlyph& aGlyph)
+        {
+        std::shared_ptr<CEntry> entry = iIndex.Find(aKey);
+        if (entry && !entry->iGlyph.iPage->Retired())
+            {
+            iHitCount++;
+            aGlyph = entry->iGlyph;
+            return true;
+            }
+        iMissCount++;
+        return false;
+        }
+
+    /**
+    Add a glyph image, which must be an eight-bit monochrome bitmap, to the atlas, and set aGlyph to refer to the copy in the atlas.
+    aLeft and aTop give the offset of the image from the glyph origin, and aAdvance is the advance width in 64ths of a pixel.
+    Returns KErrorInvalidArgument if the image is in another format or too large to fit in a page; such glyphs should be drawn directly.
+    */
+    TResult Add(const TGlyphAtlasKey& aKey,const TBitmap& aImage,int32 aLeft,int32 aTop,int32 aAdvance,TGlyphAtlasGlyph& aGlyph)
+        {
+        int32 width = aImage.Width();
+        int32 height = aImage.Height();
+        if (aImage.Type() != TBitmap::E8BitMono || width < 0 || height < 0 || width >= iPageSize || height >= iPageSize)
+            return KErrorInvalidArgument;
+
+        std::shared_ptr<CEntry> entry(new CEntry);
+        entry->iKey = aKey;
+        TGlyphAtlasGlyph& glyph = entry->iGlyph;
+        glyph.iWidth = width;
+        glyph.iHeight = height;
+        glyph.iLeft = aLeft;
+        glyph.iTop = aTop;
+        glyph.iAdvance = aAdvance;
+
+            {
+            std::lock_guard<std::mutex> lock(iPageMutex);
+            std::shared_ptr<CGlyphAtlasPage> page = PageWithSpace(width,height,glyph.iX,glyph.iY);
+            for (int32 y = 0; y < height; y++)
+                memcpy(page->iData.data() + size_t(glyph.iY + y) * iPageSize + glyph.iX,aImage.Data() + y * aImage.RowBytes(),width);
+            page->iKey.push_back(aKey);
+            glyph.iPage = page;
+            iIndex.Add(entry);
+            }
+
+        aGlyph = glyph;
+        return KErrorNone;
+        }
+
+    /** Discard all glyphs. Glyphs in use remain valid while they are referenced. */
+    void Clear()
+        {
+        std::lock_guard<std::mutex> lock(iPageMutex);
+        for (auto& page : iPage)
+            page->iRetired = true;
+        iPage.clear();
+        iCurrentPage = 0;
+        iIndex.Clear();
+        }
+
+    /**
+    Set the maximum total size of the pages in bytes. At least one page is always allowed.
+    If there are too many pages the oldest ones are discarded, keeping the current page.
+    */
+    void SetMaxBytes(size_t aMaxBytes)
+        {
+        std::lock_guard<std::mutex> lock(iPageMutex);
+        iMaxPages = MaxPages(aMaxBytes);
+        if (iPage.size() > iMaxPages)
+            {
+            // Put the pages in order from oldest to newest, then discard from the start.
+            std::rotate(iPage.begin(),iPage.begin() + (iCurrentPage + 1) % iPage.size(),iPage.end());
+            size_t excess = iPage.size() - iMaxPages;
+            for (size_t i = 0; i < excess; i++)
+                Retire(*iPage[i]);
+            iPage.erase(iPage.begin(),iPage.begin() + excess);
+            iCurrentPage = iPage.size() - 1;
+            }
+        iIndex.SetMaxSize(MaxIndexSize());
+        }
+
+    /** Return the width and height of the pages. */
+    int32 PageSize() const { return iPageSize; }
+    /** Return the number of pages. */
+    size_t PageCount()
+        {
+        std::lock_guard<std::mutex> lock(iPageMutex);
+        return iPage.size();
+        }
+    /** Return the number of glyphs in the atlas. */
+    size_t GlyphCount() const { return iIndex.Count(); }
+    /** Return the number of times a glyph was found in the atlas. */
+    uint64 HitCount() const { return iHitCount; }
+    /** Return the number of times a glyph was not found in the atlas. */
+    uint64 MissCount() const { return iMissCount; }
+    /** Return the proportion of lookups that found a glyph, in the range 0...1. */
+    double HitRate() const
+        {
+        uint64 hits = iHitCount;
+        uint64 total = hits + iMissCount;
+        return total ? double(hits) / double(total) : 0;
+        }
+    /** Return the number of pages discarded to make room for new glyphs. */
+    uint64 EvictionCount() const { return iEvictionCount; }
+    /** Set the hit, miss and eviction counts to zero. */
+    void ResetStatistics() { iHitCount = 0; iMissCount = 0; iEvictionCount = 0; }
+
+    enum
+        {
+        /** The default width and height of a page in pixels. */
+        KDefaultPageSize = 1024,
+        /** The default maximum total size of the pages in bytes. */
+        KDefaultMaxBytes = 16 * 1024 * 1024,
+        /** The number of subpixel positions per pixel at which glyphs are rendered. */
+        KSubpixelSteps = 4
+        };
+
+    private:
+    CGlyphAtlas(const CGlyphAtlas&) = delete;
+    CGlyphAtlas& operator=(const CGlyphAtlas&) = delete;
+
+    /** An index entry; its size, used to limit the size of the index, is its area. */
+    class CEntry
+        {
+        public:
+        const TGlyphAtlasKey& Key() const { return iKey; }
+        int32 Size() const { return std::max(1,iGlyph.iWidth * iGlyph.iHeight); }
+
+        TGlyphAtlasKey iKey;
+        TGlyphAtlasGlyph iGlyph;
+        };
+
+    size_t MaxPages(size_t aMaxBytes) const
+        {
+        size_t n = aMaxBytes / (size_t(iPageSize) * iPageSize);
+        return n ? n : 1;
+        }
+
+    int32 MaxIndexSize() const
+        {
+        uint64 n = uint64(iMaxPages) * iPageSize * iPageSize;
+        return n > INT32_MAX ? INT32_MAX : int32(n);
+        }
+
+    /** Return a page with space for an image, allocating space in it; discard the oldest page if necessary. Called with iPageMutex locked. */
+    std::shared_ptr<CGlyphAtlasPage> PageWithSpace(int32 aWidth,int32 aHeight,int32& aX,int32& aY)
+        {
+        if (!iPage.empty() && iPage[iCurrentPage]->Allocate(aWidth,aHeight,aX,aY))
+            return iPage[iCurrentPage];
+
+        // Use a new page, or replace the oldest one, which is the one after the current page.
+        // A new page is inserted after the current page so that the pages stay in order of age if the limit has been raised.
+        std::shared_ptr<CGlyphAtlasPage> page(new CGlyphAtlasPage(iPageSize,iPageSize));
+        if (iPage.size() < iMaxPages)
+            {
+            iCurrentPage = iPage.empty() ? 0 : iCurrentPage + 1;
+            iPage.insert(iPage.begin() + iCurrentPage,page);
+            }
+        else
+            {
+            iCurrentPage = (iCurrentPage + 1) % iPage.size();
+            Retire(*iPage[iCurrentPage]);
+            iPage[iCurrentPage] = page;
+            iEvictionCount++;
+            }
+        page->Allocate(aWidth,aHeight,aX,aY);
+        return page;
+        }
+
+    /** Mark a page as retired and remove its glyphs from the index, unless they have been replaced by glyphs on other pages. */
+    void Retire(CGlyphAtlasPage& aPage)
+        {
+        aPage.iRetired = true;
+        for (const auto& key : aPage.iKey)
+            iIndex.RemoveIf(key,[&aPage](const CEntry& aEntry) { return aEntry.iGlyph.iPage.get() == &aPage; });
+        aPage.iKey.clear();
+        }
+
+    int32 iPageSize;
+    size_t iMaxPages;
+    CShardedHashCache<CEntry,TGlyphAtlasKey,TGlyphAtlasKeyHash> iIndex;
+    std::mutex iPageMutex;
+    std::vector<std::shared_ptr<CGlyphAtlasPage>> iPage;
+    size_t iCurrentPage = 0;
+    std::atomic<uint64> iHitCount { 0 };
+    std::atomic<uint64> iMissCount { 0 };
+    std::atomic<uint64> iEvictionCount { 0 };
+    };
+
+}
+
+#endif
@@ -8,6 +8,14 @@ See www.cartotype.com for more information.
 #define CARTOTYPE_GRAPH_H__
 
 #include <cartotype_tree.h>
+#include <cartotype_heap.h>
+#include <cartotype_stream.h>
+#include <functional>
+#include <atomic>
+#include <thread>
+#include <unordered_map>
+#include <algorithm>
+#include <queue>
 
 namespace CartoType
 {
@@ -36,11 +44,17 @@ TArcRef Arc() - return the current arc;
 uint32 Cost() - return the cost of the current arc;
 TNode* EndNode() - return the end node of the current arc.
 
-The class TNode must fulfil the requirements of CPointerTree.
+The class TNode must fulfil the requirements of the open set class TOpenSet.
 
 The class TArcRef is a pointer, or an integer, or any other small type that can be copied and assigned. The value zero must mean null.
+
+The class TOpenSet holds the nodes that have been reached but not yet closed, ordered by cost. It must be constructible
+from a boolean value indicating whether it owns its nodes, and must have the functions Clear, Count, Insert, Min,
+Delete(TNode*,bool aTakeOwnership), BeginKeyChange and EndKeyChange, as provided by CPointerTree (the default),
+CIndexedHeap and CRadixHeap. The heaps are faster for large graphs; CRadixHeap can be used because
+the costs of the nodes taken from the open set never decrease.
 */
-template<class TGraph,class TNode,class TArcRef> class TDijkstra
+template<class TGraph,class TNode,class TArcRef,class TOpenSet = CPointerTree<TNode,uint32>> class TDijkstra
     {
     public:
     TDijkstra(TGraph& aGraph,bool aOwnNodeLists,bool aOutgoing):
@@ -51,19 +65,30 @@ template<class TGraph,class TNode,class TArcRef> class TDijkstra
         {
         }
 
-    static TResult CalculateRoutesBidirectionally(TGraph& aGraph,TNode* aStartNode,TNode* aEndNode,const TNode*& aMiddleNode)
+    /**
+    Calculate routes from the start node forwards and from the end node backwards until they meet.
+    If aLowerBound is supplied, the searches are directed towards each other using it (bidirectional A*):
+    it must return a lower bound on the cost from a node to the end node, if aForwards is true, or from the start node to a node,
+    if aForwards is false. The bounds must be consistent: the bound for a node must not exceed the cost of an arc plus the
+    bound for the node at the other end. Lower bounds obtained from CLandmarkTable are consistent.
+    When aLowerBound is supplied the open sets are held by the function itself and TOpenSet is not used.
+    */
+    static TResult CalculateRoutesBidirectionally(TGraph& aGraph,TNode* aStartNode,TNode* aEndNode,const TNode*& aMiddleNode,
+                                                  std::function<uint32 (const TNode* aNode,bool aForwards)> aLowerBound = nullptr)
         {
         Assert(aStartNode);
         Assert(aEndNode);
+        if (aLowerBound)
+            return CalculateRoutesWithPotential(aGraph,aStartNode,aEndNode,aMiddleNode,aLowerBound);
         
         TResult error = 0;
         aGraph.Reset();
         aMiddleNode = nullptr;
         
-        TDijkstra<TGraph,TNode,TArcRef> forward_dijkstra(aGraph,false,true);
+        TDijkstra forward_dijkstra(aGraph,false,true);
         forward_dijkstra.Open(aStartNode,0,0);
               
-        TDijkstra<TGraph,TNode,TArcRef> backward_dijkstra(aGraph,false,false);
+        TDijkstra backward_dijkstra(aGraph,false,false);
         backward_dijkstra.Open(aEndNode,0,0);
         
         uint64 max_cost = UINT64_MAX;
@@ -161,6 +186,169 @@ template<class TGraph,class TNode,class TArcRef> class TDijkstra
         return error;
         }
 
+    /**
+    Calculate the costs of the best routes from aStartNode to each of the nodes in aTargets, or to aStartNode
+    from each of them if the object was constructed with aOutgoing false, stopping when all the targets have been reached
+    or the cost exceeds aMaxCost. The costs are returned in aCost, in the order of aTargets; unreached targets get UINT32_MAX.
+    */
+    TResult CalculateRoutesToTargets(TNode* aStartNode,const std::vector<TNode*>& aTargets,std::vector<uint32>& aCost,uint32 aMaxCost = UINT32_MAX)
+        {
+        aCost.assign(aTargets.size(),UINT32_MAX);
+        std::unordered_multimap<const TNode*,size_t> target_index;
+        for (size_t i = 0; i < aTargets.size(); i++)
+            target_index.insert(std::make_pair(aTargets[i],i));
+        size_t targets_left = aTargets.size();
+
+        TResult error = 0;
+        iGraph.Reset();
+        iOpen.Clear();
+        Open(aStartNode,0,0);
+        iSteps = 0;
+        while (!error && targets_left && iOpen.Count())
+            {
+            TNode* n = iOpen.Min();
+            uint32 cost = iGraph.Cost(n);
+            if (cost > aMaxCost)
+                {
+                iOpen.Delete(n);
+                iGraph.Close(n);
+                break;
+                }
+            auto range = target_index.equal_range(n);
+            for (auto p = range.first; p != range.second; ++p)
+                {
+                aCost[p->second] = cost;
+                targets_left--;
+                }
+            error = CalculateRouteStep(n);
+            }
+        return error;
+        }
+
+    /**
+    Calculate a matrix of the costs of the best routes from each node in aOrigin to each node in aDestination,
+    using one-to-many searches. The nodes are given as indexes, and TGraph must have the function TNode* Node(size_t aIndex).
+    The searches are shared between threads, one for each graph in aGraphArray; each graph must be a separate copy
+    of the same graph, because the graph stores the state of the search.
+
+    The costs are returned in aCost, row by row, so that the cost from aOrigin[i] to aDestination[j] is
+    aCost[i * aDestination.size() + j]. Unreachable destinations get UINT32_MAX.
+    */
+    static TResult CalculateCostMatrix(const std::vector<TGraph*>& aGraphArray,const std::vector<size_t>& aOrigin,const std::vector<size_t>& aDestination,
+                                       std::vector<uint32>& aCost,uint32 aMaxCost = UINT32_MAX)
+        {
+        aCost.assign(aOrigin.size() * aDestination.size(),UINT32_MAX);
+        if (aGraphArray.empty())
+            return KErrorInvalidArgument;
+        std::atomic<size_t> next_origin(0);
+        std::atomic<TResult> error(KErrorNone);
+        auto work = [&](TGraph* aGraph)
+            {
+            std::vector<TNode*> target(aDestination.size());
+            for (size_t j = 0; j < aDestination.size(); j++)
+                target[j] = aGraph->Node(aDestination[j]);
+            TDijkstra dijkstra(*aGraph,false,true);
+            std::vector<uint32> cost;
+            for (size_t i = next_origin++; i < aOrigin.size() && !error; i = next_origin++)
+                {
+                TResult e = dijkstra.CalculateRoutesToTargets(aGraph->Node(aOrigin[i]),target,cost,aMaxCost);
+                if (e)
+                    error = e;
+                else
+                    std::copy(cost.begin(),cost.end(),aCost.begin() + i * aDestination.size());
+                }
+            };
+        std::vector<std::thread> thread_array;
+        for (size_t i = 1; i < aGraphArray.size() && i < aOrigin.size(); i++)
+            thread_array.emplace_back(work,aGraphArray[i]);
+        work(aGraphArray[0]);
+        for (auto& t : thread_array)
+            t.join();
+        return error;
+        }
+
+    /**
+    Calculate isochrones for several cost thresholds and any number of start nodes in a single search.
+    aMaxCost gives the thresholds in increasing order. aHandler is called for every node reached, other than the
+    start nodes, with the index of the first threshold the cost of the node is less than, or aMaxCost.size() for nodes just beyond the
+    largest threshold, which are reached but not expanded. The isochrone for threshold i is therefore made from the nodes
+    with indexes up to i, so the isochrones for all the thresholds are nested.
+    */
+    TResult CalculateIsochrones(const std::vector<TNode*>& aStartNodes,const std::vector<uint32>& aMaxCost,std::function<void (const TNode* aNode,size_t aBand)> aHandler)
+        {
+        if (aStartNodes.empty() || aMaxCost.empty() || !std::is_sorted(aMaxCost.begin(),aMaxCost.end()))
+            return KErrorInvalidArgument;
+        TResult error = 0;
+        iGraph.Reset();
+        iOpen.Clear();
+        std::vector<TNode*> start(aStartNodes);
+        std::sort(start.begin(),start.end());
+        start.erase(std::unique(start.begin(),start.end()),start.end());
+        for (auto n : start)
+            Open(n,0,0);
+
+        // Close the start nodes so that arcs between them are ignored: they cannot be improved on, and have no previous arc, so they would be opened again.
+        for (auto n : start)
+            iGraph.Close(n);
+        iSteps = 0;
+        size_t band = 0;
+        while (!error && iOpen.Count())
+            {
+            TNode* n = iOpen.Min();
+            uint32 cost = iGraph.Cost(n);
+            while (band < aMaxCost.size() && cost >= aMaxCost[band])
+                band++;
+            if (band == aMaxCost.size())
+                {
+                iOpen.Delete(n);
+                iGraph.Close(n);
+                }
+            else
+                error = CalculateRouteStep(n);
+            if (iGraph.Previous(n))
+                aHandler(n,band);
+            }
+        return error;
+        }
+
+    /**
+    Calculate isochrones for a batch of queries in parallel, using one thread for each graph in aGraphArray; each graph must be a separate copy
+    of the same graph, because the graph stores the state of the search. Each query is a set of start nodes given as indexes,
+    and TGraph must have the function TNode* Node(size_t aIndex). The thresholds in aMaxCost are used for every query, as in CalculateIsochrones.
+
+    aHandler is called with the index of the query, the graph used, a node and its band index. It is called on several threads
+    at once, but all the calls for any one query are made on the same thread, and the node is valid only during the call.
+    */
+    static TResult CalculateIsochronesInParallel(const std::vector<TGraph*>& aGraphArray,const std::vector<std::vector<size_t>>& aQuery,const std::vector<uint32>& aMaxCost,
+                                                 std::function<void (size_t aQueryIndex,TGraph& aGraph,const TNode* aNode,size_t aBand)> aHandler)
+        {
+        if (aGraphArray.empty())
+            return KErrorInvalidArgument;
+        std::atomic<size_t> next_query(0);
+        std::atomic<TResult> error(KErrorNone);
+        auto work = [&](TGraph* aGraph)
+            {
+            TDijkstra dijkstra(*aGraph,false,true);
+            std::vector<TNode*> start;
+            for (size_t i = next_query++; i < aQuery.size() && !error; i = next_query++)
+                {
+                start.clear();
+                for (auto index : aQuery[i])
+                    start.push_back(aGraph->Node(index));
+                TResult e = dijkstra.CalculateIsochrones(start,aMaxCost,[&](const TNode* aNode,size_t aBand) { aHandler(i,*aGraph,aNode,aBand); });
+                if (e)
+                    error = e;
+                }
+            };
+        std::vector<std::thread> thread_array;
+        for (size_t i = 1; i < aGraphArray.size() && i < aQuery.size(); i++)
+            thread_array.emplace_back(work,aGraphArray[i]);
+        work(aGraphArray[0]);
+        for (auto& t : thread_array)
+            t.join();
+        return error;
+        }
+
     /** Extend an existing query by performing further steps. */
     TResult ExtendRoutes(int32 aMaxSteps,uint32 aMaxCost = UINT32_MAX,TNode* aEndNode = nullptr)
         {
@@ -180,6 +368,164 @@ template<class TGraph,class TNode,class TArcRef> class TDijkstra
         }
     
     private:
+    /**
+    One direction of the search made by CalculateRoutesWithPotential. Open nodes are ordered by twice their cost plus the potential,
+    for the forward search, or minus it, for the backward search. The keys are held in a binary heap with the nodes; when the cost
+    of a node is reduced it is added again, and the out-of-date entries are discarded when they reach the top.
+    */
+    class TPotentialSearch
+        {
+        public:
+        TPotentialSearch(TGraph& aGraph,bool aForwards,std::function<int64 (TNode* aNode)>& aPotential):
+            iGraph(aGraph),
+            iForwards(aForwards),
+            iPotential(aPotential)
+            {
+            }
+
+        void Open(TNode* aNode,uint32 aCost,TArcRef aPrevArc)
+            {
+            iGraph.Set(aNode,aCost,aPrevArc);
+            iOpen.push(TEntry(Key(aNode),aNode));
+            }
+
+        /** Return the open node with the smallest key, and the key in aKey, or null if there are no open nodes. */
+        TNode* Min(int64& aKey)
+            {
+            while (!iOpen.empty())
+                {
+                const TEntry& e = iOpen.top();
+                if (e.first == Key(e.second))
+                    {
+                    aKey = e.first;
+                    return e.second;
+                    }
+                iOpen.pop();
+                }
+            return nullptr;
+            }
+
+        /**
+        Close the node just returned by Min, record it in aBestCost and aMiddleNode if it is reached by the other search and gives a
+        cheaper route, and if aExpand is true open or update the nodes at the ends of its arcs, recording them in the same way.
+        */
+        TResult Close(TNode* aNode,bool aExpand,uint64& aBestCost,const TNode*& aMiddleNode)
+            {
+            iOpen.pop();
+            iGraph.Close(aNode);
+            uint32 node_cost = iGraph.Cost(aNode);
+            Meet(aNode,node_cost,aBestCost,aMiddleNode);
+            if (!aExpand)
+                return 0;
+            typename TGraph::TArcIterator iter(iGraph.ArcIterator(aNode,iForwards));
+            TResult error = 0;
+            while (iter.Next(error))
+                {
+                uint64 c = uint64(node_cost) + iter.Cost();
+                if (c > UINT32_MAX - 1)
+                    c = UINT32_MAX - 1;
+                TNode* end_node = iter.EndNode();
+                if (!iGraph.Previous(end_node) || c < iGraph.Cost(end_node))
+                    {
+                    Open(end_node,uint32(c),iter.Arc());
+                    Meet(end_node,uint32(c),aBestCost,aMiddleNode);
+                    }
+                }
+            return error;
+            }
+
+        private:
+        typedef std::pair<int64,TNode*> TEntry;
+
+        int64 Key(TNode* aNode)
+            {
+            int64 p = iPotential(aNode);
+            return 2 * int64(iGraph.Cost(aNode)) + (iForwards ? p : -p);
+            }
+
+        void Meet(TNode* aNode,uint32 aCost,uint64& aBestCost,const TNode*& aMiddleNode)
+            {
+            uint64 other_cost = iGraph.NodeCostInQuery(aNode,!iForwards);
+            if (other_cost < UINT32_MAX && aBestCost > aCost + other_cost)
+                {
+                aBestCost = aCost + other_cost;
+                aMiddleNode = aNode;
+                }
+            }
+
+        TGraph& iGraph;
+        bool iForwards;
+        std::function<int64 (TNode* aNode)>& iPotential;
+        std::priority_queue<TEntry,std::vector<TEntry>,std::greater<TEntry>> iOpen;
+        };
+
+    /**
+    Bidirectional A* search, used by CalculateRoutesBidirectionally when a lower bound is supplied. Both searches use the
+    average potential p(v) = (aLowerBound(v,true) - aLowerBound(v,false)) / 2: the forward search takes nodes in order of cost plus p,
+    and the backward search in order of cost minus p. That is the same as two Dijkstra searches on the graph with each arc cost
+    reduced by the potential at its start and increased by the potential at its end, which are not negative if the bounds are consistent.
+    So the search can stop when the smallest forward and backward keys add up to at least the cost of the best route found:
+    the potentials at the two ends cancel out. Keys are doubled so that they are whole numbers.
+
+    A node is also closed without being expanded if its cost plus the lower bound for the rest of the route is no better than the best
+    route found so far.
+    */
+    static TResult CalculateRoutesWithPotential(TGraph& aGraph,TNode* aStartNode,TNode* aEndNode,const TNode*& aMiddleNode,
+                                                std::function<uint32 (const TNode* aNode,bool aForwards)>& aLowerBound)
+        {
+        TResult error = 0;
+        aGraph.Reset();
+        aMiddleNode = nullptr;
+
+        // The potential of each node is needed every time an entry for it is examined, so it is calculated once and stored.
+        std::unordered_map<const TNode*,int64> potential_map;
+        std::function<int64 (TNode* aNode)> potential = [&](TNode* aNode)
+            {
+            auto p = potential_map.find(aNode);
+            if (p != potential_map.end())
+                return p->second;
+            int64 value = int64(aLowerBound(aNode,true)) - int64(aLowerBound(aNode,false));
+            potential_map.insert(std::make_pair(aNode,value));
+            return value;
+            };
+
+        TPotentialSearch forward(aGraph,true,potential);
+        forward.Open(aStartNode,0,0);
+        TPotentialSearch backward(aGraph,false,potential);
+        backward.Open(aEndNode,0,0);
+        int64 f_start_key = 0, b_start_key = 0;
+        forward.Min(f_start_key);
+        backward.Min(b_start_key);
+
+        uint64 best_cost = UINT64_MAX;
+        while (!error)
+            {
+            int64 f_key = 0, b_key = 0;
+            TNode* f = forward.Min(f_key);
+            TNode* b = backward.Min(b_key);
+
+            // If either search has run out of nodes, every route has been seen by it.
+            if (!f || !b)
+                break;
+            if (best_cost != UINT64_MAX && f_key + b_key >= int64(2 * best_cost))
+                break;
+
+            // Advance the search which is less far from its own starting point.
+            if (f_key - f_start_key <= b_key - b_start_key)
+                {
+                bool expand = best_cost == UINT64_MAX || aGraph.Cost(f) + uint64(aLowerBound(f,true)) < best_cost;
+                error = forward.Close(f,expand,best_cost,aMiddleNode);
+                }
+            else
+                {
+                bool expand = best_cost == UINT64_MAX || aGraph.Cost(b) + uint64(aLowerBound(b,false)) < best_cost;
+                error = backward.Close(b,expand,best_cost,aMiddleNode);
+                }
+            }
+
+        return error;
+        }
+
     void Open(TNode* aNode,uint32 aCost,TArcRef aPrevArc)
         {
         iGraph.Set(aNode,aCost,aPrevArc);
@@ -188,9 +534,9 @@ template<class TGraph,class TNode,class TArcRef> class TDijkstra
     
     void Promote(TNode* aNode,uint32 aCost,TArcRef aPrevArc)
         {
-        iOpen.Delete(aNode,true);
+        iOpen.BeginKeyChange(aNode);
         iGraph.Set(aNode,aCost,aPrevArc);
-        iOpen.Insert(aNode);
+        iOpen.EndKeyChange(aNode);
         }
     
     TResult CalculateRouteStep(TNode* aNode)
@@ -226,11 +572,181 @@ template<class TGraph,class TNode,class TArcRef> class TDijkstra
         }
     
     TGraph& iGraph;
-    CPointerTree<TNode,uint32> iOpen;
+    TOpenSet iOpen;
     bool iOutgoing;
     int32 iSteps;
     };
 
+/**
+A table of costs to and from a small number of landmark nodes, used to obtain lower bounds
+on the cost between any two nodes for the ALT (A*, landmarks and triangle inequality) method.
+By the triangle inequality, the cost from v to t is at least cost(L,t) - cost(L,v) and at least
+cost(v,L) - cost(t,L), for any landmark L. The bounds are valid for the route profile used
+to create the table, and for any profile giving costs no lower than it.
+
+Landmarks are chosen by the 'farthest' method: each new landmark is the node farthest from
+the landmarks already chosen, which tends to place them near the edges of the graph, where they
+give the tightest bounds.
+
+The table can be created once and saved, for example when a map file is made, or created on first use.
+
+In addition to the requirements of TDijkstra, the class TGraph must have the functions:
+
+size_t NodeCount() - return the number of nodes in the graph;
+TNode* Node(size_t aIndex) - return the node with a given index, from 0 to NodeCount() - 1;
+size_t NodeIndex(const TNode* aNode) - return the index of a node.
+*/
+template<class TGraph,class TNode,class TArcRef,class TOpenSet = CIndexedHeap<TNode,uint32>> class CLandmarkTable
+    {
+    public:
+    /** Create the table for aGraph with up to aLandmarkCount landmarks, starting the search for landmarks at aSeedNode. */
+    TResult Create(TGraph& aGraph,size_t aLandmarkCount,TNode* aSeedNode)
+        {
+        Clear();
+        iNodeCount = aGraph.NodeCount();
+        if (!iNodeCount || !aLandmarkCount || !aSeedNode)
+            return KErrorInvalidArgument;
+
+        // The minimum cost from any landmark chosen so far to each node; the next landmark is the node maximizing it.
+        std::vector<uint32> min_cost(iNodeCount,UINT32_MAX);
+        TResult error = 0;
+        std::vector<uint32> cost;
+        error = CalculateCosts(aGraph,aSeedNode,true,cost);
+        TNode* landmark = Farthest(aGraph,cost,min_cost);
+        while (!error && landmark && iLandmark.size() < aLandmarkCount)
+            {
+            iLandmark.push_back(uint32(aGraph.NodeIndex(landmark)));
+            std::vector<uint32> from_cost;
+            error = CalculateCosts(aGraph,landmark,true,from_cost);
+            if (!error)
+                error = CalculateCosts(aGraph,landmark,false,cost);
+            if (error)
+                break;
+            iCostFrom.insert(iCostFrom.end(),from_cost.begin(),from_cost.end());
+            iCostTo.insert(iCostTo.end(),cost.begin(),cost.end());
+            for (size_t i = 0; i < iNodeCount; i++)
+                if (min_cost[i] > from_cost[i])
+                    min_cost[i] = from_cost[i];
+            landmark = Farthest(aGraph,min_cost,min_cost);
+            }
+        if (error)
+            Clear();
+        return error;
+        }
+
+    void Clear()
+        {
+        iNodeCount = 0;
+        iLandmark.clear();
+        iCostFrom.clear();
+        iCostTo.clear();
+        }
+
+    /** Return a lower bound on the cost of a route from aFrom to aTo. */
+    uint32 LowerBound(size_t aFromIndex,size_t aToIndex) const
+        {
+        uint32 bound = 0;
+        for (size_t i = 0; i < iLandmark.size(); i++)
+            {
+            const uint32* from = iCostFrom.data() + i * iNodeCount;
+            const uint32* to = iCostTo.data() + i * iNodeCount;
+            if (from[aToIndex] != UINT32_MAX && from[aFromIndex] != UINT32_MAX && from[aToIndex] > from[aFromIndex] && from[aToIndex] - from[aFromIndex] > bound)
+                bound = from[aToIndex] - from[aFromIndex];
+            if (to[aFromIndex] != UINT32_MAX && to[aToIndex] != UINT32_MAX && to[aFromIndex] > to[aToIndex] && to[aFromIndex] - to[aToIndex] > bound)
+                bound = to[aFromIndex] - to[aToIndex];
+            }
+        return bound;
+        }
+
+    /** Return the number of landmarks. */
+    size_t LandmarkCount() const { return iLandmark.size(); }
+    /** Return the number of nodes in the graph for which the table was created. */
+    size_t NodeCount() const { return iNodeCount; }
+
+    /** Write the table to a data stream. */
+    TResult Write(TDataOutputStream& aOutput) const
+        {
+        TResult error = aOutput.WriteUint32(uint32(iNodeCount));
+        if (!error)
+            error = aOutput.WriteUint32(uint32(iLandmark.size()));
+        for (size_t i = 0; !error && i < iLandmark.size(); i++)
+            error = aOutput.WriteUint32(iLandmark[i]);
+        for (size_t i = 0; !error && i < iCostFrom.size(); i++)
+            error = aOutput.WriteUint32(iCostFrom[i]);
+        for (size_t i = 0; !error && i < iCostTo.size(); i++)
+            error = aOutput.WriteUint32(iCostTo[i]);
+        return error;
+        }
+
+    /**
+    Read a table written by Write. aNodeCount is the number of nodes in the graph the table is to be used with:
+    a table made for a graph of a different size, or with more than KMaxLandmarks landmarks, or with landmark
+    indexes out of range, is rejected. The costs are read one landmark at a time, so that a truncated or corrupt stream
+    cannot cause more memory to be allocated than a valid table for the graph would use.
+    */
+    TResult Read(TDataInputStream& aInput,size_t aNodeCount)
+        {
+        Clear();
+        TResult error = 0;
+        size_t node_count = aInput.ReadUint32(error);
+        size_t landmark_count = error ? 0 : aInput.ReadUint32(error);
+        if (!error && (node_count != aNodeCount || !node_count || landmark_count > node_count || landmark_count > KMaxLandmarks))
+            error = KErrorCorrupt;
+        for (size_t i = 0; !error && i < landmark_count; i++)
+            {
+            uint32 landmark = aInput.ReadUint32(error);
+            if (!error && landmark >= node_count)
+                error = KErrorCorrupt;
+            iLandmark.push_back(landmark);
+            }
+        for (size_t i = 0; !error && i < 2 * landmark_count; i++)
+            {
+            std::vector<uint32>& cost = i < landmark_count ? iCostFrom : iCostTo;
+            cost.reserve(cost.size() + node_count);
+            for (size_t j = 0; !error && j < node_count; j++)
+                cost.push_back(aInput.ReadUint32(error));
+            }
+        if (error)
+            Clear();
+        else
+            iNodeCount = node_count;
+        return error;
+        }
+
+    /** The maximum number of landmarks accepted by Read. */
+    static const size_t KMaxLandmarks = 256;
+
+    private:
+    /** Get the cost from aNode to every node, or from every node to aNode if aOutgoing is false; unreachable nodes get UINT32_MAX. */
+    TResult CalculateCosts(TGraph& aGraph,TNode* aNode,bool aOutgoing,std::vector<uint32>& aCost)
+        {
+        TDijkstra<TGraph,TNode,TArcRef,TOpenSet> dijkstra(aGraph,false,aOutgoing);
+        TResult error = dijkstra.CalculateRoutes(aNode,INT32_MAX);
+        aCost.resize(iNodeCount);
+        for (size_t i = 0; i < iNodeCount; i++)
+            {
+            TNode* n = aGraph.Node(i);
+            aCost[i] = (n == aNode || aGraph.Previous(n)) ? aGraph.Cost(n) : UINT32_MAX;
+            }
+        return error;
+        }
+
+    /** Return the reachable node with the greatest value in aCost that is not already a landmark, or null if there is none. */
+    TNode* Farthest(TGraph& aGraph,const std::vector<uint32>& aCost,const std::vector<uint32>& aMinCost)
+        {
+        size_t best = iNodeCount;
+        for (size_t i = 0; i < iNodeCount; i++)
+            if (aCost[i] != UINT32_MAX && aMinCost[i] != 0 && (best == iNodeCount || aCost[i] > aCost[best]))
+                best = i;
+        return best < iNodeCount ? aGraph.Node(best) : nullptr;
+        }
+
+    size_t iNodeCount = 0;
+    std::vector<uint32> iLandmark;
+    std::vector<uint32> iCostFrom;   // for each landmark in turn, the cost from the landmark to each node
+    std::vector<uint32> iCostTo;     // for each landmark in turn, the cost from each node to the landmark
+    };
+
 }
 
 #endif
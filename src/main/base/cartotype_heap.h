@@ -0,0 +1,333 @@
+/*
+CARTOTYPE_HEAP.H
+Copyright (C) 2017 CartoType Ltd.
+See www.cartotype.com for more information.
+*/
+
+#ifndef CARTOTYPE_HEAP_H__
+#define CARTOTYPE_HEAP_H__
+
+#include <cartotype_base.h>
+#include <cartotype_errors.h>
+#include <vector>
+
+namespace CartoType
+{
+
+/**
+An indexed d-ary heap of pointers to objects of type T, which can be used instead of CPointerTree
+as the open set in TDijkstra. A 4-ary heap is used by default, which is shallower than a binary heap and
+keeps each node's children in the same cache line.
+
+T must have a key function Key() returning type K, a static CompareKeys function returning negative, zero and
+positive results according to the order of the comparison, and a data member iHeapIndex of type uint32,
+which is used by the heap to find the position of the object, so that objects can be deleted, and their keys
+changed, in logarithmic time.
+
+The heap owns the objects in it if aOwnData is true on construction.
+*/
+template<class T,class K,size_t D = 4> class CIndexedHeap
+    {
+    public:
+    CIndexedHeap(bool aOwnData):
+        iOwnData(aOwnData)
+        {
+        }
+
+    ~CIndexedHeap()
+        {
+        Clear();
+        }
+
+    void Clear()
+        {
+        for (auto p : iHeap)
+            {
+            if (iOwnData)
+                delete p;
+            else
+                p->iHeapIndex = KNotInHeap;
+            }
+        iHeap.clear();
+        }
+
+    size_t Count() const
+        {
+        return iHeap.size();
+        }
+
+    /** Insert an item into the heap. */
+    void Insert(T* aItem)
+        {
+        aItem->iHeapIndex = uint32(iHeap.size());
+        iHeap.push_back(aItem);
+        SiftUp(aItem->iHeapIndex);
+        }
+
+    /** Return the item with the smallest key, or null if the heap is empty. */
+    T* Min()
+        {
+        return iHeap.empty() ? nullptr : iHeap[0];
+        }
+
+    /** Return the item with the smallest key, or null if the heap is empty. */
+    const T* Min() const
+        {
+        return iHeap.empty() ? nullptr : iHeap[0];
+        }
+
+    /**
+    Remove an item from the heap. If the heap owns its data the item is deleted
+    unless aTakeOwnership is true.
+    */
+    void Delete(T* aNode,bool aTakeOwnership = false)
+        {
+        if (!aNode)
+            return;
+        uint32 index = aNode->iHeapIndex;
+        Assert(index < iHeap.size() && iHeap[index] == aNode);
+        T* last = iHeap.back();
+        iHeap.pop_back();
+        if (last != aNode)
+            {
+            iHeap[index] = last;
+            last->iHeapIndex = index;
+            SiftUp(index);
+            SiftDown(last->iHeapIndex);
+            }
+        if (iOwnData && !aTakeOwnership)
+            delete aNode;
+        else
+            aNode->iHeapIndex = KNotInHeap;
+        }
+
+    /**
+    Prepare to change the key of an item in the heap. The heap needs no preparation,
+    so this function does nothing, but it is provided so that the heap has the same interface as CPointerTree.
+    */
+    void BeginKeyChange(T* /*aNode*/)
+        {
+        }
+
+    /** Restore the heap order after the key of an item has been changed. Decreasing a key takes logarithmic time. */
+    void EndKeyChange(T* aNode)
+        {
+        Assert(aNode->iHeapIndex < iHeap.size() && iHeap[aNode->iHeapIndex] == aNode);
+        SiftUp(aNode->iHeapIndex);
+        SiftDown(aNode->iHeapIndex);
+        }
+
+    /** The value of iHeapIndex for an item not in a heap. */
+    static const uint32 KNotInHeap = UINT32_MAX;
+
+    private:
+    CIndexedHeap(const CIndexedHeap&) = delete;
+    CIndexedHeap& operator=(const CIndexedHeap&) = delete;
+
+    static bool Less(const T* aA,const T* aB)
+        {
+        return T::CompareKeys(aA->Key(),aB->Key()) < 0;
+        }
+
+    void SiftUp(uint32 aIndex)
+        {
+        T* item = iHeap[aIndex];
+        while (aIndex > 0)
+            {
+            uint32 parent = uint32((aIndex - 1) / D);
+            if (!Less(item,iHeap[parent]))
+                break;
+            iHeap[aIndex] = iHeap[parent];
+            iHeap[aIndex]->iHeapIndex = aIndex;
+            aIndex = parent;
+            }
+        iHeap[aIndex] = item;
+        item->iHeapIndex = aIndex;
+        }
+
+    void SiftDown(uint32 aIndex)
+        {
+        T* item = iHeap[aIndex];
+        size_t count = iHeap.size();
+        for (;;)
+            {
+            size_t first_child = size_t(aIndex) * D + 1;
+            if (first_child >= count)
+                break;
+            size_t end_child = first_child + D;
+            if (end_child > count)
+                end_child = count;
+            size_t min_child = first_child;
+            for (size_t i = first_child + 1; i < end_child; i++)
+                if (Less(iHeap[i],iHeap[min_child]))
+                    min_child = i;
+            if (!Less(iHeap[min_child],item))
+                break;
+            iHeap[aIndex] = iHeap[min_child];
+            iHeap[aIndex]->iHeapIndex = aIndex;
+            aIndex = uint32(min_child);
+            }
+        iHeap[aIndex] = item;
+        item->iHeapIndex = aIndex;
+        }
+
+    std::vector<T*> iHeap;
+    bool iOwnData;
+    };
+
+/**
+A monotone radix heap of pointers to objects of type T, which can be used instead of CPointerTree
+as the open set in TDijkstra. It relies on the fact that Dijkstra's algorithm never inserts an item with a key
+smaller than that of the last item removed as the minimum, and in return gives amortized constant-time insertion
+and key changes, and amortized logarithmic-time removal of the minimum, with a cost proportional to the number of bits
+in the key rather than to the number of items.
+
+T must have a key function Key() returning an unsigned integer of up to 32 bits, and a data member iHeapIndex of type uint32,
+which is used by the heap to find the position of the object in its bucket.
+The key of an item must not be changed while it is in the heap, except between calls to BeginKeyChange and EndKeyChange,
+and keys must never be less than the key of the last item returned by Min.
+
+The heap owns the objects in it if aOwnData is true on construction.
+*/
+template<class T> class CRadixHeap
+    {
+    public:
+    CRadixHeap(bool aOwnData):
+        iOwnData(aOwnData)
+        {
+        }
+
+    ~CRadixHeap()
+        {
+        Clear();
+        }
+
+    void Clear()
+        {
+        for (auto& bucket : iBucket)
+            {
+            for (auto p : bucket)
+                {
+                if (iOwnData)
+                    delete p;
+                else
+                    p->iHeapIndex = KNotInHeap;
+                }
+            bucket.clear();
+            }
+        iCount = 0;
+        iLast = 0;
+        }
+
+    size_t Count() const
+        {
+        return iCount;
+        }
+
+    /** Insert an item into the heap. Its key must not be less than the key of the last item returned by Min. */
+    void Insert(T* aItem)
+        {
+        Assert(uint32(aItem->Key()) >= iLast);
+        Add(aItem,Bucket(aItem->Key()));
+        iCount++;
+        }
+
+    /** Return the item with the smallest key, or null if the heap is empty. */
+    T* Min()
+        {
+        if (!iCount)
+            return nullptr;
+        if (iBucket[0].empty())
+            {
+            // Find the first non-empty bucket, make its smallest key the new base, and redistribute its items into lower buckets.
+            size_t i = 1;
+            while (iBucket[i].empty())
+                i++;
+            std::vector<T*>& bucket = iBucket[i];
+            uint32 min_key = uint32(bucket[0]->Key());
+            for (auto p : bucket)
+                if (uint32(p->Key()) < min_key)
+                    min_key = uint32(p->Key());
+            iLast = min_key;
+            for (auto p : bucket)
+                Add(p,Bucket(p->Key()));
+            bucket.clear();
+            }
+        return iBucket[0].back();
+        }
+
+    /**
+    Remove an item from the heap. If the heap owns its data the item is deleted
+    unless aTakeOwnership is true.
+    */
+    void Delete(T* aNode,bool aTakeOwnership = false)
+        {
+        if (!aNode)
+            return;
+        Remove(aNode);
+        iCount--;
+        if (iOwnData && !aTakeOwnership)
+            delete aNode;
+        else
+            aNode->iHeapIndex = KNotInHeap;
+        }
+
+    /** Prepare to change the key of an item in the heap; this must be done before the key is changed. */
+    void BeginKeyChange(T* aNode)
+        {
+        Remove(aNode);
+        }
+
+    /** Finish changing the key of an item in the heap. The new key must not be less than the key of the last item returned by Min. */
+    void EndKeyChange(T* aNode)
+        {
+        Assert(uint32(aNode->Key()) >= iLast);
+        Add(aNode,Bucket(aNode->Key()));
+        }
+
+    /** The value of iHeapIndex for an item not in a heap. */
+    static const uint32 KNotInHeap = UINT32_MAX;
+
+    private:
+    CRadixHeap(const CRadixHeap&) = delete;
+    CRadixHeap& operator=(const CRadixHeap&) = delete;
+
+    /** Return the bucket for a key: 0 if it equals the last minimum, otherwise one more than the index of the highest bit in which it differs. */
+    size_t Bucket(uint32 aKey) const
+        {
+        uint32 x = aKey ^ iLast;
+        size_t bucket = 0;
+        while (x)
+            {
+            bucket++;
+            x >>= 1;
+            }
+        return bucket;
+        }
+
+    void Add(T* aNode,size_t aBucket)
+        {
+        aNode->iHeapIndex = uint32(iBucket[aBucket].size());
+        iBucket[aBucket].push_back(aNode);
+        }
+
+    void Remove(T* aNode)
+        {
+        std::vector<T*>& bucket = iBucket[Bucket(aNode->Key())];
+        uint32 index = aNode->iHeapIndex;
+        Assert(index < bucket.size() && bucket[index] == aNode);
+        T* last = bucket.back();
+        bucket[index] = last;
+        last->iHeapIndex = index;
+        bucket.pop_back();
+        }
+
+    std::vector<T*> iBucket[33];
+    size_t iCount = 0;
+    uint32 iLast = 0;
+    bool iOwnData;
+    };
+
+}
+
+#endif
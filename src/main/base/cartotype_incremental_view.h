@@ -0,0 +1,443 @@
+/*
+CARTOTYPE_INCREMENTAL_VIEW.H
+Copyright (C) 2017 CartoType Ltd.
+See www.cartotype.com for more information.
+*/
+
+#ifndef CARTOTYPE_INCREMENTAL_VIEW_H__
+#define CARTOTYPE_INCREMENTAL_VIEW_H__
+
+#include <cartotype_framework.h>
+#include <cartotype_label_placer.h>
+#include <cartotype_pixel_blend.h>
+#include <memory>
+#include <vector>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace CartoType
+{
+
+/** A label drawn separately from the map, in display coordinates. */
+class TDisplayLabel
+    {
+    public:
+    /** Return the area covered by the label. */
+    TRect Bounds() const { return TRect(iTopLeft.iX,iTopLeft.iY,iTopLeft.iX + iBitmap->Width(),iTopLeft.iY + iBitmap->Height()); }
+
+    /** Draw the label over a 32-bit color bitmap, clipping it to the bitmap. */
+    void Draw(TBitmap& aBitmap,const TPixelBlender& aBlender = TPixelBlender::Get()) const
+        {
+        const CBitmap& b = *iBitmap;
+        int32 x0 = std::max(0,iTopLeft.iX);
+        int32 x1 = std::min(aBitmap.Width(),iTopLeft.iX + b.Width());
+        int32 y0 = std::max(0,iTopLeft.iY);
+        int32 y1 = std::min(aBitmap.Height(),iTopLeft.iY + b.Height());
+        for (int32 y = y0; y < y1; y++)
+            {
+            uint32* dest = (uint32*)(aBitmap.Data() + y * aBitmap.RowBytes()) + x0;
+            const uint32* source = (const uint32*)(b.Data() + (y - iTopLeft.iY) * b.RowBytes()) + (x0 - iTopLeft.iX);
+            aBlender.BlendSpan(dest,source,x1 - x0,255);
+            }
+        }
+
+    /** The label image, which is a 32-bit color bitmap. */
+    std::shared_ptr<CBitmap> iBitmap;
+    /** The position of the top left corner of the image. */
+    TPoint iTopLeft;
+    /** The position with which the label is associated. */
+    TPoint iHotSpot;
+    };
+
+/** A label handler which stores the labels drawn for part of the view, converting their positions to display coordinates. */
+class TDisplayLabelCollector: public MLabelHandler
+    {
+    public:
+    /** Create a label collector which appends labels to aLabel. */
+    explicit TDisplayLabelCollector(std::vector<TDisplayLabel>& aLabel): iLabel(aLabel) { }
+
+    TResult operator()(const TBitmap& aLabelBitmap,const TPoint& aTopLeft,const TPoint& aHotSpot) override
+        {
+        if (aLabelBitmap.Type() != TBitmap::E32BitColor || aLabelBitmap.Width() <= 0 || aLabelBitmap.Height() <= 0)
+            return KErrorNone;
+        TDisplayLabel label;
+        label.iBitmap.reset(new CBitmap(aLabelBitmap));
+        label.iTopLeft = aTopLeft;
+        label.iTopLeft += iOrigin;
+        label.iHotSpot = aHotSpot;
+        label.iHotSpot += iOrigin;
+        iLabel.push_back(label);
+        return KErrorNone;
+        }
+
+    /** The position, in display coordinates, of the top left corner of the area being drawn. */
+    TPoint iOrigin;
+
+    private:
+    std::vector<TDisplayLabel>& iLabel;
+    };
+
+/** Get the width and height of the view of a framework in pixels. */
+inline TResult GetViewSize(CFramework& aFramework,int32& aWidth,int32& aHeight)
+    {
+    TRectFP view;
+    TResult error = aFramework.GetView(view,EScreenCoordType);
+    if (error)
+        return error;
+    aWidth = int32(floor(view.iBottomRight.iX - view.iTopLeft.iX + 0.5));
+    aHeight = int32(floor(view.iBottomRight.iY - view.iTopLeft.iY + 0.5));
+    if (aWidth <= 0 || aHeight <= 0)
+        return KErrorInvalidArgument;
+    return KErrorNone;
+    }
+
+/**
+Draw the part aArea, in display pixels, of the current view of a framework, using CFramework::TileBitmap,
+into a bitmap of aWidth by aHeight pixels; the size may differ from that of the area, to draw it at a lower resolution.
+The bitmap is owned by the framework. Returns KErrorUnimplemented if the framework does not draw 32-bit color bitmaps.
+*/
+inline const TBitmap* ViewAreaBitmap(TResult& aError,CFramework& aFramework,const TRect& aArea,int32 aWidth,int32 aHeight,const TTileBitmapParam* aParam = nullptr)
+    {
+    double x0 = aArea.Left(), y0 = aArea.Top(), x1 = aArea.Right(), y1 = aArea.Bottom();
+    aError = aFramework.ConvertPoint(x0,y0,EScreenCoordType,EMapCoordType);
+    if (!aError)
+        aError = aFramework.ConvertPoint(x1,y1,EScreenCoordType,EMapCoordType);
+    if (aError)
+        return nullptr;
+    TRectFP bounds(std::min(x0,x1),std::min(y0,y1),std::max(x0,x1),std::max(y0,y1));
+    const TBitmap* bitmap = aFramework.TileBitmap(aError,aWidth,aHeight,bounds,EMapCoordType,aParam);
+    if (aError)
+        return nullptr;
+    if (!bitmap || bitmap->Type() != TBitmap::E32BitColor || bitmap->Width() != aWidth || bitmap->Height() != aHeight)
+        {
+        aError = KErrorUnimplemented;
+        return nullptr;
+        }
+    return bitmap;
+    }
+
+/**
+A map view that is redrawn incrementally when it is panned.
+
+CFramework::MapBitmap redraws the whole view after any change to the view, including a pan of a few pixels.
+A CIncrementalMapView keeps the previous map image, without labels, and the labels drawn on it.
+When the view is panned using CIncrementalMapView::Pan, the image is shifted and only the newly exposed strips are drawn,
+using CFramework::TileBitmap. The labels already shown are shifted with the map and kept, so that they do not jump about
+while the map is moving; labels from the new strips are added if they do not overlap them, and labels that have moved
+out of the view are dropped. The labels are drawn over the map image to make the bitmap returned by MapBitmap.
+
+Any other change to the view, or to the map data, style sheet or dynamic map objects, causes a full redraw the next time
+MapBitmap is called. Rotated and perspective views are always drawn in full by CFramework::MapBitmap.
+The framework must draw 32-bit color bitmaps.
+*/
+class CIncrementalMapView: public MFrameworkObserver
+    {
+    public:
+    /** Create an incremental map view for a framework, which must remain in existence while the view exists. */
+    static std::unique_ptr<CIncrementalMapView> New(TResult& aError,CFramework& aFramework)
+        {
+        aError = KErrorNone;
+        std::unique_ptr<CIncrementalMapView> view(new CIncrementalMapView(aFramework));
+        aFramework.AddObserver(view.get());
+        return view;
+        }
+
+    ~CIncrementalMapView()
+        {
+        iFramework.RemoveObserver(this);
+        }
+
+    /**
+    Return the map, drawing it in full if necessary. If aRedrawWasNeeded is non-null, *aRedrawWasNeeded is set to true
+    if anything was drawn since the last call.
+    */
+    const TBitmap* MapBitmap(TResult& aError,bool* aRedrawWasNeeded = nullptr)
+        {
+        aError = KErrorNone;
+        if (!CanDrawIncrementally())
+            {
+            iValid = false;
+            return iFramework.MapBitmap(aError,aRedrawWasNeeded);
+            }
+
+        bool redraw_needed = !iValid || !iComposed;
+        if (!iValid)
+            {
+            aError = Redraw();
+            if (aError)
+                return nullptr;
+            }
+        if (!iComposed)
+            Compose();
+        if (aRedrawWasNeeded)
+            *aRedrawWasNeeded = redraw_needed;
+        return &iMap;
+        }
+
+    /**
+    Pan the map by aDx pixels horizontally and aDy pixels vertically, as CFramework::Pan does,
+    and draw the newly exposed parts of the view. If the view cannot be updated incrementally,
+    it is redrawn in full by the next call to MapBitmap.
+    */
+    TResult Pan(int32 aDx,int32 aDy)
+        {
+        if (!iValid || !CanDrawIncrementally())
+            {
+            iValid = false;
+            return iFramework.Pan(aDx,aDy);
+            }
+
+        // Find where the old top left corner of the view is after panning; the map image moves by the same amount.
+        double x = 0, y = 0;
+        TResult error = iFramework.ConvertPoint(x,y,EScreenCoordType,EMapCoordType);
+        if (!error)
+            {
+            iPanning = true;
+            error = iFramework.Pan(aDx,aDy);
+            iPanning = false;
+            }
+        if (!error)
+            error = iFramework.ConvertPoint(x,y,EMapCoordType,EScreenCoordType);
+        if (error)
+            {
+            iValid = false;
+            return error;
+            }
+
+        // The pan must move the map by a whole number of pixels, allowing for rounding errors.
+        const double KMaxShiftError = 0.01;
+        double dx = floor(x + 0.5);
+        double dy = floor(y + 0.5);
+        int32 width = iBase->Width();
+        int32 height = iBase->Height();
+        if (fabs(x - dx) > KMaxShiftError || fabs(y - dy) > KMaxShiftError || fabs(dx) >= width || fabs(dy) >= height)
+            {
+            iValid = false;
+            return KErrorNone;
+            }
+        TPoint shift;
+        shift.iX = int32(dx);
+        shift.iY = int32(dy);
+        if (shift.iX == 0 && shift.iY == 0)
+            return KErrorNone;
+
+        ShiftBase(shift);
+        ShiftLabels(shift);
+
+        // Draw the strip of columns exposed on the left or right, then the strip of rows exposed at the top or bottom, excluding the columns.
+        iNewLabel.clear();
+        iDrawnArea = 0;
+        TRect columns(0,0,0,height);
+        if (shift.iX > 0)
+            columns.iBottomRight.iX = shift.iX;
+        else if (shift.iX < 0)
+            columns = TRect(width + shift.iX,0,width,height);
+        if (!columns.IsEmpty())
+            error = Draw(columns);
+        if (!error && shift.iY)
+            {
+            TRect rows(0,0,width,shift.iY);
+            if (shift.iY < 0)
+                rows = TRect(0,height + shift.iY,width,height);
+            if (shift.iX > 0)
+                rows.iTopLeft.iX = shift.iX;
+            else
+                rows.iBottomRight.iX = width + shift.iX;
+            error = Draw(rows);
+            }
+        if (error)
+            {
+            iValid = false;
+            return error;
+            }
+        AddNewLabels();
+        iComposed = false;
+        iIncrementalRedrawCount++;
+        return KErrorNone;
+        }
+
+    /** Cause the view to be redrawn in full the next time MapBitmap is called. */
+    void Invalidate() { iValid = false; }
+
+    /** Return the number of pixels drawn by the last full or incremental redraw. */
+    size_t DrawnArea() const { return iDrawnArea; }
+    /** Return the number of times the view has been drawn in full. */
+    size_t FullRedrawCount() const { return iFullRedrawCount; }
+    /** Return the number of times part of the view has been drawn after a pan. */
+    size_t IncrementalRedrawCount() const { return iIncrementalRedrawCount; }
+    /** Return the number of labels currently shown. */
+    size_t LabelCount() const { return iLabel.size(); }
+    /** Return the map without labels as it was last drawn, fully or incrementally, or null if it must be drawn in full again. */
+    const TBitmap* BaseBitmap() const { return iValid ? iBase.get() : nullptr; }
+
+    // virtual functions from MFrameworkObserver
+    void OnViewChange() override
+        {
+        if (!iPanning)
+            iValid = false;
+        }
+    void OnMainDataChange() override { iValid = false; }
+    void OnDynamicDataChange() override { iValid = false; }
+
+    private:
+    explicit CIncrementalMapView(CFramework& aFramework):
+        iFramework(aFramework),
+        iLabelCollector(iNewLabel)
+        {
+        }
+
+    CIncrementalMapView(const CIncrementalMapView&) = delete;
+    CIncrementalMapView& operator=(const CIncrementalMapView&) = delete;
+
+    bool CanDrawIncrementally() const
+        {
+        return iFramework.RotationRadians() == 0 && !iFramework.Perspective();
+        }
+
+    /** Draw the whole view. */
+    TResult Redraw()
+        {
+        int32 width = 0, height = 0;
+        TResult error = GetViewSize(iFramework,width,height);
+        if (error)
+            return error;
+        if (!iBase || iBase->Width() != width || iBase->Height() != height)
+            {
+            iBase.reset(new CBitmap(TBitmap::E32BitColor,width,height));
+            iMap = CBitmap(TBitmap::E32BitColor,width,height);
+            }
+
+        iLabel.clear();
+        iNewLabel.clear();
+        iDrawnArea = 0;
+        error = Draw(TRect(0,0,width,height));
+        if (error)
+            return error;
+
+        // The labels for the whole view were placed together, so they are all kept.
+        iLabel.swap(iNewLabel);
+        iValid = true;
+        iComposed = false;
+        iFullRedrawCount++;
+        return KErrorNone;
+        }
+
+    /** Draw part of the view, without labels, into the base bitmap, and collect its labels in iNewLabel. */
+    TResult Draw(const TRect& aArea)
+        {
+        TTileBitmapParam param;
+        param.iLabelHandler = &iLabelCollector;
+        iLabelCollector.iOrigin = aArea.iTopLeft;
+        TResult error = KErrorNone;
+        const TBitmap* bitmap = ViewAreaBitmap(error,iFramework,aArea,aArea.Width(),aArea.Height(),&param);
+        if (error)
+            return error;
+
+        size_t row_bytes = size_t(aArea.Width()) * 4;
+        for (int32 y = 0; y < aArea.Height(); y++)
+            memcpy(iBase->Data() + (aArea.Top() + y) * iBase->RowBytes() + aArea.Left() * 4,bitmap->Data() + y * bitmap->RowBytes(),row_bytes);
+        iDrawnArea += size_t(aArea.Width()) * aArea.Height();
+        return KErrorNone;
+        }
+
+    /** Move the base bitmap by aShift pixels; the parts moved into from outside the view are left to be drawn. */
+    void ShiftBase(const TPoint& aShift)
+        {
+        int32 width = iBase->Width() - abs(aShift.iX);
+        int32 height = iBase->Height() - abs(aShift.iY);
+        int32 from_x = std::max(0,-aShift.iX);
+        int32 to_x = std::max(0,aShift.iX);
+        int32 row_bytes = iBase->RowBytes();
+        uint8* data = iBase->Data();
+
+        // Rows are moved in the order that does not overwrite rows not yet moved.
+        for (int32 i = 0; i < height; i++)
+            {
+            int32 y = aShift.iY > 0 ? height - 1 - i : i;
+            int32 from_y = y + std::max(0,-aShift.iY);
+            int32 to_y = y + std::max(0,aShift.iY);
+            memmove(data + to_y * row_bytes + to_x * 4,data + from_y * row_bytes + from_x * 4,size_t(width) * 4);
+            }
+        }
+
+    /** Move the labels by aShift pixels and drop those no longer in the view. */
+    void ShiftLabels(const TPoint& aShift)
+        {
+        TRect view(0,0,iBase->Width(),iBase->Height());
+        size_t n = 0;
+        for (auto& label : iLabel)
+            {
+            label.iTopLeft += aShift;
+            label.iHotSpot += aShift;
+            if (CLabelCollisionGrid::Overlaps(label.Bounds(),view))
+                iLabel[n++] = label;
+            }
+        iLabel.resize(n);
+        }
+
+    /**
+    Add the labels drawn for newly exposed parts of the view to the labels already shown, ignoring those that are
+    already shown or that overlap labels already shown. The labels already shown take precedence so that they do not flicker.
+    */
+    void AddNewLabels()
+        {
+        CLabelCollisionGrid grid(TRect(0,0,iBase->Width(),iBase->Height()));
+        for (const auto& label : iLabel)
+            grid.Insert(label.Bounds());
+        for (const auto& label : iNewLabel)
+            {
+            bool duplicate = false;
+            for (const auto& old_label : iLabel)
+                if (IsSameLabel(label,old_label))
+                    {
+                    duplicate = true;
+                    break;
+                    }
+            TRect bounds = label.Bounds();
+            if (duplicate || grid.Intersects(bounds))
+                continue;
+            grid.Insert(bounds);
+            iLabel.push_back(label);
+            }
+        iNewLabel.clear();
+        }
+
+    /** Return true if two labels are the same label drawn at slightly different positions, allowing for rounding. */
+    static bool IsSameLabel(const TDisplayLabel& aA,const TDisplayLabel& aB)
+        {
+        return abs(aA.iHotSpot.iX - aB.iHotSpot.iX) <= 1 && abs(aA.iHotSpot.iY - aB.iHotSpot.iY) <= 1 &&
+               aA.iBitmap->Width() == aB.iBitmap->Width() && aA.iBitmap->Height() == aB.iBitmap->Height();
+        }
+
+    /** Make the map bitmap by drawing the labels over the base bitmap. */
+    void Compose()
+        {
+        int32 width = iBase->Width();
+        int32 height = iBase->Height();
+        for (int32 y = 0; y < height; y++)
+            memcpy(iMap.Data() + y * iMap.RowBytes(),iBase->Data() + y * iBase->RowBytes(),size_t(width) * 4);
+
+        const TPixelBlender& blender = TPixelBlender::Get();
+        for (const auto& label : iLabel)
+            label.Draw(iMap,blender);
+        iComposed = true;
+        }
+
+    CFramework& iFramework;
+    std::unique_ptr<CBitmap> iBase;         // the map without labels
+    CBitmap iMap;                           // the map with labels
+    std::vector<TDisplayLabel> iLabel;      // the labels shown, in display coordinates
+    std::vector<TDisplayLabel> iNewLabel;   // labels drawn for newly exposed parts of the view
+    TDisplayLabelCollector iLabelCollector;
+    bool iValid = false;
+    bool iComposed = false;
+    bool iPanning = false;
+    size_t iDrawnArea = 0;
+    size_t iFullRedrawCount = 0;
+    size_t iIncrementalRedrawCount = 0;
+    };
+
+}
+
+#endif
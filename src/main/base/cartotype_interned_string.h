@@ -0,0 +1,245 @@
+/*
+CARTOTYPE_INTERNED_STRING.H
+Copyright (C) 2017 CartoType Ltd.
+See www.cartotype.com for more information.
+*/
+
+#ifndef CARTOTYPE_INTERNED_STRING_H__
+#define CARTOTYPE_INTERNED_STRING_H__
+
+#include <cartotype_string.h>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace CartoType
+{
+
+/**
+A thread-safe table giving each distinct string, such as a layer name or an attribute key, a compact integer identifier.
+Identifiers are allocated consecutively starting at zero, which is always the empty string, and are never reused,
+so they can be used as indexes into arrays. Strings that have been interned stay in the table until it is destroyed.
+
+Comparing two identifiers is much faster than comparing two strings, and an identifier is smaller than a
+reference-counted string, and needs no atomic reference count updates when copied.
+*/
+class CStringInternTable
+    {
+    public:
+    CStringInternTable()
+        {
+        Id(TText());
+        }
+
+    /** Return the table used by default, which is shared by the whole process. */
+    static CStringInternTable& Global()
+        {
+        static CStringInternTable table;
+        return table;
+        }
+
+    /** Return the identifier of aString, adding it to the table if necessary. */
+    uint32 Id(const MString& aString)
+        {
+        std::lock_guard<std::mutex> lock(iMutex);
+        auto p = iIdMap.find(TText(aString));
+        if (p != iIdMap.end())
+            return p->second;
+        uint32 id = uint32(iString.size());
+        iString.emplace_back(new CString(aString));
+        iIdMap.emplace(TText(*iString.back()),id);
+        return id;
+        }
+
+    /** Return the identifier of a UTF-8 string, adding it to the table if necessary. */
+    uint32 Id(const char* aString)
+        {
+        return Id(CString(aString));
+        }
+
+    /** Find the identifier of aString without adding it. Return false if it is not in the table. */
+    bool Find(const MString& aString,uint32& aId) const
+        {
+        std::lock_guard<std::mutex> lock(iMutex);
+        auto p = iIdMap.find(TText(aString));
+        if (p == iIdMap.end())
+            return false;
+        aId = p->second;
+        return true;
+        }
+
+    /**
+    Return the string with the identifier aId, or the empty string if aId is not a valid identifier.
+    The reference remains valid for the lifetime of the table.
+    */
+    const CString& String(uint32 aId) const
+        {
+        std::lock_guard<std::mutex> lock(iMutex);
+        if (aId >= iString.size())
+            return *iString[0];
+        return *iString[aId];
+        }
+
+    /** Return the number of strings in the table, which is one more than the largest identifier. */
+    size_t Count() const
+        {
+        std::lock_guard<std::mutex> lock(iMutex);
+        return iString.size();
+        }
+
+    private:
+    CStringInternTable(const CStringInternTable&) = delete;
+    CStringInternTable& operator=(const CStringInternTable&) = delete;
+
+    class THash
+        {
+        public:
+        size_t operator()(const TText& aText) const
+            {
+            // FNV-1a.
+            uint32 h = 2166136261U;
+            const uint16* p = aText.Text();
+            for (size_t i = 0; i < aText.Length(); i++)
+                {
+                h = (h ^ (p[i] & 0xFF)) * 16777619U;
+                h = (h ^ (p[i] >> 8)) * 16777619U;
+                }
+            return h;
+            }
+        };
+
+    class TEqual
+        {
+        public:
+        bool operator()(const TText& aA,const TText& aB) const
+            {
+            return aA.Length() == aB.Length() && (aA.Length() == 0 || !memcmp(aA.Text(),aB.Text(),aA.Length() * sizeof(uint16)));
+            }
+        };
+
+    mutable std::mutex iMutex;
+    // The keys refer to the text of the strings in iString, which never move.
+    std::unordered_map<TText,uint32,THash,TEqual> iIdMap;
+    std::vector<std::unique_ptr<CString>> iString;
+    };
+
+/**
+A string stored in the global intern table, represented by its identifier.
+Interned strings are compared for equality by identifier, so they are suitable for layer names and attribute keys,
+which are compared often but come from a small set of values.
+*/
+class TInternedString
+    {
+    public:
+    /** Create an empty interned string. */
+    TInternedString() = default;
+    /** Create an interned string from aString, adding it to the global table if necessary. */
+    explicit TInternedString(const MString& aString): iId(CStringInternTable::Global().Id(aString)) { }
+    /** Create an interned string from a UTF-8 string, adding it to the global table if necessary. */
+    explicit TInternedString(const char* aString): iId(CStringInternTable::Global().Id(aString)) { }
+
+    /** Create an interned string from its identifier in the global table. */
+    static TInternedString FromId(uint32 aId)
+        {
+        TInternedString s;
+        s.iId = aId;
+        return s;
+        }
+
+    /** Return the identifier in the global table. */
+    uint32 Id() const { return iId; }
+    /** Return the text of the string. */
+    const CString& String() const { return CStringInternTable::Global().String(iId); }
+    /** Return true if this is the empty string. */
+    bool IsEmpty() const { return iId == 0; }
+
+    bool operator==(const TInternedString& aOther) const { return iId == aOther.iId; }
+    bool operator!=(const TInternedString& aOther) const { return iId != aOther.iId; }
+    /** Order interned strings by identifier, which is fast but is not alphabetical order. */
+    bool operator<(const TInternedString& aOther) const { return iId < aOther.iId; }
+
+    private:
+    uint32 iId = 0;
+    };
+
+/**
+A filter for layers, created from a list of layer names in the format used by TFindParam::iLayers: names separated by
+spaces or commas, which may contain the wild cards * and ?. Each interned layer name is matched against the list
+only the first time it is seen; after that, testing a layer is an array lookup.
+
+A filter is not thread-safe; each thread doing a search should use its own filter.
+*/
+class CLayerFilter
+    {
+    public:
+    /** Create a filter from a list of layer names. If the list is empty all layers match. */
+    explicit CLayerFilter(const MString& aLayers,CStringInternTable& aTable = CStringInternTable::Global()):
+        iTable(aTable)
+        {
+        const uint16* p = aLayers.Text();
+        const uint16* end = p + aLayers.Length();
+        while (p < end)
+            {
+            while (p < end && (*p == ' ' || *p == ','))
+                p++;
+            const uint16* start = p;
+            while (p < end && *p != ' ' && *p != ',')
+                p++;
+            if (p > start)
+                iPattern.emplace_back(start,p - start);
+            }
+        }
+
+    /** Return true if the filter matches all layers. */
+    bool MatchesAll() const { return iPattern.empty(); }
+
+    /** Return true if the layer with the identifier aLayerId is selected by the filter. */
+    bool Matches(uint32 aLayerId)
+        {
+        if (iPattern.empty())
+            return true;
+        if (aLayerId >= iMatch.size())
+            iMatch.resize(aLayerId + 1,KUnknown);
+        if (iMatch[aLayerId] == KUnknown)
+            {
+            iMatch[aLayerId] = KNoMatch;
+            const CString& layer = iTable.String(aLayerId);
+            for (const auto& pattern : iPattern)
+                if (layer.LayerMatch(pattern))
+                    {
+                    iMatch[aLayerId] = KMatch;
+                    break;
+                    }
+            }
+        return iMatch[aLayerId] == KMatch;
+        }
+
+    /** Return true if the layer aLayer is selected by the filter. */
+    bool Matches(TInternedString aLayer) { return Matches(aLayer.Id()); }
+
+    private:
+    enum
+        {
+        KUnknown,
+        KNoMatch,
+        KMatch
+        };
+
+    CStringInternTable& iTable;
+    std::vector<CString> iPattern;
+    std::vector<uint8> iMatch;
+    };
+
+}
+
+namespace std
+{
+/** A hash function for interned strings, allowing them to be used as keys in unordered containers. */
+template<> struct hash<CartoType::TInternedString>
+    {
+    size_t operator()(const CartoType::TInternedString& aString) const { return aString.Id(); }
+    };
+}
+
+#endif
@@ -0,0 +1,209 @@
+/*
+CARTOTYPE_IO_URING_READER.H
+Copyright (C) 2017 CartoType Ltd.
+See www.cartotype.com for more information.
+*/
+
+#ifndef CARTOTYPE_IO_URING_READER_H__
+#define CARTOTYPE_IO_URING_READER_H__
+
+#include <cartotype_stream.h>
+#include <algorithm>
+
+// Define CARTOTYPE_IO_URING on Linux to read batches of blocks using io_uring; liburing is then needed.
+#if defined(CARTOTYPE_IO_URING) && defined(__linux__)
+    #define CARTOTYPE_USE_IO_URING
+    #include <liburing.h>
+    #include <errno.h>
+#endif
+
+namespace CartoType
+{
+
+/**
+Reads batches of blocks from a CBinaryInputFile. If CARTOTYPE_IO_URING is defined on Linux the reads are
+submitted to the kernel together using io_uring, so that they can be done in parallel and take one system call
+rather than one for each read; otherwise, or if io_uring is not available, they are done one after another using
+CBinaryInputFile::ReadAt.
+
+Each thread has its own ring, so any number of threads may read at once. Every read submitted to the ring
+has completed before ReadBatch returns, so the buffers in the requests are never written to afterwards.
+
+This is kept apart from CBinaryInputFile, whose layout and file handling are fixed by the CartoType library.
+*/
+class CIoUringFileReader
+    {
+    public:
+    /**
+    Perform a batch of reads from aFile, setting iBytesRead in each request.
+    Return KErrorIo if waiting for reads submitted to the ring fails; the reads not completed are then left with iBytesRead zero.
+    */
+    static TResult ReadBatch(CBinaryInputFile& aFile,TFileReadRequest* aRequest,size_t aCount)
+        {
+        size_t done = 0;
+#ifdef CARTOTYPE_USE_IO_URING
+        int fd = aFile.FileDescriptor();
+        if (fd >= 0)
+            {
+            TRing& ring = Ring();
+            while (done < aCount)
+                {
+                size_t n = 0;
+                TResult error = ring.Read(fd,aRequest + done,aCount - done,n);
+                if (error)
+                    {
+                    for (size_t i = done + n; i < aCount; i++)
+                        aRequest[i].iBytesRead = 0;
+                    return error;
+                    }
+                if (!n)
+                    break;
+                done += n;
+                }
+            }
+#endif
+
+        // Finish short or failed reads, and any not given to the ring, synchronously.
+        for (size_t i = 0; i < aCount; i++)
+            {
+            TFileReadRequest& r = aRequest[i];
+            if (i >= done)
+                r.iBytesRead = 0;
+            if (r.iBytesRead < r.iSize)
+                r.iBytesRead += aFile.ReadAt(r.iBuffer + r.iBytesRead,r.iSize - r.iBytesRead,r.iPosition + r.iBytesRead);
+            }
+        return KErrorNone;
+        }
+
+    /** Return true if batches are read using io_uring on this thread. */
+    static bool UsingIoUring()
+        {
+#ifdef CARTOTYPE_USE_IO_URING
+        return Ring().Open();
+#else
+        return false;
+#endif
+        }
+
+#ifdef CARTOTYPE_USE_IO_URING
+    private:
+    enum
+        {
+        KRingSize = 64,
+        KMaxReadSize = 1 << 30,
+        KMaxWaitRetries = 64
+        };
+
+    class TRing
+        {
+        public:
+        ~TRing() { Close(); }
+
+        bool Open()
+            {
+            if (!iValid && !iFailed)
+                {
+                iValid = io_uring_queue_init(KRingSize,&iRing,0) == 0;
+                iFailed = !iValid;
+                }
+            return iValid;
+            }
+
+        void Close()
+            {
+            if (iValid)
+                io_uring_queue_exit(&iRing);
+            iValid = false;
+            }
+
+        /**
+        Submit up to KRingSize reads and wait for all the submitted ones to complete, setting aHandled to the number of requests handled,
+        which is zero if the ring cannot be used. Requests not submitted, and reads that fail, are left with iBytesRead
+        less than iSize, to be finished by the caller. Return KErrorIo, having closed the ring, if waiting for the reads fails;
+        the reads not completed are then left with iBytesRead zero.
+        */
+        TResult Read(int aFd,TFileReadRequest* aRequest,size_t aCount,size_t& aHandled)
+            {
+            aHandled = 0;
+            if (!Open())
+                return KErrorNone;
+            size_t prepared = 0;
+            for (; prepared < aCount && prepared < KRingSize; prepared++)
+                {
+                io_uring_sqe* sqe = io_uring_get_sqe(&iRing);
+                if (!sqe)
+                    break;
+                TFileReadRequest& r = aRequest[prepared];
+                r.iBytesRead = 0;
+                io_uring_prep_read(sqe,aFd,r.iBuffer,unsigned(std::min(r.iSize,size_t(KMaxReadSize))),uint64(r.iPosition));
+                io_uring_sqe_set_data(sqe,&r);
+                }
+            if (!prepared)
+                {
+                // The ring is full of entries from somewhere else; it cannot be trusted.
+                Close();
+                return KErrorNone;
+                }
+
+            // The kernel may take fewer entries than offered, so keep submitting until it takes them all or refuses.
+            size_t submitted = 0;
+            while (submitted < prepared)
+                {
+                int n = io_uring_submit(&iRing);
+                if (n == -EINTR)
+                    continue;
+                if (n <= 0)
+                    break;
+                submitted += size_t(n);
+                }
+
+            // Wait for every submitted read, because the kernel writes into the caller's buffers until it completes.
+            // Waiting is retried a limited number of times if it is interrupted by a signal or fails temporarily.
+            aHandled = prepared;
+            size_t retries = 0;
+            for (size_t i = 0; i < submitted; )
+                {
+                io_uring_cqe* cqe = nullptr;
+                int error = io_uring_wait_cqe(&iRing,&cqe);
+                if (error || !cqe)
+                    {
+                    if ((error == -EINTR || error == -EAGAIN || !error) && ++retries < KMaxWaitRetries)
+                        continue;
+
+                    // The ring cannot be used; the reads not completed have failed. Discard the ring; a new ring is created by the next call.
+                    Close();
+                    return KErrorIo;
+                    }
+                retries = 0;
+                TFileReadRequest* r = (TFileReadRequest*)io_uring_cqe_get_data(cqe);
+                if (cqe->res > 0)
+                    r->iBytesRead = size_t(cqe->res);
+                io_uring_cqe_seen(&iRing,cqe);
+                i++;
+                }
+
+            // Entries not taken by the kernel are still in the ring and would be submitted by the next call,
+            // pointing to these requests and buffers. Nothing is in flight now, so discard them with the ring;
+            // a new ring is created by the next call.
+            if (submitted < prepared)
+                Close();
+            return KErrorNone;
+            }
+
+        private:
+        io_uring iRing;
+        bool iValid = false;
+        bool iFailed = false;
+        };
+
+    static TRing& Ring()
+        {
+        static thread_local TRing ring;
+        return ring;
+        }
+#endif
+    };
+
+}
+
+#endif
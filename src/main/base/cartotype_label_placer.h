@@ -0,0 +1,461 @@
+/*
+CARTOTYPE_LABEL_PLACER.H
+Copyright (C) 2017 CartoType Ltd.
+See www.cartotype.com for more information.
+*/
+
+#ifndef CARTOTYPE_LABEL_PLACER_H__
+#define CARTOTYPE_LABEL_PLACER_H__
+
+#include <cartotype_base.h>
+#include <cartotype_errors.h>
+#include <cartotype_stack_allocator.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace CartoType
+{
+
+/**
+A uniform grid of cells used to find collisions between label rectangles quickly.
+Each rectangle is stored in every cell it overlaps, so a collision test only examines the rectangles
+in the cells overlapped by the rectangle being tested. Rectangles outside the bounds of the grid are stored
+in the nearest cells, so they are still tested correctly, but slowly if there are many of them.
+
+Insertions into disjoint sets of cells may be made on different threads at once.
+*/
+class CLabelCollisionGrid
+    {
+    public:
+    /** Create a grid covering aBounds, made of square cells with sides of aCellSize pixels. */
+    CLabelCollisionGrid(const TRect& aBounds,int32 aCellSize = KDefaultCellSize):
+        iBounds(aBounds),
+        iCellSize(aCellSize > 0 ? aCellSize : KDefaultCellSize)
+        {
+        iBounds.iBottomRight.iX = std::max(iBounds.Right(),iBounds.Left() + 1);
+        iBounds.iBottomRight.iY = std::max(iBounds.Bottom(),iBounds.Top() + 1);
+        iColumns = (iBounds.Width() + iCellSize - 1) / iCellSize;
+        iRows = (iBounds.Height() + iCellSize - 1) / iCellSize;
+        iCell.resize(size_t(iColumns) * iRows);
+        }
+
+    /** Remove all the rectangles. */
+    void Clear()
+        {
+        for (auto& cell : iCell)
+            cell.clear();
+        }
+
+    /** Return true if aRect overlaps any rectangle in the grid. Rectangles that merely touch do not overlap. */
+    bool Intersects(const TRect& aRect) const
+        {
+        if (aRect.IsEmpty())
+            return false;
+        int32 x0, y0, x1, y1;
+        CellRange(aRect,x0,y0,x1,y1);
+        for (int32 y = y0; y <= y1; y++)
+            for (int32 x = x0; x <= x1; x++)
+                for (const auto& r : iCell[size_t(y) * iColumns + x])
+                    if (Overlaps(r,aRect))
+                        return true;
+        return false;
+        }
+
+    /** Add a rectangle. Empty rectangles are ignored. */
+    void Insert(const TRect& aRect)
+        {
+        if (aRect.IsEmpty())
+            return;
+        int32 x0, y0, x1, y1;
+        CellRange(aRect,x0,y0,x1,y1);
+        for (int32 y = y0; y <= y1; y++)
+            for (int32 x = x0; x <= x1; x++)
+                iCell[size_t(y) * iColumns + x].push_back(aRect);
+        }
+
+    /** Return the bounds of the grid. */
+    const TRect& Bounds() const { return iBounds; }
+    /** Return the width and height of a cell in pixels. */
+    int32 CellSize() const { return iCellSize; }
+    /** Return the number of columns of cells. */
+    int32 Columns() const { return iColumns; }
+    /** Return the number of rows of cells. */
+    int32 Rows() const { return iRows; }
+
+    /**
+    Get the inclusive range of cells overlapped by aRect, which must not be empty.
+    Rectangles that overlap each other always share at least one cell.
+    */
+    void CellRange(const TRect& aRect,int32& aX0,int32& aY0,int32& aX1,int32& aY1) const
+        {
+        aX0 = Column(aRect.Left());
+        aX1 = Column(aRect.Right() - 1);
+        aY0 = Row(aRect.Top());
+        aY1 = Row(aRect.Bottom() - 1);
+        }
+
+    /** Return true if two rectangles share any pixels. */
+    static bool Overlaps(const TRect& aA,const TRect& aB)
+        {
+        return aA.Left() < aB.Right() && aB.Left() < aA.Right() && aA.Top() < aB.Bottom() && aB.Top() < aA.Bottom();
+        }
+
+    /** The default width and height of a cell in pixels. */
+    static const int32 KDefaultCellSize = 32;
+
+    private:
+    int32 Column(int32 aX) const
+        {
+        aX = std::min(std::max(aX,iBounds.Left()),iBounds.Right() - 1);
+        return (aX - iBounds.Left()) / iCellSize;
+        }
+
+    int32 Row(int32 aY) const
+        {
+        aY = std::min(std::max(aY,iBounds.Top()),iBounds.Bottom() - 1);
+        return (aY - iBounds.Top()) / iCellSize;
+        }
+
+    TRect iBounds;
+    int32 iCellSize;
+    int32 iColumns = 0;
+    int32 iRows = 0;
+    std::vector<std::vector<TRect>> iCell;
+    };
+
+/**
+A label placer decides which of a set of labels can be drawn without overlapping each other.
+Each label has a priority and one or more possible positions, given as rectangles in display pixels,
+in order of preference. Labels are placed in order of decreasing priority, each at the first of its positions
+that does not overlap an obstacle or a label already placed; labels that cannot be placed are dropped.
+
+Placement uses a CLabelCollisionGrid, and can use several threads. The labels, in priority order, are divided
+into batches of at least BatchSize() labels, and the display is divided into square regions of RegionSize() pixels.
+In each batch, labels whose positions all lie inside a single region cannot collide with labels in other regions,
+so the regions are placed in parallel, each in priority order; then the rest of the labels in the batch, which cross
+region boundaries, are placed in priority order. The threads are created once for each call to Place and take the regions
+of each batch from a shared counter. The result therefore depends only on the labels, the
+batch size and the region size, never on the number of threads or on timing.
+The default batch size of 1 makes each priority level a separate batch, so that higher-priority labels always take precedence;
+larger batches allow more parallelism when there are many priority levels with few labels each.
+
+The placer does no drawing; after calling Place, the caller draws the labels that were placed, or passes them to
+an MLabelHandler, at the positions returned by PlacedPosition.
+*/
+class CLabelPlacer
+    {
+    public:
+    /** Create a label placer for the display area aBounds. */
+    explicit CLabelPlacer(const TRect& aBounds,int32 aCellSize = CLabelCollisionGrid::KDefaultCellSize,int32 aRegionSize = KDefaultRegionSize):
+        iGrid(aBounds,aCellSize)
+        {
+        // Regions are made of whole cells so that regions placed in parallel never write to the same cell.
+        iRegionCells = std::max(1,aRegionSize / iGrid.CellSize());
+        iRegionColumns = (iGrid.Columns() + iRegionCells - 1) / iRegionCells;
+        }
+
+    /** Remove all labels and obstacles. */
+    void Clear()
+        {
+        iLabel.clear();
+        iPosition.clear();
+        iObstacle.clear();
+        iGrid.Clear();
+        }
+
+    /**
+    Add a label with aPositionCount possible positions, in order of preference, and return its index,
+    which is used to get the result of placing it.
+    */
+    size_t AddLabel(int32 aPriority,const TRect* aPosition,size_t aPositionCount)
+        {
+        TLabel label;
+        label.iPriority = aPriority;
+        label.iFirstPosition = uint32(iPosition.size());
+        label.iPositionCount = uint32(aPositionCount);
+        iPosition.insert(iPosition.end(),aPosition,aPosition + aPositionCount);
+        iLabel.push_back(label);
+        return iLabel.size() - 1;
+        }
+
+    /** Add a label with a single possible position and return its index. */
+    size_t AddLabel(int32 aPriority,const TRect& aPosition)
+        {
+        return AddLabel(aPriority,&aPosition,1);
+        }
+
+    /** Add an area, such as a route instruction panel or the position of a pushpin, that labels must not overlap. */
+    void AddObstacle(const TRect& aRect)
+        {
+        iObstacle.push_back(aRect);
+        }
+
+    /** Set the minimum number of labels in a batch. Larger batches allow more parallelism. */
+    void SetBatchSize(size_t aBatchSize) { iBatchSize = std::max(aBatchSize,size_t(1)); }
+    /** Return the minimum number of labels in a batch. */
+    size_t BatchSize() const { return iBatchSize; }
+    /** Return the width and height of the regions placed in parallel, in pixels. */
+    int32 RegionSize() const { return iRegionCells * iGrid.CellSize(); }
+
+    /**
+    Place the labels, using aThreadCount threads. A thread count of zero causes one thread to be used
+    for each hardware thread. Placing the labels again gives the same result.
+    */
+    TResult Place(size_t aThreadCount = 0)
+        {
+        if (aThreadCount == 0)
+            aThreadCount = std::thread::hardware_concurrency();
+        if (aThreadCount == 0)
+            aThreadCount = 1;
+
+        iGrid.Clear();
+        for (const auto& r : iObstacle)
+            iGrid.Insert(r);
+
+        // The working arrays are allocated from a recycling stack allocator, so that placing the labels for each frame
+        // does not allocate memory once the largest frame has been placed.
+        iScratch.Clear();
+        TStlRecyclingStackAllocator<uint32> scratch(iScratch);
+        CStackVector<uint32> order(iLabel.size(),0,scratch);
+        for (size_t i = 0; i < order.size(); i++)
+            {
+            order[i] = uint32(i);
+            iLabel[i].iPlacedPosition = -1;
+            iLabel[i].iRegion = Region(iLabel[i]);
+            }
+        std::stable_sort(order.begin(),order.end(),[this](uint32 aA,uint32 aB) { return iLabel[aA].iPriority > iLabel[aB].iPriority; });
+
+        CStackVector<uint32> local(scratch);
+        CStackVector<uint32> crossing(scratch);
+        CStackVector<size_t> region_start(scratch);
+        local.reserve(order.size());
+        crossing.reserve(order.size());
+        region_start.reserve(order.size() + 1);
+        CRegionWorkers workers;
+        size_t batch_start = 0;
+        while (batch_start < order.size())
+            {
+            // A batch ends at a change of priority once it has reached the minimum size.
+            size_t batch_end = std::min(batch_start + iBatchSize,order.size());
+            while (batch_end < order.size() && iLabel[order[batch_end]].iPriority == iLabel[order[batch_end - 1]].iPriority)
+                batch_end++;
+
+            local.clear();
+            crossing.clear();
+            for (size_t i = batch_start; i < batch_end; i++)
+                {
+                uint32 label = order[i];
+                if (iLabel[label].iRegion == KNoRegion)
+                    crossing.push_back(label);
+                else
+                    local.push_back(label);
+                }
+
+            // Group the local labels by region, keeping them in priority order within each region.
+            std::stable_sort(local.begin(),local.end(),[this](uint32 aA,uint32 aB) { return iLabel[aA].iRegion < iLabel[aB].iRegion; });
+            region_start.clear();
+            for (size_t i = 0; i < local.size(); i++)
+                if (i == 0 || iLabel[local[i]].iRegion != iLabel[local[i - 1]].iRegion)
+                    region_start.push_back(i);
+            region_start.push_back(local.size());
+
+            size_t region_count = region_start.size() - 1;
+            std::function<void(size_t)> place_region = [&](size_t aRegion)
+                {
+                for (size_t i = region_start[aRegion]; i < region_start[aRegion + 1]; i++)
+                    PlaceLabel(iLabel[local[i]]);
+                };
+            if (aThreadCount > 1 && region_count > 1 && local.size() >= KMinLabelsPerThread * 2)
+                {
+                size_t thread_count = std::min(std::min(aThreadCount,region_count),local.size() / KMinLabelsPerThread);
+                workers.PlaceRegions(region_count,thread_count,place_region);
+                }
+            else
+                {
+                for (size_t r = 0; r < region_count; r++)
+                    place_region(r);
+                }
+
+            for (auto label : crossing)
+                PlaceLabel(iLabel[label]);
+            batch_start = batch_end;
+            }
+        return KErrorNone;
+        }
+
+    /** Return the number of labels. */
+    size_t LabelCount() const { return iLabel.size(); }
+    /** Return true if the label with the index aIndex was placed by the last call to Place. */
+    bool IsPlaced(size_t aIndex) const { return iLabel[aIndex].iPlacedPosition >= 0; }
+    /** Return the index of the position used for a label, or -1 if it was not placed. */
+    int32 PlacedPositionIndex(size_t aIndex) const { return iLabel[aIndex].iPlacedPosition; }
+    /** Return the position used for a label, which must have been placed. */
+    const TRect& PlacedPosition(size_t aIndex) const
+        {
+        const TLabel& label = iLabel[aIndex];
+        return iPosition[label.iFirstPosition + label.iPlacedPosition];
+        }
+    /** Return the number of labels placed by the last call to Place. */
+    size_t PlacedCount() const
+        {
+        size_t n = 0;
+        for (const auto& label : iLabel)
+            if (label.iPlacedPosition >= 0)
+                n++;
+        return n;
+        }
+
+    /** The default width and height of the regions placed in parallel, in pixels. */
+    static const int32 KDefaultRegionSize = 256;
+    /** The default minimum number of labels in a batch, which makes each priority level a batch. */
+    static const size_t KDefaultBatchSize = 1;
+
+    private:
+    class TLabel
+        {
+        public:
+        int32 iPriority = 0;
+        uint32 iFirstPosition = 0;
+        uint32 iPositionCount = 0;
+        int32 iPlacedPosition = -1;
+        uint32 iRegion = 0;
+        };
+
+    /**
+    Threads that place the regions of batches in parallel. Threads are created when a batch first needs them, and then wait
+    for later batches, so that they are created only once for each call to Place. They are stopped when this object is destroyed.
+    */
+    class CRegionWorkers
+        {
+        public:
+        CRegionWorkers() = default;
+
+        ~CRegionWorkers()
+            {
+                {
+                std::lock_guard<std::mutex> lock(iMutex);
+                iStop = true;
+                }
+            iCondition.notify_all();
+            for (auto& t : iThread)
+                t.join();
+            }
+
+        /** Call aPlaceRegion for the regions 0...aRegionCount - 1, using aThreadCount threads including the calling thread, and wait for them all. */
+        void PlaceRegions(size_t aRegionCount,size_t aThreadCount,const std::function<void(size_t)>& aPlaceRegion)
+            {
+            std::unique_lock<std::mutex> lock(iMutex);
+            while (iThread.size() + 1 < aThreadCount)
+                iThread.emplace_back(&CRegionWorkers::Work,this);
+            iPlaceRegion = &aPlaceRegion;
+            iRegionCount = aRegionCount;
+            iNextRegion = 0;
+            iBusyCount = iThread.size();
+            iBatch++;
+            lock.unlock();
+            iCondition.notify_all();
+
+            TakeRegions();
+
+            // Every worker takes part in every batch, even if it finds no regions left, so the next batch cannot start until they all have.
+            lock.lock();
+            iCondition.wait(lock,[this]() { return iBusyCount == 0; });
+            }
+
+        private:
+        CRegionWorkers(const CRegionWorkers&) = delete;
+        CRegionWorkers& operator=(const CRegionWorkers&) = delete;
+
+        void Work()
+            {
+            uint64 batch = 0;
+            std::unique_lock<std::mutex> lock(iMutex);
+            for (;;)
+                {
+                iCondition.wait(lock,[this,&batch]() { return iStop || iBatch != batch; });
+                if (iStop)
+                    return;
+                batch = iBatch;
+                lock.unlock();
+                TakeRegions();
+                lock.lock();
+                if (!--iBusyCount)
+                    iCondition.notify_all();
+                }
+            }
+
+        void TakeRegions()
+            {
+            for (size_t r = iNextRegion++; r < iRegionCount; r = iNextRegion++)
+                (*iPlaceRegion)(r);
+            }
+
+        std::mutex iMutex;
+        std::condition_variable iCondition;
+        std::vector<std::thread> iThread;
+        const std::function<void(size_t)>* iPlaceRegion = nullptr;
+        size_t iRegionCount = 0;
+        std::atomic<size_t> iNextRegion { 0 };
+        size_t iBusyCount = 0;
+        uint64 iBatch = 0;
+        bool iStop = false;
+        };
+
+    static const uint32 KNoRegion = UINT32_MAX;
+    static const size_t KMinLabelsPerThread = 64;
+
+    /** Return the region containing all the positions of a label, or KNoRegion if there is none. */
+    uint32 Region(const TLabel& aLabel) const
+        {
+        uint32 region = KNoRegion;
+        for (uint32 i = 0; i < aLabel.iPositionCount; i++)
+            {
+            const TRect& r = iPosition[aLabel.iFirstPosition + i];
+            if (r.IsEmpty())
+                continue;
+            int32 x0, y0, x1, y1;
+            iGrid.CellRange(r,x0,y0,x1,y1);
+            x0 /= iRegionCells;
+            y0 /= iRegionCells;
+            if (x0 != x1 / iRegionCells || y0 != y1 / iRegionCells)
+                return KNoRegion;
+            uint32 p = uint32(y0) * iRegionColumns + x0;
+            if (region != KNoRegion && p != region)
+                return KNoRegion;
+            region = p;
+            }
+        return region;
+        }
+
+    void PlaceLabel(TLabel& aLabel)
+        {
+        for (uint32 i = 0; i < aLabel.iPositionCount; i++)
+            {
+            const TRect& r = iPosition[aLabel.iFirstPosition + i];
+            if (!iGrid.Intersects(r))
+                {
+                iGrid.Insert(r);
+                aLabel.iPlacedPosition = int32(i);
+                return;
+                }
+            }
+        }
+
+    CLabelCollisionGrid iGrid;
+    int32 iRegionCells = 1;
+    int32 iRegionColumns = 1;
+    size_t iBatchSize = KDefaultBatchSize;
+    std::vector<TLabel> iLabel;
+    std::vector<TRect> iPosition;
+    std::vector<TRect> iObstacle;
+    CRecyclingStackAllocator iScratch;
+    };
+
+}
+
+#endif
@@ -0,0 +1,285 @@
+/*
+CARTOTYPE_MAPPED_FILE.H
+Copyright (C) 2017 CartoType Ltd.
+See www.cartotype.com for more information.
+*/
+
+#ifndef CARTOTYPE_MAPPED_FILE_H__
+#define CARTOTYPE_MAPPED_FILE_H__
+
+#include <cartotype_stream.h>
+#include <memory>
+
+#if defined(_MSC_VER) && !defined(_WIN32_WCE)
+    #define CARTOTYPE_MAPPED_FILE_WINDOWS
+    // Stop <windows.h> defining the min and max macros, which break std::min and std::max in code including this header,
+    // and including headers not needed here. The definitions are removed afterwards so that they do not affect other code.
+    #ifndef NOMINMAX
+        #define NOMINMAX
+        #define CARTOTYPE_MAPPED_FILE_UNDEF_NOMINMAX
+    #endif
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+        #define CARTOTYPE_MAPPED_FILE_UNDEF_WIN32_LEAN_AND_MEAN
+    #endif
+    #include <windows.h>
+    #ifdef CARTOTYPE_MAPPED_FILE_UNDEF_NOMINMAX
+        #undef NOMINMAX
+        #undef CARTOTYPE_MAPPED_FILE_UNDEF_NOMINMAX
+    #endif
+    #ifdef CARTOTYPE_MAPPED_FILE_UNDEF_WIN32_LEAN_AND_MEAN
+        #undef WIN32_LEAN_AND_MEAN
+        #undef CARTOTYPE_MAPPED_FILE_UNDEF_WIN32_LEAN_AND_MEAN
+    #endif
+    #include <string>
+#elif defined(_POSIX_VERSION) || defined(__APPLE__)
+    #define CARTOTYPE_MAPPED_FILE_POSIX
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+namespace CartoType
+{
+
+/** Hints about how a range of a memory-mapped file will be accessed. */
+enum class TFileAccessAdvice
+    {
+    /** No special treatment. */
+    Normal,
+    /** The data will be read in order, so read-ahead should be aggressive. */
+    Sequential,
+    /** The data will be read in random order, so read-ahead is not useful. */
+    Random,
+    /** The data will be needed soon, so it should be read into memory now. */
+    WillNeed,
+    /** The data will not be needed soon, so its memory may be reused. */
+    DontNeed
+    };
+
+/**
+A read-only memory mapping of a whole file. Mappings are reference-counted, using std::shared_ptr,
+so that any number of streams, on any number of threads, can read the same file using a single mapping and the operating system's
+page cache, without each having private buffers.
+
+Mapping needs enough address space for the whole file, so on 32-bit systems it may fail for large files;
+in that case the caller should use CFileInputStream instead.
+*/
+class CMappedFile
+    {
+    public:
+    /** Map a file, returning null and setting aError if that is impossible. */
+    static std::shared_ptr<CMappedFile> New(TResult& aError,const char* aFileName)
+        {
+        std::shared_ptr<CMappedFile> f(new CMappedFile);
+        aError = f->Construct(aFileName);
+        if (aError)
+            f.reset();
+        return f;
+        }
+
+    ~CMappedFile()
+        {
+#if defined(CARTOTYPE_MAPPED_FILE_WINDOWS)
+        if (iData)
+            UnmapViewOfFile(iData);
+        if (iMapping)
+            CloseHandle(iMapping);
+        if (iFile != INVALID_HANDLE_VALUE)
+            CloseHandle(iFile);
+#elif defined(CARTOTYPE_MAPPED_FILE_POSIX)
+        if (iData)
+            munmap(const_cast<uint8*>(iData),size_t(iSize));
+        if (iFile != -1)
+            close(iFile);
+#endif
+        }
+
+    /** Return a pointer to the start of the file's data. */
+    const uint8* Data() const { return iData; }
+    /** Return the size of the file in bytes. */
+    int64 Size() const { return iSize; }
+    /** Return the name of the file. */
+    const CString& Name() const { return iName; }
+
+    /**
+    Tell the operating system how a range of the file will be accessed: for example, that the index of a map file
+    will be read randomly, or that a section about to be drawn will be needed soon. The advice does not affect the data.
+    It is ignored on systems that do not support it.
+    */
+    TResult Advise(int64 aOffset,int64 aLength,TFileAccessAdvice aAdvice) const
+        {
+        if (aOffset < 0 || aLength < 0 || aOffset > iSize)
+            return KErrorInvalidArgument;
+        if (aLength > iSize - aOffset)
+            aLength = iSize - aOffset;
+        if (!aLength)
+            return KErrorNone;
+#if defined(CARTOTYPE_MAPPED_FILE_POSIX)
+        // madvise needs a page-aligned start address.
+        int64 page_size = sysconf(_SC_PAGESIZE);
+        int64 start = aOffset - aOffset % page_size;
+        int advice = MADV_NORMAL;
+        switch (aAdvice)
+            {
+            case TFileAccessAdvice::Normal: advice = MADV_NORMAL; break;
+            case TFileAccessAdvice::Sequential: advice = MADV_SEQUENTIAL; break;
+            case TFileAccessAdvice::Random: advice = MADV_RANDOM; break;
+            case TFileAccessAdvice::WillNeed: advice = MADV_WILLNEED; break;
+            case TFileAccessAdvice::DontNeed: advice = MADV_DONTNEED; break;
+            }
+        if (madvise(const_cast<uint8*>(iData) + start,size_t(aOffset + aLength - start),advice))
+            return KErrorIo;
+#else
+        (void)aAdvice;
+#endif
+        return KErrorNone;
+        }
+
+    private:
+    CMappedFile() = default;
+    CMappedFile(const CMappedFile&) = delete;
+    CMappedFile& operator=(const CMappedFile&) = delete;
+
+    TResult Construct(const char* aFileName)
+        {
+        iName.Set(aFileName);
+#if defined(CARTOTYPE_MAPPED_FILE_WINDOWS)
+        // The name is UTF-8, which the 'A' functions do not accept, so use the UTF-16 form held in iName.
+        std::wstring name(iName.Text(),iName.Text() + iName.Length());
+        iFile = CreateFileW(name.c_str(),GENERIC_READ,FILE_SHARE_READ,nullptr,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS,nullptr);
+        if (iFile == INVALID_HANDLE_VALUE)
+            return KErrorNotFound;
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(iFile,&size))
+            return KErrorIo;
+        iSize = size.QuadPart;
+        if (!iSize)
+            return KErrorNone;
+        if (uint64(iSize) > SIZE_MAX)
+            return KErrorNoMemory;
+        iMapping = CreateFileMappingW(iFile,nullptr,PAGE_READONLY,0,0,nullptr);
+        if (!iMapping)
+            return KErrorIo;
+        iData = (const uint8*)MapViewOfFile(iMapping,FILE_MAP_READ,0,0,0);
+        return iData ? KErrorNone : KErrorNoMemory;
+#elif defined(CARTOTYPE_MAPPED_FILE_POSIX)
+        iFile = open(aFileName,O_RDONLY);
+        if (iFile == -1)
+            return KErrorNotFound;
+        struct stat s;
+        if (fstat(iFile,&s))
+            return KErrorIo;
+        iSize = s.st_size;
+        if (!iSize)
+            return KErrorNone;
+        if (uint64(iSize) > SIZE_MAX)
+            return KErrorNoMemory;
+        void* p = mmap(nullptr,size_t(iSize),PROT_READ,MAP_SHARED,iFile,0);
+        if (p == MAP_FAILED)
+            return KErrorNoMemory;
+        iData = (const uint8*)p;
+        return KErrorNone;
+#else
+        (void)aFileName;
+        return KErrorUnimplemented;
+#endif
+        }
+
+#if defined(CARTOTYPE_MAPPED_FILE_WINDOWS)
+    HANDLE iFile = INVALID_HANDLE_VALUE;
+    HANDLE iMapping = nullptr;
+#else
+    int iFile = -1;
+#endif
+    const uint8* iData = nullptr;
+    int64 iSize = 0;
+    CString iName;
+    };
+
+/**
+An input stream reading a memory-mapped file. Read returns a pointer directly into the mapping, so no data is copied.
+Copies of the stream share the mapping, and so does any stream created from the same CMappedFile.
+*/
+class CMappedFileInputStream: public MInputStream
+    {
+    public:
+    /** Create a stream for a file, mapping it into memory. */
+    static std::unique_ptr<CMappedFileInputStream> New(TResult& aError,const char* aFileName)
+        {
+        std::shared_ptr<CMappedFile> file = CMappedFile::New(aError,aFileName);
+        if (aError)
+            return nullptr;
+        return New(file);
+        }
+
+    /** Create a stream for a file, mapping it into memory. */
+    static std::unique_ptr<CMappedFileInputStream> New(TResult& aError,const MString& aFileName)
+        {
+        return New(aError,aFileName.CreateUtf8String().c_str());
+        }
+
+    /** Create a stream for a file that has already been mapped, sharing the mapping. */
+    static std::unique_ptr<CMappedFileInputStream> New(std::shared_ptr<CMappedFile> aFile)
+        {
+        return std::unique_ptr<CMappedFileInputStream>(new CMappedFileInputStream(aFile));
+        }
+
+    /** Create a new stream reading the same file, sharing the mapping. */
+    std::unique_ptr<CMappedFileInputStream> Copy(TResult& aError) const
+        {
+        aError = KErrorNone;
+        return New(iFile);
+        }
+
+    /** Return the mapping used by the stream. */
+    std::shared_ptr<CMappedFile> File() const { return iFile; }
+
+    /** Give the operating system a hint about how a range of the file will be accessed. */
+    TResult Advise(int64 aOffset,int64 aLength,TFileAccessAdvice aAdvice) const
+        {
+        return iFile->Advise(aOffset,aLength,aAdvice);
+        }
+
+    // from MInputStream
+    /** Return a pointer to all the remaining data in the file, which stays valid for the lifetime of the mapping. */
+    TResult Read(const uint8*& aPointer,size_t& aLength) override
+        {
+        aPointer = iFile->Data() + iPosition;
+        aLength = size_t(iFile->Size() - iPosition);
+        iPosition = iFile->Size();
+        return KErrorNone;
+        }
+    bool EndOfStream() const override { return iPosition >= iFile->Size(); }
+    TResult Seek(int64 aPosition) override
+        {
+        if (aPosition < 0 || aPosition > iFile->Size())
+            return KErrorIo;
+        iPosition = aPosition;
+        return KErrorNone;
+        }
+    int64 Position(TResult& aError) override
+        {
+        aError = KErrorNone;
+        return iPosition;
+        }
+    int64 Length(TResult& aError) override
+        {
+        aError = KErrorNone;
+        return iFile->Size();
+        }
+    const MString* Name() override { return &iFile->Name(); }
+
+    private:
+    CMappedFileInputStream(std::shared_ptr<CMappedFile> aFile):
+        iFile(aFile)
+        {
+        }
+
+    std::shared_ptr<CMappedFile> iFile;
+    int64 iPosition = 0;
+    };
+
+}
+
+#endif
@@ -0,0 +1,526 @@
+/*
+CARTOTYPE_PIXEL_BLEND.H
+Copyright (C) 2017 CartoType Ltd.
+See www.cartotype.com for more information.
+*/
+
+#ifndef CARTOTYPE_PIXEL_BLEND_H__
+#define CARTOTYPE_PIXEL_BLEND_H__
+
+#include <cartotype_types.h>
+#include <algorithm>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+    #if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+        #define CARTOTYPE_PIXEL_BLEND_SSE2
+        #include <emmintrin.h>
+        #if defined(__GNUC__) || defined(__clang__)
+            #define CARTOTYPE_PIXEL_BLEND_AVX2
+            #define CARTOTYPE_TARGET_AVX2 __attribute__((target("avx2")))
+            #include <immintrin.h>
+        #elif defined(_MSC_VER) && _MSC_VER >= 1700
+            #define CARTOTYPE_PIXEL_BLEND_AVX2
+            #define CARTOTYPE_TARGET_AVX2
+            #include <immintrin.h>
+            #include <intrin.h>
+        #endif
+    #endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #define CARTOTYPE_PIXEL_BLEND_NEON
+    #include <arm_neon.h>
+#endif
+
+namespace CartoType
+{
+
+/**
+Functions to fill and composite horizontal spans of pixels in E32BitColor bitmaps, which hold premultiplied colors
+with the alpha level in the most significant byte of each 32-bit pixel. All compositing uses the source-over operator.
+
+Vector versions using SSE2, AVX2 or NEON are used where the processor supports them; the best version
+for the processor is chosen at run time by Get. All versions give exactly the same results.
+*/
+class TPixelBlender
+    {
+    public:
+    /** Instruction sets for which blending functions are available. */
+    enum class TInstructionSet
+        {
+        /** Portable C++. */
+        Scalar,
+        /** SSE2 on x86 and x64 processors, processing four pixels at a time. */
+        SSE2,
+        /** AVX2 on x86 and x64 processors, processing eight pixels at a time. */
+        AVX2,
+        /** NEON on ARM processors, processing eight pixels at a time. */
+        Neon
+        };
+
+    /** A function to blend a premultiplied color over every pixel in a span. */
+    typedef void (*TFillSpanFunction)(uint32* aDest,size_t aCount,uint32 aColor);
+    /** A function to blend a premultiplied color, scaled by an anti-aliasing coverage value for each pixel, over a span. */
+    typedef void (*TFillSpanWithCoverageFunction)(uint32* aDest,const uint8* aCoverage,size_t aCount,uint32 aColor);
+    /** A function to blend a span of premultiplied source pixels, scaled by an opacity in the range 0...255, over a span. */
+    typedef void (*TBlendSpanFunction)(uint32* aDest,const uint32* aSource,size_t aCount,int32 aOpacity);
+
+    /** Return the blender using the best instruction set supported by this processor. */
+    static const TPixelBlender& Get()
+        {
+        static const TPixelBlender blender(BestInstructionSet());
+        return blender;
+        }
+
+    /** Create a blender using a specified instruction set, or the scalar functions if it is not supported by this processor. */
+    explicit TPixelBlender(TInstructionSet aInstructionSet = TInstructionSet::Scalar)
+        {
+        if (!Supported(aInstructionSet))
+            aInstructionSet = TInstructionSet::Scalar;
+        iInstructionSet = aInstructionSet;
+        iFillSpan = FillSpanScalar;
+        iFillSpanWithCoverage = FillSpanWithCoverageScalar;
+        iBlendSpan = BlendSpanScalar;
+        switch (aInstructionSet)
+            {
+#if defined(CARTOTYPE_PIXEL_BLEND_SSE2)
+            case TInstructionSet::SSE2:
+                iFillSpan = FillSpanSSE2;
+                iFillSpanWithCoverage = FillSpanWithCoverageSSE2;
+                iBlendSpan = BlendSpanSSE2;
+                break;
+#endif
+#if defined(CARTOTYPE_PIXEL_BLEND_AVX2)
+            case TInstructionSet::AVX2:
+                iFillSpan = FillSpanAVX2;
+                iFillSpanWithCoverage = FillSpanWithCoverageAVX2;
+                iBlendSpan = BlendSpanAVX2;
+                break;
+#endif
+#if defined(CARTOTYPE_PIXEL_BLEND_NEON)
+            case TInstructionSet::Neon:
+                iFillSpan = FillSpanNeon;
+                iFillSpanWithCoverage = FillSpanWithCoverageNeon;
+                iBlendSpan = BlendSpanNeon;
+                break;
+#endif
+            default:
+                break;
+            }
+        }
+
+    /** Return true if this processor supports an instruction set. */
+    static bool Supported(TInstructionSet aInstructionSet)
+        {
+        switch (aInstructionSet)
+            {
+            case TInstructionSet::Scalar:
+                return true;
+#if defined(CARTOTYPE_PIXEL_BLEND_SSE2)
+            case TInstructionSet::SSE2:
+                return true;
+#endif
+#if defined(CARTOTYPE_PIXEL_BLEND_AVX2)
+            case TInstructionSet::AVX2:
+                return CpuSupportsAVX2();
+#endif
+#if defined(CARTOTYPE_PIXEL_BLEND_NEON)
+            case TInstructionSet::Neon:
+                return true;
+#endif
+            default:
+                return false;
+            }
+        }
+
+    /** Return the best instruction set supported by this processor. */
+    static TInstructionSet BestInstructionSet()
+        {
+        if (Supported(TInstructionSet::AVX2))
+            return TInstructionSet::AVX2;
+        if (Supported(TInstructionSet::SSE2))
+            return TInstructionSet::SSE2;
+        if (Supported(TInstructionSet::Neon))
+            return TInstructionSet::Neon;
+        return TInstructionSet::Scalar;
+        }
+
+    /** Return the instruction set used by this blender. */
+    TInstructionSet InstructionSet() const { return iInstructionSet; }
+
+    /** Blend the premultiplied color aColor over aCount pixels starting at aDest. */
+    void FillSpan(uint32* aDest,size_t aCount,uint32 aColor) const { iFillSpan(aDest,aCount,aColor); }
+
+    /** Blend the premultiplied color aColor, scaled by the coverage values in aCoverage, over aCount pixels starting at aDest. */
+    void FillSpanWithCoverage(uint32* aDest,const uint8* aCoverage,size_t aCount,uint32 aColor) const
+        {
+        iFillSpanWithCoverage(aDest,aCoverage,aCount,aColor);
+        }
+
+    /** Blend aCount premultiplied pixels from aSource, scaled by aOpacity in the range 0...255, over the pixels starting at aDest. */
+    void BlendSpan(uint32* aDest,const uint32* aSource,size_t aCount,int32 aOpacity) const
+        {
+        iBlendSpan(aDest,aSource,aCount,aOpacity);
+        }
+
+    /**
+    Multiply all four channels of aPixel by aFactor, treating both as fractions in the range 0...255.
+    The result is rounded to the nearest integer, unlike CGraphicsContext::MultiplyIntensities, so that multiplying by 255 has no effect.
+    */
+    static uint32 MultiplyPixel(uint32 aPixel,uint32 aFactor)
+        {
+        uint32 rb = (aPixel & 0x00FF00FF) * aFactor + 0x00800080;
+        rb = ((rb + ((rb >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF;
+        uint32 ag = ((aPixel >> 8) & 0x00FF00FF) * aFactor + 0x00800080;
+        ag = (ag + ((ag >> 8) & 0x00FF00FF)) & 0xFF00FF00;
+        return rb | ag;
+        }
+
+    /** Blend the premultiplied pixel aSource over the premultiplied pixel aDest. */
+    static uint32 SourceOver(uint32 aDest,uint32 aSource)
+        {
+        return aSource + MultiplyPixel(aDest,255 - (aSource >> 24));
+        }
+
+    private:
+    static void FillSpanScalar(uint32* aDest,size_t aCount,uint32 aColor)
+        {
+        if ((aColor >> 24) == 255)
+            std::fill(aDest,aDest + aCount,aColor);
+        else if (aColor)
+            {
+            uint32 inverse_alpha = 255 - (aColor >> 24);
+            for (size_t i = 0; i < aCount; i++)
+                aDest[i] = aColor + MultiplyPixel(aDest[i],inverse_alpha);
+            }
+        }
+
+    static void FillSpanWithCoverageScalar(uint32* aDest,const uint8* aCoverage,size_t aCount,uint32 aColor)
+        {
+        for (size_t i = 0; i < aCount; i++)
+            {
+            uint32 c = aCoverage[i];
+            if (c == 255)
+                aDest[i] = SourceOver(aDest[i],aColor);
+            else if (c)
+                aDest[i] = SourceOver(aDest[i],MultiplyPixel(aColor,c));
+            }
+        }
+
+    static void BlendSpanScalar(uint32* aDest,const uint32* aSource,size_t aCount,int32 aOpacity)
+        {
+        if (aOpacity <= 0)
+            return;
+        if (aOpacity >= 255)
+            {
+            for (size_t i = 0; i < aCount; i++)
+                {
+                uint32 s = aSource[i];
+                if ((s >> 24) == 255)
+                    aDest[i] = s;
+                else if (s)
+                    aDest[i] = SourceOver(aDest[i],s);
+                }
+            }
+        else
+            {
+            for (size_t i = 0; i < aCount; i++)
+                if (aSource[i])
+                    aDest[i] = SourceOver(aDest[i],MultiplyPixel(aSource[i],aOpacity));
+            }
+        }
+
+#if defined(CARTOTYPE_PIXEL_BLEND_SSE2)
+    // Each function works on pixels unpacked to 16 bits per channel, two pixels to a register.
+
+    /** Multiply 16-bit channels, in the range 0...255, with the same rounding as MultiplyPixel. */
+    static __m128i Multiply16SSE2(__m128i aA,__m128i aB)
+        {
+        __m128i t = _mm_add_epi16(_mm_mullo_epi16(aA,aB),_mm_set1_epi16(128));
+        return _mm_mulhi_epu16(t,_mm_set1_epi16(257));
+        }
+
+    /** Return the alpha levels of two unpacked pixels, copied to all four channels of each. */
+    static __m128i Alpha16SSE2(__m128i aPixels)
+        {
+        return _mm_shufflehi_epi16(_mm_shufflelo_epi16(aPixels,_MM_SHUFFLE(3,3,3,3)),_MM_SHUFFLE(3,3,3,3));
+        }
+
+    /** Blend two unpacked source pixels over two unpacked destination pixels. */
+    static __m128i SourceOver16SSE2(__m128i aDest,__m128i aSource)
+        {
+        __m128i inverse_alpha = _mm_sub_epi16(_mm_set1_epi16(255),Alpha16SSE2(aSource));
+        return _mm_add_epi16(aSource,Multiply16SSE2(aDest,inverse_alpha));
+        }
+
+    static void FillSpanSSE2(uint32* aDest,size_t aCount,uint32 aColor)
+        {
+        if ((aColor >> 24) == 255 || !aColor)
+            {
+            FillSpanScalar(aDest,aCount,aColor);
+            return;
+            }
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i color = _mm_unpacklo_epi8(_mm_set1_epi32(int32(aColor)),zero);
+        const __m128i inverse_alpha = _mm_sub_epi16(_mm_set1_epi16(255),Alpha16SSE2(color));
+        size_t i = 0;
+        for (; i + 4 <= aCount; i += 4)
+            {
+            __m128i d = _mm_loadu_si128((const __m128i*)(aDest + i));
+            __m128i lo = _mm_add_epi16(color,Multiply16SSE2(_mm_unpacklo_epi8(d,zero),inverse_alpha));
+            __m128i hi = _mm_add_epi16(color,Multiply16SSE2(_mm_unpackhi_epi8(d,zero),inverse_alpha));
+            _mm_storeu_si128((__m128i*)(aDest + i),_mm_packus_epi16(lo,hi));
+            }
+        FillSpanScalar(aDest + i,aCount - i,aColor);
+        }
+
+    static void FillSpanWithCoverageSSE2(uint32* aDest,const uint8* aCoverage,size_t aCount,uint32 aColor)
+        {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i color = _mm_unpacklo_epi8(_mm_set1_epi32(int32(aColor)),zero);
+        size_t i = 0;
+        for (; i + 4 <= aCount; i += 4)
+            {
+            int32 c4;
+            memcpy(&c4,aCoverage + i,4);
+            if (!c4)
+                continue;
+            // Spread the coverage of each pixel to its four channels.
+            __m128i c = _mm_unpacklo_epi8(_mm_cvtsi32_si128(c4),zero);
+            c = _mm_unpacklo_epi16(c,c);
+            __m128i c_lo = _mm_unpacklo_epi32(c,c);
+            __m128i c_hi = _mm_unpackhi_epi32(c,c);
+            __m128i d = _mm_loadu_si128((const __m128i*)(aDest + i));
+            __m128i lo = SourceOver16SSE2(_mm_unpacklo_epi8(d,zero),Multiply16SSE2(color,c_lo));
+            __m128i hi = SourceOver16SSE2(_mm_unpackhi_epi8(d,zero),Multiply16SSE2(color,c_hi));
+            _mm_storeu_si128((__m128i*)(aDest + i),_mm_packus_epi16(lo,hi));
+            }
+        FillSpanWithCoverageScalar(aDest + i,aCoverage + i,aCount - i,aColor);
+        }
+
+    static void BlendSpanSSE2(uint32* aDest,const uint32* aSource,size_t aCount,int32 aOpacity)
+        {
+        if (aOpacity <= 0)
+            return;
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i opacity = _mm_set1_epi16(int16(std::min(aOpacity,int32(255))));
+        size_t i = 0;
+        for (; i + 4 <= aCount; i += 4)
+            {
+            __m128i s = _mm_loadu_si128((const __m128i*)(aSource + i));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi32(s,zero)) == 0xFFFF)
+                continue;
+            __m128i s_lo = _mm_unpacklo_epi8(s,zero);
+            __m128i s_hi = _mm_unpackhi_epi8(s,zero);
+            if (aOpacity < 255)
+                {
+                s_lo = Multiply16SSE2(s_lo,opacity);
+                s_hi = Multiply16SSE2(s_hi,opacity);
+                }
+            __m128i d = _mm_loadu_si128((const __m128i*)(aDest + i));
+            __m128i lo = SourceOver16SSE2(_mm_unpacklo_epi8(d,zero),s_lo);
+            __m128i hi = SourceOver16SSE2(_mm_unpackhi_epi8(d,zero),s_hi);
+            _mm_storeu_si128((__m128i*)(aDest + i),_mm_packus_epi16(lo,hi));
+            }
+        BlendSpanScalar(aDest + i,aSource + i,aCount - i,aOpacity);
+        }
+#endif
+
+#if defined(CARTOTYPE_PIXEL_BLEND_AVX2)
+    // The AVX2 functions work like the SSE2 ones, on two 128-bit lanes at once, and use the SSE2 ones for the remaining pixels.
+
+    static bool CpuSupportsAVX2()
+        {
+#if defined(_MSC_VER) && !defined(__clang__)
+        int info[4];
+        __cpuid(info,0);
+        if (info[0] < 7)
+            return false;
+        __cpuid(info,1);
+        // The operating system must save the AVX registers.
+        if (!(info[2] & (1 << 27)) || (_xgetbv(0) & 6) != 6)
+            return false;
+        __cpuidex(info,7,0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2") != 0;
+#endif
+        }
+
+    CARTOTYPE_TARGET_AVX2 static __m256i Multiply16AVX2(__m256i aA,__m256i aB)
+        {
+        __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(aA,aB),_mm256_set1_epi16(128));
+        return _mm256_mulhi_epu16(t,_mm256_set1_epi16(257));
+        }
+
+    CARTOTYPE_TARGET_AVX2 static __m256i Alpha16AVX2(__m256i aPixels)
+        {
+        return _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(aPixels,_MM_SHUFFLE(3,3,3,3)),_MM_SHUFFLE(3,3,3,3));
+        }
+
+    CARTOTYPE_TARGET_AVX2 static __m256i SourceOver16AVX2(__m256i aDest,__m256i aSource)
+        {
+        __m256i inverse_alpha = _mm256_sub_epi16(_mm256_set1_epi16(255),Alpha16AVX2(aSource));
+        return _mm256_add_epi16(aSource,Multiply16AVX2(aDest,inverse_alpha));
+        }
+
+    CARTOTYPE_TARGET_AVX2 static void FillSpanAVX2(uint32* aDest,size_t aCount,uint32 aColor)
+        {
+        if ((aColor >> 24) == 255 || !aColor)
+            {
+            FillSpanScalar(aDest,aCount,aColor);
+            return;
+            }
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i color = _mm256_unpacklo_epi8(_mm256_set1_epi32(int32(aColor)),zero);
+        const __m256i inverse_alpha = _mm256_sub_epi16(_mm256_set1_epi16(255),Alpha16AVX2(color));
+        size_t i = 0;
+        for (; i + 8 <= aCount; i += 8)
+            {
+            __m256i d = _mm256_loadu_si256((const __m256i*)(aDest + i));
+            __m256i lo = _mm256_add_epi16(color,Multiply16AVX2(_mm256_unpacklo_epi8(d,zero),inverse_alpha));
+            __m256i hi = _mm256_add_epi16(color,Multiply16AVX2(_mm256_unpackhi_epi8(d,zero),inverse_alpha));
+            _mm256_storeu_si256((__m256i*)(aDest + i),_mm256_packus_epi16(lo,hi));
+            }
+        FillSpanSSE2(aDest + i,aCount - i,aColor);
+        }
+
+    CARTOTYPE_TARGET_AVX2 static void FillSpanWithCoverageAVX2(uint32* aDest,const uint8* aCoverage,size_t aCount,uint32 aColor)
+        {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i color = _mm256_unpacklo_epi8(_mm256_set1_epi32(int32(aColor)),zero);
+        size_t i = 0;
+        for (; i + 8 <= aCount; i += 8)
+            {
+            int64 c8;
+            memcpy(&c8,aCoverage + i,8);
+            if (!c8)
+                continue;
+            // Spread the coverage of each pixel to its four channels, in the same order as the unpacked pixels:
+            // the low half holds pixels 0, 1, 4 and 5, and the high half holds pixels 2, 3, 6 and 7.
+            __m256i c = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(aCoverage + i)));
+            c = _mm256_or_si256(c,_mm256_slli_epi32(c,16));
+            __m256i c_lo = _mm256_unpacklo_epi32(c,c);
+            __m256i c_hi = _mm256_unpackhi_epi32(c,c);
+            __m256i d = _mm256_loadu_si256((const __m256i*)(aDest + i));
+            __m256i lo = SourceOver16AVX2(_mm256_unpacklo_epi8(d,zero),Multiply16AVX2(color,c_lo));
+            __m256i hi = SourceOver16AVX2(_mm256_unpackhi_epi8(d,zero),Multiply16AVX2(color,c_hi));
+            _mm256_storeu_si256((__m256i*)(aDest + i),_mm256_packus_epi16(lo,hi));
+            }
+        FillSpanWithCoverageSSE2(aDest + i,aCoverage + i,aCount - i,aColor);
+        }
+
+    CARTOTYPE_TARGET_AVX2 static void BlendSpanAVX2(uint32* aDest,const uint32* aSource,size_t aCount,int32 aOpacity)
+        {
+        if (aOpacity <= 0)
+            return;
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i opacity = _mm256_set1_epi16(int16(std::min(aOpacity,int32(255))));
+        size_t i = 0;
+        for (; i + 8 <= aCount; i += 8)
+            {
+            __m256i s = _mm256_loadu_si256((const __m256i*)(aSource + i));
+            if (_mm256_testz_si256(s,s))
+                continue;
+            __m256i s_lo = _mm256_unpacklo_epi8(s,zero);
+            __m256i s_hi = _mm256_unpackhi_epi8(s,zero);
+            if (aOpacity < 255)
+                {
+                s_lo = Multiply16AVX2(s_lo,opacity);
+                s_hi = Multiply16AVX2(s_hi,opacity);
+                }
+            __m256i d = _mm256_loadu_si256((const __m256i*)(aDest + i));
+            __m256i lo = SourceOver16AVX2(_mm256_unpacklo_epi8(d,zero),s_lo);
+            __m256i hi = SourceOver16AVX2(_mm256_unpackhi_epi8(d,zero),s_hi);
+            _mm256_storeu_si256((__m256i*)(aDest + i),_mm256_packus_epi16(lo,hi));
+            }
+        BlendSpanSSE2(aDest + i,aSource + i,aCount - i,aOpacity);
+        }
+#endif
+
+#if defined(CARTOTYPE_PIXEL_BLEND_NEON)
+    // The NEON functions load eight pixels at a time, separated into planes for each channel.
+
+    /** Multiply eight-bit channels with the same rounding as MultiplyPixel. */
+    static uint8x8_t Multiply8Neon(uint8x8_t aA,uint8x8_t aB)
+        {
+        uint16x8_t t = vaddq_u16(vmull_u8(aA,aB),vdupq_n_u16(128));
+        return vshrn_n_u16(vsraq_n_u16(t,t,8),8);
+        }
+
+    static void SourceOverNeon(uint8x8x4_t& aDest,const uint8x8x4_t& aSource)
+        {
+        uint8x8_t inverse_alpha = vmvn_u8(aSource.val[3]);
+        for (int j = 0; j < 4; j++)
+            aDest.val[j] = vadd_u8(aSource.val[j],Multiply8Neon(aDest.val[j],inverse_alpha));
+        }
+
+    static void FillSpanNeon(uint32* aDest,size_t aCount,uint32 aColor)
+        {
+        if ((aColor >> 24) == 255 || !aColor)
+            {
+            FillSpanScalar(aDest,aCount,aColor);
+            return;
+            }
+        uint8x8x4_t color;
+        for (int j = 0; j < 4; j++)
+            color.val[j] = vdup_n_u8(uint8(aColor >> (j * 8)));
+        size_t i = 0;
+        for (; i + 8 <= aCount; i += 8)
+            {
+            uint8x8x4_t d = vld4_u8((const uint8*)(aDest + i));
+            SourceOverNeon(d,color);
+            vst4_u8((uint8*)(aDest + i),d);
+            }
+        FillSpanScalar(aDest + i,aCount - i,aColor);
+        }
+
+    static void FillSpanWithCoverageNeon(uint32* aDest,const uint8* aCoverage,size_t aCount,uint32 aColor)
+        {
+        uint8x8_t color[4];
+        for (int j = 0; j < 4; j++)
+            color[j] = vdup_n_u8(uint8(aColor >> (j * 8)));
+        size_t i = 0;
+        for (; i + 8 <= aCount; i += 8)
+            {
+            uint8x8_t c = vld1_u8(aCoverage + i);
+            if (!vget_lane_u64(vreinterpret_u64_u8(c),0))
+                continue;
+            uint8x8x4_t s;
+            for (int j = 0; j < 4; j++)
+                s.val[j] = Multiply8Neon(color[j],c);
+            uint8x8x4_t d = vld4_u8((const uint8*)(aDest + i));
+            SourceOverNeon(d,s);
+            vst4_u8((uint8*)(aDest + i),d);
+            }
+        FillSpanWithCoverageScalar(aDest + i,aCoverage + i,aCount - i,aColor);
+        }
+
+    static void BlendSpanNeon(uint32* aDest,const uint32* aSource,size_t aCount,int32 aOpacity)
+        {
+        if (aOpacity <= 0)
+            return;
+        uint8x8_t opacity = vdup_n_u8(uint8(std::min(aOpacity,int32(255))));
+        size_t i = 0;
+        for (; i + 8 <= aCount; i += 8)
+            {
+            uint8x8x4_t s = vld4_u8((const uint8*)(aSource + i));
+            if (aOpacity < 255)
+                for (int j = 0; j < 4; j++)
+                    s.val[j] = Multiply8Neon(s.val[j],opacity);
+            uint8x8x4_t d = vld4_u8((const uint8*)(aDest + i));
+            SourceOverNeon(d,s);
+            vst4_u8((uint8*)(aDest + i),d);
+            }
+        BlendSpanScalar(aDest + i,aSource + i,aCount - i,aOpacity);
+        }
+#endif
+
+    TInstructionSet iInstructionSet;
+    TFillSpanFunction iFillSpan;
+    TFillSpanWithCoverageFunction iFillSpanWithCoverage;
+    TBlendSpanFunction iBlendSpan;
+    };
+
+}
+
+#endif
@@ -0,0 +1,348 @@
+/*
+CARTOTYPE_PREFETCH.H
+Copyright (C) 2017 CartoType Ltd.
+See www.cartotype.com for more information.
+*/
+
+#ifndef CARTOTYPE_PREFETCH_H__
+#define CARTOTYPE_PREFETCH_H__
+
+#include <cartotype_shared_file_buffer.h>
+#include <cartotype_io_uring_reader.h>
+#include <cartotype_base.h>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+#include <unordered_set>
+
+namespace CartoType
+{
+
+/**
+Predicts where the view will be shortly, from the movement of its center, so that the data needed to draw it
+can be prefetched while the user is panning. The velocity is smoothed so that a single jerky movement has little effect.
+Any coordinate system can be used as long as it is used consistently.
+*/
+class TViewMotionPredictor
+    {
+    public:
+    /** Record the view at a certain time in seconds, for example after Pan or SetViewCenter. */
+    void Update(double aTimeInSeconds,const TRectFP& aView)
+        {
+        if (iHaveView && aTimeInSeconds > iTime)
+            {
+            double dt = aTimeInSeconds - iTime;
+            TPointFP old_center = iView.Center();
+            TPointFP new_center = aView.Center();
+            double vx = (new_center.iX - old_center.iX) / dt;
+            double vy = (new_center.iY - old_center.iY) / dt;
+
+            // Give the new velocity half the weight, or all of it if the view has been still for half a second or more.
+            double weight = dt >= 0.5 ? 1 : 0.5;
+            iVelocity.iX = iVelocity.iX * (1 - weight) + vx * weight;
+            iVelocity.iY = iVelocity.iY * (1 - weight) + vy * weight;
+            }
+        iView = aView;
+        iTime = aTimeInSeconds;
+        iHaveView = true;
+        }
+
+    /** Stop predicting movement, for example after the view has jumped to a new place. */
+    void Reset()
+        {
+        iHaveView = false;
+        iVelocity = TPointFP();
+        }
+
+    /** Return true if the view is moving fast enough to make prefetching worthwhile: at least a tenth of its width or height per second. */
+    bool IsMoving() const
+        {
+        return iHaveView && (fabs(iVelocity.iX) * 10 >= iView.Width() || fabs(iVelocity.iY) * 10 >= iView.Height());
+        }
+
+    /** Return the predicted view aLookAheadInSeconds after the last update. */
+    TRectFP PredictedView(double aLookAheadInSeconds) const
+        {
+        TRectFP r(iView);
+        double dx = iVelocity.iX * aLookAheadInSeconds;
+        double dy = iVelocity.iY * aLookAheadInSeconds;
+        r.iTopLeft.iX += dx;
+        r.iTopLeft.iY += dy;
+        r.iBottomRight.iX += dx;
+        r.iBottomRight.iY += dy;
+        return r;
+        }
+
+    /** Return the smoothed velocity of the center of the view in coordinate units per second. */
+    TPointFP Velocity() const { return iVelocity; }
+
+    private:
+    TRectFP iView;
+    TPointFP iVelocity;
+    double iTime = 0;
+    bool iHaveView = false;
+    };
+
+/** Where CFilePrefetcher puts the data it reads. */
+enum class TPrefetchTarget
+    {
+    /** Blocks are added to a CSharedFileBufferCache, for streams such as CSharedFileBufferStream which read through it. */
+    SharedCache,
+    /**
+    Blocks are read and discarded, leaving them in the operating system's page cache. This helps everything reading the file,
+    including the file streams used by CFramework to draw maps, which do not read through a CSharedFileBufferCache.
+    */
+    PageCache
+    };
+
+/**
+Reads parts of files on a background thread, so that they are already in memory when they are needed.
+For example, when the view is panning, the caller can predict the next view using TViewMotionPredictor, find the map data blocks covering it,
+and pass their byte ranges to Prefetch; or it can do the same for the part of a navigation route ahead of the current position.
+The blocks are read in batches using CIoUringFileReader, and put into a CSharedFileBufferCache or left in the operating system's page cache,
+according to the target passed to the constructor.
+
+The number of blocks waiting to be read is limited; when the limit is reached, the oldest requests are discarded, because they
+are the least likely to be relevant. When the target is a CSharedFileBufferCache, blocks already in it are not read again.
+*/
+class CFilePrefetcher
+    {
+    public:
+    /**
+    Create a prefetcher. The cache supplies the block size and file identifiers; when aTarget is TPrefetchTarget::PageCache
+    nothing is added to it.
+    */
+    CFilePrefetcher(CSharedFileBufferCache& aCache = CSharedFileBufferCache::Global(),size_t aMaxPendingBlocks = KDefaultMaxPendingBlocks,
+                    TPrefetchTarget aTarget = TPrefetchTarget::SharedCache):
+        iCache(aCache),
+        iMaxPendingBlocks(aMaxPendingBlocks ? aMaxPendingBlocks : 1),
+        iTarget(aTarget)
+        {
+        iThread = std::thread(&CFilePrefetcher::Run,this);
+        }
+
+    ~CFilePrefetcher()
+        {
+            {
+            std::lock_guard<std::mutex> lock(iMutex);
+            iStop = true;
+            }
+        iCondition.notify_all();
+        iThread.join();
+        }
+
+    /** Request the bytes from aOffset to aOffset + aLength - 1 of a file to be read into the cache. */
+    TResult Prefetch(const char* aFileName,int64 aOffset,int64 aLength)
+        {
+        if (aOffset < 0 || aLength < 0)
+            return KErrorInvalidArgument;
+        if (!aLength)
+            return KErrorNone;
+        uint32 file_id = iCache.FileId(aFileName);
+        int64 block_size = int64(iCache.BlockSize());
+        int64 start = aOffset - aOffset % block_size;
+        std::vector<TSharedFileBufferKey> key_array;
+        for (int64 pos = start; pos < aOffset + aLength; pos += block_size)
+            if (iTarget == TPrefetchTarget::PageCache || !iCache.Contains(file_id,pos))
+                {
+                TSharedFileBufferKey key;
+                key.iFileId = file_id;
+                key.iPosition = pos;
+                key_array.push_back(key);
+                }
+        if (key_array.empty())
+            return KErrorNone;
+
+        std::unique_lock<std::mutex> lock(iMutex);
+        for (const auto& key : key_array)
+            {
+            if (!iPendingSet.insert(key).second)
+                continue;
+            iPending.push_back(key);
+            TPendingFile& pending_file = iPendingFile[file_id];
+            if (!pending_file.iBlockCount++)
+                pending_file.iName = aFileName;
+            if (iPending.size() > iMaxPendingBlocks)
+                PopPending();
+            }
+        lock.unlock();
+        iCondition.notify_one();
+        return KErrorNone;
+        }
+
+    /** Discard all requests that have not yet been started. */
+    void Cancel()
+        {
+        std::lock_guard<std::mutex> lock(iMutex);
+        iPending.clear();
+        iPendingSet.clear();
+        iPendingFile.clear();
+        }
+
+    /** Return the number of blocks waiting to be read. */
+    size_t PendingCount()
+        {
+        std::lock_guard<std::mutex> lock(iMutex);
+        return iPending.size();
+        }
+
+    /** Return the number of blocks read into the cache so far. */
+    uint64 LoadedCount() const { return iLoadedCount; }
+
+    /** The default maximum number of blocks waiting to be read. */
+    static const size_t KDefaultMaxPendingBlocks = 1024;
+    /** The maximum number of blocks read as a single batch. */
+    static const size_t KMaxBatchSize = 32;
+    /** The maximum number of files kept open by the prefetch thread. */
+    static const size_t KMaxOpenFiles = 8;
+
+    private:
+    CFilePrefetcher(const CFilePrefetcher&) = delete;
+    CFilePrefetcher& operator=(const CFilePrefetcher&) = delete;
+
+    /** A file opened by the prefetch thread. */
+    class CFile
+        {
+        public:
+        uint32 iFileId = 0;
+        CBinaryInputFile iFile;
+        int64 iLength = -1;
+        };
+
+    /** The name of a file with blocks waiting to be read, and the number of those blocks. */
+    class TPendingFile
+        {
+        public:
+        std::string iName;
+        size_t iBlockCount = 0;
+        };
+
+    // Remove the first waiting block, forgetting the name of its file if no other blocks from that file are waiting. The caller must lock iMutex.
+    void PopPending()
+        {
+        const TSharedFileBufferKey& key = iPending.front();
+        auto p = iPendingFile.find(key.iFileId);
+        if (p != iPendingFile.end() && !--p->second.iBlockCount)
+            iPendingFile.erase(p);
+        iPendingSet.erase(key);
+        iPending.pop_front();
+        }
+
+    void Run()
+        {
+        // Files are opened and read only by this thread, so they need no locking. The most recently used file is last.
+        std::vector<std::unique_ptr<CFile>> open_file_array;
+        std::vector<int64> position_array;
+        std::vector<uint8> scratch;
+        for (;;)
+            {
+            // Take up to KMaxBatchSize blocks from the same file so that they can be read as a batch.
+            uint32 file_id = 0;
+            std::string file_name;
+            position_array.clear();
+                {
+                std::unique_lock<std::mutex> lock(iMutex);
+                if (!iStop && iPending.empty() && !open_file_array.empty())
+                    {
+                    // Close the files while there is nothing to read, so that files which are deleted or replaced are not kept open.
+                    lock.unlock();
+                    open_file_array.clear();
+                    lock.lock();
+                    }
+                while (!iStop && iPending.empty())
+                    iCondition.wait(lock);
+                if (iStop)
+                    return;
+                file_id = iPending.front().iFileId;
+                file_name = iPendingFile[file_id].iName;
+                while (!iPending.empty() && iPending.front().iFileId == file_id && position_array.size() < KMaxBatchSize)
+                    {
+                    position_array.push_back(iPending.front().iPosition);
+                    PopPending();
+                    }
+                }
+
+            // If the file cannot be opened these blocks are dropped; later requests for the file try to open it again.
+            CFile* file = OpenFile(open_file_array,file_id,file_name);
+            if (!file)
+                continue;
+            bool shared_cache = iTarget == TPrefetchTarget::SharedCache;
+            auto p = std::remove_if(position_array.begin(),position_array.end(),
+                                    [&](int64 aPos) { return aPos >= file->iLength || (shared_cache && iCache.Contains(file_id,aPos)); });
+            position_array.erase(p,position_array.end());
+            if (position_array.empty())
+                continue;
+            TResult error = shared_cache ? iCache.LoadBatch(file->iFile,file_id,position_array,file->iLength) :
+                                           ReadIntoPageCache(*file,position_array,scratch);
+            if (!error)
+                iLoadedCount += position_array.size();
+            }
+        }
+
+    /**
+    Return an open file from aOpenFileArray, opening it if necessary and closing the least recently used file if too many are open,
+    and make it the most recently used. Its length is found again every time, because the file may have been extended.
+    Return null if the file cannot be opened.
+    */
+    CFile* OpenFile(std::vector<std::unique_ptr<CFile>>& aOpenFileArray,uint32 aFileId,const std::string& aFileName)
+        {
+        auto p = std::find_if(aOpenFileArray.begin(),aOpenFileArray.end(),[aFileId](const std::unique_ptr<CFile>& aFile) { return aFile->iFileId == aFileId; });
+        std::unique_ptr<CFile> file;
+        if (p != aOpenFileArray.end())
+            {
+            file = std::move(*p);
+            aOpenFileArray.erase(p);
+            }
+        else
+            {
+            file.reset(new CFile);
+            file->iFileId = aFileId;
+            if (file->iFile.Open(aFileName.c_str()))
+                return nullptr;
+            if (aOpenFileArray.size() >= KMaxOpenFiles)
+                aOpenFileArray.erase(aOpenFileArray.begin());
+            }
+        if (file->iFile.Seek(0,SEEK_END))
+            return nullptr;
+        file->iLength = file->iFile.Tell();
+        aOpenFileArray.push_back(std::move(file));
+        return aOpenFileArray.back().get();
+        }
+
+    /** Read blocks into a scratch buffer, which is discarded, so that they are left in the operating system's page cache. */
+    TResult ReadIntoPageCache(CFile& aFile,const std::vector<int64>& aPosition,std::vector<uint8>& aScratch)
+        {
+        size_t block_size = iCache.BlockSize();
+        aScratch.resize(block_size * aPosition.size());
+        std::vector<TFileReadRequest> request_array(aPosition.size());
+        for (size_t i = 0; i < aPosition.size(); i++)
+            {
+            TFileReadRequest& r = request_array[i];
+            r.iBuffer = aScratch.data() + i * block_size;
+            r.iSize = size_t(std::min(int64(block_size),aFile.iLength - aPosition[i]));
+            r.iPosition = aPosition[i];
+            }
+        TResult error = CIoUringFileReader::ReadBatch(aFile.iFile,request_array.data(),request_array.size());
+        for (size_t i = 0; !error && i < request_array.size(); i++)
+            if (request_array[i].iBytesRead != request_array[i].iSize)
+                error = KErrorIo;
+        return error;
+        }
+
+    CSharedFileBufferCache& iCache;
+    size_t iMaxPendingBlocks;
+    TPrefetchTarget iTarget;
+    std::mutex iMutex;
+    std::condition_variable iCondition;
+    std::deque<TSharedFileBufferKey> iPending;
+    std::unordered_set<TSharedFileBufferKey,TSharedFileBufferKeyHash> iPendingSet;
+    std::unordered_map<uint32,TPendingFile> iPendingFile;
+    std::atomic<uint64> iLoadedCount { 0 };
+    bool iStop = false;
+    std::thread iThread;
+    };
+
+}
+
+#endif
@@ -0,0 +1,276 @@
+/*
+CARTOTYPE_PROGRESSIVE_VIEW.H
+Copyright (C) 2017 CartoType Ltd.
+See www.cartotype.com for more information.
+*/
+
+#ifndef CARTOTYPE_PROGRESSIVE_VIEW_H__
+#define CARTOTYPE_PROGRESSIVE_VIEW_H__
+
+#include <cartotype_incremental_view.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <string.h>
+
+namespace CartoType
+{
+
+/**
+A map renderer which draws the map over several calls, each taking no more than a given time,
+so that a user interface can stay responsive while a slow map is drawn.
+
+Each call to Draw does as many steps of the drawing as fit in its time budget, always doing at least one,
+and returns the bitmap drawn so far. The steps are, in order:
+
+1. A preview of the whole view, drawn without labels at a fraction of the full resolution and enlarged to fill the bitmap,
+   so that the first call gives an approximation of the whole map.
+2. The view at full resolution, without labels, in square tiles starting from the center of the view and working outwards,
+   so that the part of the map the user is most likely to be looking at is refined first.
+3. The labels for the whole view, drawn in one step so that they are placed consistently, and drawn over the map.
+
+Each step is drawn by CFramework::TileBitmap, so a step cannot be interrupted. The time taken by the most recent step is used to
+decide whether another step fits into the remaining budget. Any change to the view, map data, style sheet or dynamic map objects
+restarts the drawing. The framework must draw 32-bit color bitmaps.
+*/
+class CProgressiveMapRenderer: public MFrameworkObserver
+    {
+    public:
+    /**
+    Create a progressive map renderer for a framework, which must remain in existence while the renderer exists.
+    The map is drawn in tiles of aTileSize pixels, after a preview at 1/aPreviewScale of the full resolution.
+    A preview scale of 1 or less causes no preview to be drawn; the bitmap is then cleared each time the drawing starts.
+    */
+    static std::unique_ptr<CProgressiveMapRenderer> New(TResult& aError,CFramework& aFramework,int32 aTileSize = KDefaultTileSize,int32 aPreviewScale = KDefaultPreviewScale)
+        {
+        aError = KErrorNone;
+        if (aTileSize <= 0)
+            {
+            aError = KErrorInvalidArgument;
+            return nullptr;
+            }
+        std::unique_ptr<CProgressiveMapRenderer> renderer(new CProgressiveMapRenderer(aFramework,aTileSize,aPreviewScale));
+        aFramework.AddObserver(renderer.get());
+        return renderer;
+        }
+
+    ~CProgressiveMapRenderer()
+        {
+        iFramework.RemoveObserver(this);
+        }
+
+    /**
+    Continue drawing the map, spending up to aTimeBudgetInMilliseconds, and return the bitmap drawn so far.
+    Set aComplete to true if the map has been drawn completely. When the map is complete, further calls return it
+    without drawing anything until it is restarted, either by a change to the view or data, or by calling Restart.
+    */
+    const TBitmap* Draw(TResult& aError,double aTimeBudgetInMilliseconds,bool& aComplete)
+        {
+        aError = KErrorNone;
+        aComplete = false;
+        if (!iStarted)
+            {
+            aError = Start();
+            if (aError)
+                return nullptr;
+            }
+
+        auto start = std::chrono::steady_clock::now();
+        double elapsed = 0;
+        while (iNextStep < iStep.size())
+            {
+            if (elapsed > 0 && elapsed + iLastStepTime > aTimeBudgetInMilliseconds)
+                break;
+            auto step_start = std::chrono::steady_clock::now();
+            aError = DrawStep(iStep[iNextStep]);
+            if (aError)
+                {
+                iStarted = false;
+                return nullptr;
+                }
+            iNextStep++;
+            auto now = std::chrono::steady_clock::now();
+            iLastStepTime = std::chrono::duration<double,std::milli>(now - step_start).count();
+            elapsed = std::chrono::duration<double,std::milli>(now - start).count();
+            }
+
+        aComplete = iNextStep == iStep.size();
+        return &iMap;
+        }
+
+    /** Start drawing the map again from the beginning at the next call to Draw. */
+    void Restart() { iStarted = false; }
+
+    /** Return true if the map has been drawn completely. */
+    bool Complete() const { return iStarted && iNextStep == iStep.size(); }
+    /** Return the proportion of the drawing steps done, in the range 0...1. */
+    double Progress() const { return iStarted && !iStep.empty() ? double(iNextStep) / double(iStep.size()) : 0; }
+
+    // virtual functions from MFrameworkObserver
+    void OnViewChange() override { iStarted = false; }
+    void OnMainDataChange() override { iStarted = false; }
+    void OnDynamicDataChange() override { iStarted = false; }
+
+    enum
+        {
+        /** The default size of the square tiles in which the map is drawn, in pixels. */
+        KDefaultTileSize = 256,
+        /** The default ratio of the full resolution to the resolution of the preview. */
+        KDefaultPreviewScale = 4
+        };
+
+    private:
+    CProgressiveMapRenderer(CFramework& aFramework,int32 aTileSize,int32 aPreviewScale):
+        iFramework(aFramework),
+        iTileSize(aTileSize),
+        iPreviewScale(aPreviewScale),
+        iLabelCollector(iLabel)
+        {
+        }
+
+    CProgressiveMapRenderer(const CProgressiveMapRenderer&) = delete;
+    CProgressiveMapRenderer& operator=(const CProgressiveMapRenderer&) = delete;
+
+    enum class TStepType
+        {
+        Preview,
+        Tile,
+        Labels
+        };
+
+    class TStep
+        {
+        public:
+        TStepType iType;
+        TRect iArea;
+        };
+
+    /** Create the bitmap and the list of steps. */
+    TResult Start()
+        {
+        int32 width = 0, height = 0;
+        TResult error = GetViewSize(iFramework,width,height);
+        if (error)
+            return error;
+        if (iMap.Width() != width || iMap.Height() != height)
+            iMap = CBitmap(TBitmap::E32BitColor,width,height);
+
+        iStep.clear();
+        TRect view(0,0,width,height);
+        if (iPreviewScale > 1 && width / iPreviewScale > 0 && height / iPreviewScale > 0)
+            iStep.push_back(TStep { TStepType::Preview,view });
+        else
+            {
+            // Without a preview to cover it, the bitmap would show the previous map until the tiles were drawn.
+            iMap.Clear();
+            }
+
+        // Order the tiles by the distance of their centers from the center of the view.
+        size_t first_tile = iStep.size();
+        for (int32 y = 0; y < height; y += iTileSize)
+            for (int32 x = 0; x < width; x += iTileSize)
+                iStep.push_back(TStep { TStepType::Tile,TRect(x,y,std::min(x + iTileSize,width),std::min(y + iTileSize,height)) });
+        TPoint center = view.Center();
+        std::stable_sort(iStep.begin() + first_tile,iStep.end(),[center](const TStep& aA,const TStep& aB)
+            {
+            return DistanceSquared(aA.iArea.Center(),center) < DistanceSquared(aB.iArea.Center(),center);
+            });
+
+        iStep.push_back(TStep { TStepType::Labels,view });
+        iNextStep = 0;
+        iLastStepTime = 0;
+        iStarted = true;
+        return KErrorNone;
+        }
+
+    TResult DrawStep(const TStep& aStep)
+        {
+        TResult error = KErrorNone;
+        TTileBitmapParam param;
+        switch (aStep.iType)
+            {
+            case TStepType::Preview:
+                {
+                param.iDrawLabels = false;
+                int32 width = aStep.iArea.Width() / iPreviewScale;
+                int32 height = aStep.iArea.Height() / iPreviewScale;
+                const TBitmap* bitmap = ViewAreaBitmap(error,iFramework,aStep.iArea,width,height,&param);
+                if (!error)
+                    Enlarge(*bitmap);
+                }
+                break;
+
+            case TStepType::Tile:
+                {
+                param.iDrawLabels = false;
+                const TRect& area = aStep.iArea;
+                const TBitmap* bitmap = ViewAreaBitmap(error,iFramework,area,area.Width(),area.Height(),&param);
+                if (!error)
+                    {
+                    for (int32 y = 0; y < area.Height(); y++)
+                        memcpy(iMap.Data() + (area.Top() + y) * iMap.RowBytes() + area.Left() * 4,bitmap->Data() + y * bitmap->RowBytes(),size_t(area.Width()) * 4);
+                    }
+                }
+                break;
+
+            case TStepType::Labels:
+                {
+                param.iDrawMapObjects = false;
+                param.iDrawBackground = false;
+                param.iLabelHandler = &iLabelCollector;
+                iLabel.clear();
+                iLabelCollector.iOrigin = aStep.iArea.iTopLeft;
+                ViewAreaBitmap(error,iFramework,aStep.iArea,aStep.iArea.Width(),aStep.iArea.Height(),&param);
+                if (!error)
+                    {
+                    const TPixelBlender& blender = TPixelBlender::Get();
+                    for (const auto& label : iLabel)
+                        label.Draw(iMap,blender);
+                    }
+                iLabel.clear();
+                }
+                break;
+            }
+        return error;
+        }
+
+    /** Enlarge the preview bitmap to fill the map bitmap, by pixel replication. */
+    void Enlarge(const TBitmap& aPreview)
+        {
+        int32 width = iMap.Width();
+        int32 height = iMap.Height();
+        std::vector<int32> source_x(width);
+        for (int32 x = 0; x < width; x++)
+            source_x[x] = std::min(x / iPreviewScale,aPreview.Width() - 1);
+        for (int32 y = 0; y < height; y++)
+            {
+            const uint32* source = (const uint32*)(aPreview.Data() + std::min(y / iPreviewScale,aPreview.Height() - 1) * aPreview.RowBytes());
+            uint32* dest = (uint32*)(iMap.Data() + y * iMap.RowBytes());
+            for (int32 x = 0; x < width; x++)
+                dest[x] = source[source_x[x]];
+            }
+        }
+
+    static int64 DistanceSquared(const TPoint& aA,const TPoint& aB)
+        {
+        int64 dx = aA.iX - aB.iX;
+        int64 dy = aA.iY - aB.iY;
+        return dx * dx + dy * dy;
+        }
+
+    CFramework& iFramework;
+    int32 iTileSize;
+    int32 iPreviewScale;
+    CBitmap iMap;
+    std::vector<TStep> iStep;
+    size_t iNextStep = 0;
+    double iLastStepTime = 0;       // the time taken by the last step in milliseconds
+    bool iStarted = false;
+    std::vector<TDisplayLabel> iLabel;
+    TDisplayLabelCollector iLabelCollector;
+    };
+
+}
+
+#endif
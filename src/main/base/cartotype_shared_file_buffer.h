@@ -0,0 +1,359 @@
+/*
+CARTOTYPE_SHARED_FILE_BUFFER.H
+Copyright (C) 2017 CartoType Ltd.
+See www.cartotype.com for more information.
+*/
+
+#ifndef CARTOTYPE_SHARED_FILE_BUFFER_H__
+#define CARTOTYPE_SHARED_FILE_BUFFER_H__
+
+#include <cartotype_stream.h>
+#include <cartotype_io_uring_reader.h>
+#include <cartotype_cache.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if defined(_POSIX_VERSION) || defined(__APPLE__)
+    #include <limits.h>
+    #include <stdlib.h>
+#endif
+
+namespace CartoType
+{
+
+/** The key of a CSharedFileBuffer: the file it belongs to and its position in the file. */
+class TSharedFileBufferKey
+    {
+    public:
+    bool operator==(const TSharedFileBufferKey& aOther) const { return iFileId == aOther.iFileId && iPosition == aOther.iPosition; }
+
+    /** The identifier of the file, as returned by CSharedFileBufferCache::FileId. */
+    uint32 iFileId = 0;
+    /** The position of the block in the file. */
+    int64 iPosition = 0;
+    };
+
+/** A hash function for TSharedFileBufferKey. */
+class TSharedFileBufferKeyHash
+    {
+    public:
+    size_t operator()(const TSharedFileBufferKey& aKey) const
+        {
+        uint64 h = (uint64(aKey.iFileId) << 40) ^ uint64(aKey.iPosition);
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 33;
+        return size_t(h);
+        }
+    };
+
+/** A block of data read from a file and shared by all the streams reading that file. */
+class CSharedFileBuffer
+    {
+    public:
+    CSharedFileBuffer(uint32 aFileId,int64 aPosition,size_t aSize):
+        iData(aSize)
+        {
+        iKey.iFileId = aFileId;
+        iKey.iPosition = aPosition;
+        }
+
+    const TSharedFileBufferKey& Key() const { return iKey; }
+    /** Return the size of the block in bytes. */
+    int32 Size() const { return int32(iData.size()); }
+    /** Return the position of the block in the file. */
+    int64 Position() const { return iKey.iPosition; }
+    /** Return the data. */
+    const uint8* Data() const { return iData.data(); }
+
+    private:
+    friend class CSharedFileBufferCache;
+
+    TSharedFileBufferKey iKey;
+    std::vector<uint8> iData;
+    };
+
+/**
+A thread-safe cache of blocks of file data shared by all the streams reading the same files,
+so that when there are several copies of a framework, each drawing on its own thread, hot map data
+is held once rather than once for each copy.
+
+Blocks are keyed by file and position, and are held by shared pointers, so a block in use by a stream stays
+valid after it has been discarded from the cache. Lookups are divided between shards, each with its own lock,
+chosen by the hash of the key. The numbers of hits and misses are counted.
+*/
+class CSharedFileBufferCache
+    {
+    public:
+    CSharedFileBufferCache(size_t aMaxBytes = KDefaultMaxBytes,size_t aBlockSize = KDefaultBlockSize):
+        iBlockSize(aBlockSize ? aBlockSize : size_t(KDefaultBlockSize)),
+        iCache(MaxSize(aMaxBytes))
+        {
+        }
+
+    /** Return the cache shared by the whole process. */
+    static CSharedFileBufferCache& Global()
+        {
+        static CSharedFileBufferCache cache;
+        return cache;
+        }
+
+    /**
+    Return the identifier for a file, allocating a new one the first time a file is used.
+    Where possible the name is converted to a canonical absolute path, so that different names for the same file share blocks.
+    */
+    uint32 FileId(const char* aFileName)
+        {
+        std::string name(aFileName);
+#if defined(_POSIX_VERSION) || defined(__APPLE__)
+        char path[PATH_MAX];
+        if (realpath(aFileName,path))
+            name = path;
+#endif
+        std::lock_guard<std::mutex> lock(iFileIdMutex);
+        auto result = iFileId.emplace(name,uint32(iFileId.size() + 1));
+        return result.first->second;
+        }
+
+    /** Find the block at aPosition in a file, which must be a multiple of the block size; return null if it is not in the cache. */
+    std::shared_ptr<CSharedFileBuffer> Find(uint32 aFileId,int64 aPosition)
+        {
+        TSharedFileBufferKey key;
+        key.iFileId = aFileId;
+        key.iPosition = aPosition;
+        std::shared_ptr<CSharedFileBuffer> p = iCache.Find(key);
+        if (p)
+            iHitCount++;
+        else
+            iMissCount++;
+        return p;
+        }
+
+    /**
+    Return true if the block at aPosition in a file is in the cache. Neither the hit and miss counts nor the order in which
+    blocks are discarded are affected, so checking for blocks does not keep them in the cache.
+    */
+    bool Contains(uint32 aFileId,int64 aPosition)
+        {
+        TSharedFileBufferKey key;
+        key.iFileId = aFileId;
+        key.iPosition = aPosition;
+        return iCache.Contains(key);
+        }
+
+    /**
+    Read the block at aPosition, which must be a multiple of the block size, from aFile, which has the identifier aFileId
+    and the length aFileLength, add it to the cache and return it.
+    */
+    std::shared_ptr<CSharedFileBuffer> Load(TResult& aError,CBinaryInputFile& aFile,uint32 aFileId,int64 aPosition,int64 aFileLength)
+        {
+        if (aPosition < 0 || aPosition >= aFileLength || aPosition % int64(iBlockSize))
+            {
+            aError = KErrorInvalidArgument;
+            return nullptr;
+            }
+        size_t size = size_t(std::min(int64(iBlockSize),aFileLength - aPosition));
+        std::shared_ptr<CSharedFileBuffer> buffer(new CSharedFileBuffer(aFileId,aPosition,size));
+        aError = aFile.ReadAt(buffer->iData.data(),size,aPosition) == size ? KErrorNone : KErrorIo;
+        if (!aError)
+            aError = iCache.Add(buffer);
+        if (aError)
+            buffer.reset();
+        return buffer;
+        }
+
+    /**
+    Read several blocks, at positions which must be multiples of the block size, from aFile, which has the identifier aFileId
+    and the length aFileLength, and add them to the cache. The blocks are read using CIoUringFileReader::ReadBatch,
+    which can submit all the reads at once. Positions outside the file are ignored.
+    */
+    TResult LoadBatch(CBinaryInputFile& aFile,uint32 aFileId,const std::vector<int64>& aPosition,int64 aFileLength)
+        {
+        std::vector<std::shared_ptr<CSharedFileBuffer>> buffer_array;
+        std::vector<TFileReadRequest> request_array;
+        for (int64 pos : aPosition)
+            {
+            if (pos < 0 || pos >= aFileLength || pos % int64(iBlockSize))
+                continue;
+            size_t size = size_t(std::min(int64(iBlockSize),aFileLength - pos));
+            buffer_array.emplace_back(new CSharedFileBuffer(aFileId,pos,size));
+            TFileReadRequest r;
+            r.iBuffer = buffer_array.back()->iData.data();
+            r.iSize = size;
+            r.iPosition = pos;
+            request_array.push_back(r);
+            }
+        TResult error = CIoUringFileReader::ReadBatch(aFile,request_array.data(),request_array.size());
+        for (size_t i = 0; !error && i < request_array.size(); i++)
+            {
+            if (request_array[i].iBytesRead != request_array[i].iSize)
+                error = KErrorIo;
+            else
+                error = iCache.Add(buffer_array[i]);
+            }
+        return error;
+        }
+
+    /** Add a block to the cache, replacing any block with the same key. */
+    TResult Add(std::shared_ptr<CSharedFileBuffer> aBuffer)
+        {
+        return iCache.Add(aBuffer);
+        }
+
+    /** Discard all the blocks. Blocks in use by streams remain valid until the streams have finished with them. */
+    void Clear() { iCache.Clear(); }
+    /** Set the maximum total size of the blocks in the cache in bytes. */
+    void SetMaxBytes(size_t aMaxBytes) { iCache.SetMaxSize(MaxSize(aMaxBytes)); }
+    /** Return the size of the blocks. */
+    size_t BlockSize() const { return iBlockSize; }
+    /** Return the number of blocks in the cache. */
+    size_t Count() const { return iCache.Count(); }
+    /** Return the number of times a block was found in the cache. */
+    uint64 HitCount() const { return iHitCount; }
+    /** Return the number of times a block was not found in the cache. */
+    uint64 MissCount() const { return iMissCount; }
+    /** Set the hit and miss counts to zero. */
+    void ResetStatistics() { iHitCount = 0; iMissCount = 0; }
+
+    enum
+        {
+        /** The default size of each block in bytes, which is the same as the default buffer size of CFileInputStream. */
+        KDefaultBlockSize = 64 * 1024,
+        /** The default maximum total size of the blocks in bytes. */
+        KDefaultMaxBytes = 64 * 1024 * 1024
+        };
+
+    private:
+    CSharedFileBufferCache(const CSharedFileBufferCache&) = delete;
+    CSharedFileBufferCache& operator=(const CSharedFileBufferCache&) = delete;
+
+    static int32 MaxSize(size_t aMaxBytes)
+        {
+        return aMaxBytes > INT32_MAX ? INT32_MAX : int32(aMaxBytes);
+        }
+
+    size_t iBlockSize;
+    CShardedHashCache<CSharedFileBuffer,TSharedFileBufferKey,TSharedFileBufferKeyHash> iCache;
+    std::mutex iFileIdMutex;
+    std::unordered_map<std::string,uint32> iFileId;
+    std::atomic<uint64> iHitCount { 0 };
+    std::atomic<uint64> iMissCount { 0 };
+    };
+
+/**
+A file input stream that reads through a CSharedFileBufferCache, by default the global one.
+Each stream has its own file handle and position but shares blocks of data with every other stream on the same file.
+The stream keeps a reference to the block containing the data returned by the last call to Read, so the data remains valid
+until the next call to Read even if the block is discarded from the cache.
+*/
+class CSharedFileBufferStream: public MInputStream
+    {
+    public:
+    /** Create a stream to read a file through a shared cache. */
+    static std::unique_ptr<CSharedFileBufferStream> New(TResult& aError,const char* aFileName,CSharedFileBufferCache& aCache = CSharedFileBufferCache::Global())
+        {
+        std::unique_ptr<CSharedFileBufferStream> s(new CSharedFileBufferStream(aCache));
+        aError = s->Construct(aFileName);
+        if (aError)
+            s.reset();
+        return s;
+        }
+
+    /** Create a stream to read a file through a shared cache. */
+    static std::unique_ptr<CSharedFileBufferStream> New(TResult& aError,const MString& aFileName,CSharedFileBufferCache& aCache = CSharedFileBufferCache::Global())
+        {
+        return New(aError,aFileName.CreateUtf8String().c_str(),aCache);
+        }
+
+    /** Create a new stream on the same file, sharing the same cache. */
+    std::unique_ptr<CSharedFileBufferStream> Copy(TResult& aError)
+        {
+        return New(aError,iFileName.c_str(),iCache);
+        }
+
+    // from MInputStream
+    TResult Read(const uint8*& aPointer,size_t& aLength) override
+        {
+        aPointer = nullptr;
+        aLength = 0;
+        if (iPosition >= iLength)
+            return KErrorNone;
+        int64 block_position = iPosition - iPosition % int64(iCache.BlockSize());
+        if (!iBuffer || iBuffer->Position() != block_position)
+            {
+            iBuffer = iCache.Find(iFileId,block_position);
+            if (!iBuffer)
+                {
+                TResult error = 0;
+                iBuffer = iCache.Load(error,iFile,iFileId,block_position,iLength);
+                if (error)
+                    return error;
+                }
+            }
+        size_t offset = size_t(iPosition - block_position);
+        aPointer = iBuffer->Data() + offset;
+        aLength = size_t(iBuffer->Size()) - offset;
+        iPosition += aLength;
+        return KErrorNone;
+        }
+    bool EndOfStream() const override { return iPosition >= iLength; }
+    TResult Seek(int64 aPosition) override
+        {
+        if (aPosition < 0 || aPosition > iLength)
+            return KErrorIo;
+        iPosition = aPosition;
+        return KErrorNone;
+        }
+    int64 Position(TResult& aError) override
+        {
+        aError = KErrorNone;
+        return iPosition;
+        }
+    int64 Length(TResult& aError) override
+        {
+        aError = KErrorNone;
+        return iLength;
+        }
+    const MString* Name() override { return &iName; }
+
+    private:
+    CSharedFileBufferStream(CSharedFileBufferCache& aCache):
+        iCache(aCache)
+        {
+        }
+
+    TResult Construct(const char* aFileName)
+        {
+        iFileName = aFileName;
+        iName.Set(aFileName);
+        TResult error = iFile.Open(aFileName);
+        if (!error)
+            error = iFile.Seek(0,SEEK_END);
+        if (!error)
+            {
+            iLength = iFile.Tell();
+            if (iLength < 0)
+                error = KErrorIo;
+            }
+        if (!error)
+            iFileId = iCache.FileId(aFileName);
+        return error;
+        }
+
+    CSharedFileBufferCache& iCache;
+    CBinaryInputFile iFile;
+    std::string iFileName;
+    CString iName;
+    uint32 iFileId = 0;
+    int64 iLength = 0;
+    int64 iPosition = 0;
+    std::shared_ptr<CSharedFileBuffer> iBuffer;
+    };
+
+}
+
+#endif
@@ -8,6 +8,11 @@ See www.cartotype.com for more information.
 #define CARTOTYPE_STACK_ALLOCATOR_H__
 
 #include <cartotype_types.h>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <string.h>
 
 namespace CartoType
 {
@@ -76,6 +81,271 @@ class CStackAllocator
     uint8* iStackTop = nullptr;
     };
 
+/**
+A stack allocator which keeps its blocks for reuse when it is cleared, so that an allocator cleared after every frame
+stops allocating memory once it has reached the largest size needed.
+
+Objects constructed using New or NewArray have their destructors called, in reverse order of construction,
+when the stack is reset by Clear, so that everything allocated while drawing a frame, for example, can be
+released at once.
+
+This is a separate class from CStackAllocator, which is used by the CartoType library and must keep its layout.
+*/
+class CRecyclingStackAllocator
+    {
+    public:
+    /** Create a stack allocator, optionally keeping blocks for reuse when it is cleared. */
+    explicit CRecyclingStackAllocator(bool aRecycleBlocks = true):
+        iRecycleBlocks(aRecycleBlocks)
+        {
+        }
+
+    ~CRecyclingStackAllocator()
+        {
+        Clear();
+        ReleaseFreeBlocks();
+        }
+
+    /**
+    Free all the memory allocated, calling the destructors of objects created using New and NewArray.
+    If block recycling is enabled the blocks are kept for reuse.
+    */
+    void Clear()
+        {
+        RunDestructors();
+        TBlock* p = iBlockList;
+        while (p)
+            {
+            TBlock* next = p->iNext;
+            if (iRecycleBlocks)
+                {
+                p->iNext = iFreeBlockList;
+                iFreeBlockList = p;
+                }
+            else
+                {
+                delete [] (uint8*)p;
+                iBlockCount--;
+                }
+            p = next;
+            }
+        iBlockList = nullptr;
+        iStackEnd = iStackTop = nullptr;
+        iBytesAllocated = 0;
+        }
+
+    /** Allocate aBytes, rounded up to a multiple of 8. Throws std::bad_alloc if a new block cannot be allocated. */
+    uint8* Alloc(size_t aBytes)
+        {
+        aBytes = (aBytes + 7) & ~size_t(7);
+        if ((size_t)(iStackEnd - iStackTop) < aBytes)
+            {
+            TBlock* new_block = TakeFreeBlock(aBytes);
+            if (!new_block)
+                {
+                size_t new_block_size = aBytes;
+                if (new_block_size < KMinBlockSize)
+                    new_block_size = KMinBlockSize;
+                new_block = (TBlock*)(new uint8[sizeof(TBlock) + new_block_size - 8]);
+                new_block->iSize = new_block_size;
+                iBlockCount++;
+                }
+            new_block->iNext = iBlockList;
+            iBlockList = new_block;
+            iStackTop = new_block->iData;
+            iStackEnd = iStackTop + new_block->iSize;
+            }
+        uint8* p = iStackTop;
+        iStackTop += aBytes;
+        iBytesAllocated += aBytes;
+        if (iBytesAllocated > iPeakBytesAllocated)
+            iPeakBytesAllocated = iBytesAllocated;
+        return p;
+        }
+
+    /** Enable or disable block recycling. Disabling it deletes any blocks kept for reuse. */
+    void SetRecycleBlocks(bool aRecycleBlocks)
+        {
+        iRecycleBlocks = aRecycleBlocks;
+        if (!aRecycleBlocks)
+            ReleaseFreeBlocks();
+        }
+
+    /** Return true if block recycling is enabled. */
+    bool RecycleBlocks() const { return iRecycleBlocks; }
+
+    /** Delete the blocks kept for reuse, for example when memory is low. */
+    void ReleaseFreeBlocks()
+        {
+        while (iFreeBlockList)
+            {
+            TBlock* next = iFreeBlockList->iNext;
+            delete [] (uint8*)iFreeBlockList;
+            iFreeBlockList = next;
+            iBlockCount--;
+            }
+        }
+
+    /** Return the number of bytes allocated since the last call to Clear. */
+    size_t BytesAllocated() const { return iBytesAllocated; }
+    /** Return the largest number of bytes allocated at any time, that is, the high-water mark. */
+    size_t PeakBytesAllocated() const { return iPeakBytesAllocated; }
+    /** Reset the high-water mark to the number of bytes currently allocated. */
+    void ResetPeakBytesAllocated() { iPeakBytesAllocated = iBytesAllocated; }
+    /** Return the number of blocks owned, both in use and kept for reuse. */
+    size_t BlockCount() const { return iBlockCount; }
+
+    /**
+    Return a recycling stack allocator belonging to the current thread, for temporary data on worker threads.
+    It must be cleared only by the outermost user on the thread, and no pointers into it may be passed to other threads.
+    */
+    static CRecyclingStackAllocator& ThreadInstance()
+        {
+        static thread_local CRecyclingStackAllocator allocator;
+        return allocator;
+        }
+
+    /**
+    Allocate and construct an object of type T, passing aArgs to its constructor.
+    If T has a non-trivial destructor it is called by Clear, so objects owning other resources, like strings and vectors
+    using the heap, can be allocated safely. The object must not be deleted by the caller.
+    */
+    template<class T,class... TArgs> T* New(TArgs&&... aArgs)
+        {
+        static_assert(alignof(T) <= 8,"CRecyclingStackAllocator cannot allocate types needing alignment to more than 8 bytes");
+        TDestructor* d = std::is_trivially_destructible<T>::value ? nullptr : (TDestructor*)Alloc(sizeof(TDestructor));
+        T* object = new(Alloc(sizeof(T))) T(std::forward<TArgs>(aArgs)...);
+        if (d)
+            AddDestructor(d,object,1,&Destroy<T>);
+        return object;
+        }
+
+    /**
+    Allocate an array of aCount default-constructed objects of type T.
+    If T has a non-trivial destructor the objects are destroyed by Clear. If a constructor throws an exception,
+    the objects already constructed are destroyed before the exception is passed on.
+    */
+    template<class T> T* NewArray(size_t aCount)
+        {
+        static_assert(alignof(T) <= 8,"CRecyclingStackAllocator cannot allocate types needing alignment to more than 8 bytes");
+        if (aCount > SIZE_MAX / sizeof(T))
+            throw std::bad_alloc();
+        TDestructor* d = std::is_trivially_destructible<T>::value ? nullptr : (TDestructor*)Alloc(sizeof(TDestructor));
+        T* array = (T*)Alloc(sizeof(T) * aCount);
+        size_t i = 0;
+        try
+            {
+            for (; i < aCount; i++)
+                new(array + i) T();
+            }
+        catch (...)
+            {
+            Destroy<T>(array,i);
+            throw;
+            }
+        if (d)
+            AddDestructor(d,array,aCount,&Destroy<T>);
+        return array;
+        }
+
+    /**
+    Copy aCount objects of a trivial type, such as the characters of a string or the points of a contour,
+    and return a pointer to the copy.
+    */
+    template<class T> T* Copy(const T* aData,size_t aCount)
+        {
+        static_assert(std::is_trivial<T>::value,"CRecyclingStackAllocator::Copy can copy only trivial types");
+        static_assert(alignof(T) <= 8,"CRecyclingStackAllocator cannot allocate types needing alignment to more than 8 bytes");
+        if (aCount > SIZE_MAX / sizeof(T))
+            throw std::bad_alloc();
+        T* p = (T*)Alloc(sizeof(T) * aCount);
+        if (aCount)
+            memcpy(p,aData,sizeof(T) * aCount);
+        return p;
+        }
+
+    private:
+    CRecyclingStackAllocator(const CRecyclingStackAllocator&) = delete;
+    CRecyclingStackAllocator& operator=(const CRecyclingStackAllocator&) = delete;
+
+    enum
+        {
+        KMinBlockSize = 4 * 1024 * 1024
+        };
+
+    /** A destructor to be called by Clear, stored on the stack itself. */
+    class TDestructor
+        {
+        public:
+        TDestructor* iNext;
+        void* iObject;
+        size_t iCount;
+        void (*iDestroy)(void* aObject,size_t aCount);
+        };
+
+    template<class T> static void Destroy(void* aObject,size_t aCount)
+        {
+        T* p = (T*)aObject;
+        while (aCount > 0)
+            p[--aCount].~T();
+        }
+
+    void AddDestructor(TDestructor* aDestructor,void* aObject,size_t aCount,void (*aDestroy)(void*,size_t))
+        {
+        aDestructor->iNext = iDestructorList;
+        aDestructor->iObject = aObject;
+        aDestructor->iCount = aCount;
+        aDestructor->iDestroy = aDestroy;
+        iDestructorList = aDestructor;
+        }
+
+    void RunDestructors()
+        {
+        // Destructors may allocate more objects with destructors, so keep going until the list is empty.
+        while (iDestructorList)
+            {
+            TDestructor* d = iDestructorList;
+            iDestructorList = d->iNext;
+            d->iDestroy(d->iObject,d->iCount);
+            }
+        }
+
+    class TBlock
+        {
+        public:
+        TBlock* iNext = nullptr;
+        size_t iSize = 0;
+        uint8 iData[8];
+        };
+
+    /** Take a block big enough for aBytes from the free list, or return null if there is none. */
+    TBlock* TakeFreeBlock(size_t aBytes)
+        {
+        TBlock** p = &iFreeBlockList;
+        while (*p)
+            {
+            if ((*p)->iSize >= aBytes)
+                {
+                TBlock* block = *p;
+                *p = block->iNext;
+                return block;
+                }
+            p = &(*p)->iNext;
+            }
+        return nullptr;
+        }
+
+    TBlock* iBlockList = nullptr;
+    TBlock* iFreeBlockList = nullptr;
+    TDestructor* iDestructorList = nullptr;
+    uint8* iStackEnd = nullptr;
+    uint8* iStackTop = nullptr;
+    bool iRecycleBlocks = true;
+    size_t iBlockCount = 0;
+    size_t iBytesAllocated = 0;
+    size_t iPeakBytesAllocated = 0;
+    };
+
 /** An allocator based on CStackAllocator, to be used with STL containers. */
 template<typename T> struct TStlStackAllocator
     {
@@ -115,6 +385,53 @@ template<typename T> struct TStlStackAllocator
     CStackAllocator& m_alloc;
     };
 
+/** An allocator based on CRecyclingStackAllocator, to be used with STL containers. */
+template<typename T> struct TStlRecyclingStackAllocator
+    {
+    template<typename U> friend struct TStlRecyclingStackAllocator;
+
+    using value_type = T;
+    using pointer = T*;
+
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    explicit TStlRecyclingStackAllocator(CRecyclingStackAllocator& a): m_alloc(a) { }
+
+    template <typename U> TStlRecyclingStackAllocator(TStlRecyclingStackAllocator<U> const& aOther): m_alloc(aOther.m_alloc) { }
+
+    pointer allocate(std::size_t n)
+        {
+        if (n > SIZE_MAX / sizeof(T))
+            throw std::bad_alloc();
+        return (pointer)(m_alloc.Alloc(n * sizeof(T)));
+        }
+
+    void deallocate(pointer,std::size_t)
+        {
+        }
+
+    template <typename U> bool operator==(TStlRecyclingStackAllocator<U> const& aOther) const
+        {
+        return &m_alloc == &aOther.m_alloc;
+        }
+
+    template <typename U> bool operator!=(TStlRecyclingStackAllocator<U> const& aOther) const
+        {
+        return &m_alloc != &aOther.m_alloc;
+        }
+
+    private:
+    CRecyclingStackAllocator& m_alloc;
+    };
+
+/**
+A vector using a recycling stack allocator, for temporary arrays such as contours built while drawing.
+Memory freed when the vector grows is not reused until the allocator is cleared, so reserve the space needed when it is known.
+*/
+template<typename T> using CStackVector = std::vector<T,TStlRecyclingStackAllocator<T>>;
+
 }
 
 /** An overloaded allocator which uses a stack allocator. */
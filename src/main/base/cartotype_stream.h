@@ -15,8 +15,9 @@ See www.cartotype.com for more information.
 #include <string.h>
 #include <stdio.h>
 
-#ifdef __unix__
+#if defined(__unix__) || defined(__APPLE__)
     #include <unistd.h> // to define _POSIX_VERSION
+    #include <errno.h>
 #endif
 
 // Use low-level file i/o on Windows, but not Windows CE, for a small speed improvement (about 5%).
@@ -357,6 +358,20 @@ class TMemoryInputStream: public MInputStream
 	int64 iPosition;
 	};
 
+/** A request to read part of a file, used by CBinaryInputFile::ReadBatch and CIoUringFileReader::ReadBatch. */
+class TFileReadRequest
+    {
+    public:
+    /** The buffer to receive the data. */
+    uint8* iBuffer = nullptr;
+    /** The number of bytes to read. */
+    size_t iSize = 0;
+    /** The position in the file to read from. */
+    int64 iPosition = 0;
+    /** The number of bytes actually read, set by ReadBatch; it is less than iSize only if the end of the file was reached. */
+    size_t iBytesRead = 0;
+    };
+
 #ifdef CARTOTYPE_LOW_LEVEL_FILE_IO
 class CBinaryInputFile
     {
@@ -404,11 +419,11 @@ class CBinaryInputFile
 #if (defined(_MSC_VER) && !defined(_WIN32_WCE))
         return _telli64(iFile);
 #elif defined (__APPLE__)
-        return lseek(aFile,SEEK_SET,0);
+        return lseek(iFile,0,SEEK_CUR);
 #elif defined(_POSIX_VERSION)
-        return lseek64(aFile,SEEK_SET,0);
+        return lseek64(iFile,0,SEEK_CUR);
 #else
-        return lseek(aFile,SEEK_SET,0);
+        return lseek(iFile,0,SEEK_CUR);
 #endif
         }
 
@@ -421,6 +436,46 @@ class CBinaryInputFile
 #endif
         }
 
+    /**
+    Read up to aBufferSize bytes from aPosition, returning the number of bytes read.
+    On POSIX systems the current position is neither used nor changed, so any number of threads may call ReadAt at once.
+    */
+    size_t ReadAt(uint8* aBuffer,size_t aBufferSize,int64 aPosition)
+        {
+#if defined(_MSC_VER)
+        if (_lseeki64(iFile,aPosition,SEEK_SET) != aPosition)
+            return 0;
+        return _read(iFile,aBuffer,(unsigned int)aBufferSize);
+#else
+        size_t total = 0;
+        while (total < aBufferSize)
+            {
+#if defined(__APPLE__)
+            ssize_t n = pread(iFile,aBuffer + total,aBufferSize - total,off_t(aPosition + total));
+#else
+            ssize_t n = pread64(iFile,aBuffer + total,aBufferSize - total,aPosition + total);
+#endif
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                break;
+            total += size_t(n);
+            }
+        return total;
+#endif
+        }
+
+    /** Perform a batch of reads one after another using ReadAt, setting iBytesRead in each request. */
+    TResult ReadBatch(TFileReadRequest* aRequest,size_t aCount)
+        {
+        for (size_t i = 0; i < aCount; i++)
+            aRequest[i].iBytesRead = ReadAt(aRequest[i].iBuffer,aRequest[i].iSize,aRequest[i].iPosition);
+        return KErrorNone;
+        }
+
+    /** Return the file descriptor, for reading the file by other means such as CIoUringFileReader. */
+    int FileDescriptor() const { return iFile; }
+
     private:
     int iFile;
     };
@@ -478,6 +533,50 @@ class CBinaryInputFile
         return fread(aBuffer,1,aBufferSize,iFile);
         }
 
+    /**
+    Read up to aBufferSize bytes from aPosition, returning the number of bytes read.
+    On POSIX systems the current position is neither used nor changed, so any number of threads may call ReadAt at once;
+    elsewhere it seeks and reads, so it is not thread-safe.
+    */
+    size_t ReadAt(uint8* aBuffer,size_t aBufferSize,int64 aPosition)
+        {
+#if defined(_POSIX_VERSION)
+        int fd = fileno(iFile);
+        size_t total = 0;
+        while (total < aBufferSize)
+            {
+#if defined(__APPLE__)
+            ssize_t n = pread(fd,aBuffer + total,aBufferSize - total,off_t(aPosition + total));
+#else
+            ssize_t n = pread64(fd,aBuffer + total,aBufferSize - total,aPosition + total);
+#endif
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                break;
+            total += size_t(n);
+            }
+        return total;
+#else
+        if (Seek(aPosition,SEEK_SET))
+            return 0;
+        return Read(aBuffer,aBufferSize);
+#endif
+        }
+
+    /** Perform a batch of reads one after another using ReadAt, setting iBytesRead in each request. */
+    TResult ReadBatch(TFileReadRequest* aRequest,size_t aCount)
+        {
+        for (size_t i = 0; i < aCount; i++)
+            aRequest[i].iBytesRead = ReadAt(aRequest[i].iBuffer,aRequest[i].iSize,aRequest[i].iPosition);
+        return KErrorNone;
+        }
+
+#if defined(_POSIX_VERSION)
+    /** Return the file descriptor, for reading the file by other means such as CIoUringFileReader, or -1 if the file is not open. */
+    int FileDescriptor() const { return iFile ? fileno(iFile) : -1; }
+#endif
+
     private:
     FILE* iFile = nullptr;
     };
@@ -0,0 +1,227 @@
+/*
+CARTOTYPE_TILE_BITMAP_POOL.H
+Copyright (C) 2017 CartoType Ltd.
+See www.cartotype.com for more information.
+*/
+
+#ifndef CARTOTYPE_TILE_BITMAP_POOL_H__
+#define CARTOTYPE_TILE_BITMAP_POOL_H__
+
+#include <cartotype_framework.h>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <memory>
+#include <vector>
+#include <algorithm>
+
+namespace CartoType
+{
+
+/** A tile drawn as part of a metatile by CTileBitmapPool::MetaTileBitmaps. */
+class TTileBitmapItem
+    {
+    public:
+    /** The x coordinate of the tile in the Google/OpenStreetMap tile numbering system. */
+    int32 m_x = 0;
+    /** The y coordinate of the tile in the Google/OpenStreetMap tile numbering system. */
+    int32 m_y = 0;
+    /** The tile bitmap, or null if it could not be drawn. */
+    std::unique_ptr<CBitmap> m_bitmap;
+    };
+
+/**
+A pool of render contexts for drawing tiles on several threads at once.
+
+CFramework::TileBitmap draws into a bitmap owned by the framework, so a single framework
+can only draw one tile at a time. A CTileBitmapPool holds a fixed number of copies of a framework,
+made using CFramework::Copy, which shares as much as possible of the map data, fonts and style sheets
+with the original. Any thread may call the TileBitmap functions of the pool; each call borrows an idle
+context, waiting if necessary until one becomes free, draws the tile, and returns a bitmap owned by the caller.
+
+The pool must be created after the framework has been fully set up (maps loaded, style sheet chosen,
+resolution set, etc.), because later changes to the original framework are not propagated to the contexts.
+*/
+class CTileBitmapPool
+    {
+    public:
+    /**
+    Create a tile bitmap pool with aContextCount render contexts copied from aFramework.
+    A context count of zero causes one context to be created for each hardware thread.
+    */
+    static std::unique_ptr<CTileBitmapPool> New(TResult& aError,const CFramework& aFramework,size_t aContextCount = 0)
+        {
+        aError = KErrorNone;
+        if (aContextCount == 0)
+            aContextCount = std::thread::hardware_concurrency();
+        if (aContextCount == 0)
+            aContextCount = 1;
+
+        std::unique_ptr<CTileBitmapPool> pool(new CTileBitmapPool);
+        pool->m_context_array.reserve(aContextCount);
+        pool->m_idle_context_array.reserve(aContextCount);
+        for (size_t i = 0; i < aContextCount; i++)
+            {
+            std::unique_ptr<CFramework> context = aFramework.Copy(aError);
+            if (aError)
+                return nullptr;
+            pool->m_idle_context_array.push_back(context.get());
+            pool->m_context_array.push_back(std::move(context));
+            }
+        return pool;
+        }
+
+    /** Draw a tile using the Google/OpenStreetMap tile numbering system, returning a bitmap owned by the caller. */
+    std::unique_ptr<CBitmap> TileBitmap(TResult& aError,int32 aTileSizeInPixels,int32 aZoom,int32 aX,int32 aY,const TTileBitmapParam* aParam = nullptr)
+        {
+        TContext context(*this);
+        return CopyBitmap(aError,context.Framework().TileBitmap(aError,aTileSizeInPixels,aZoom,aX,aY,aParam));
+        }
+
+    /** Draw a tile specified by a quad key, returning a bitmap owned by the caller. */
+    std::unique_ptr<CBitmap> TileBitmap(TResult& aError,int32 aTileSizeInPixels,const CString& aQuadKey,const TTileBitmapParam* aParam = nullptr)
+        {
+        TContext context(*this);
+        return CopyBitmap(aError,context.Framework().TileBitmap(aError,aTileSizeInPixels,aQuadKey,aParam));
+        }
+
+    /** Draw a tile covering an arbitrary rectangle, returning a bitmap owned by the caller. */
+    std::unique_ptr<CBitmap> TileBitmap(TResult& aError,int32 aTileWidth,int32 aTileHeight,const TRectFP& aBounds,TCoordType aCoordType,const TTileBitmapParam* aParam = nullptr)
+        {
+        TContext context(*this);
+        return CopyBitmap(aError,context.Framework().TileBitmap(aError,aTileWidth,aTileHeight,aBounds,aCoordType,aParam));
+        }
+
+    /**
+    Draw a square block of up to aMetaTileSize x aMetaTileSize tiles, with the top left tile at (aX,aY),
+    in a single pass, and slice the result into individual tiles. Map data is fetched and labels are
+    placed once for the whole block, so that labels are continuous across the edges of the tiles inside it.
+    The block is clipped to the edges of the tile grid at zoom level aZoom.
+
+    The tiles are returned in rows, starting at the top left.
+    */
+    std::vector<TTileBitmapItem> MetaTileBitmaps(TResult& aError,int32 aTileSizeInPixels,int32 aZoom,int32 aX,int32 aY,int32 aMetaTileSize,
+                                                 const TTileBitmapParam* aParam = nullptr)
+        {
+        std::vector<TTileBitmapItem> tile_array;
+        aError = KErrorNone;
+        if (aTileSizeInPixels <= 0 || aZoom < 0 || aZoom > 30 || aMetaTileSize <= 0)
+            {
+            aError = KErrorInvalidArgument;
+            return tile_array;
+            }
+        int32 tiles_per_side = 1 << aZoom;
+        if (aX < 0 || aY < 0 || aX >= tiles_per_side || aY >= tiles_per_side)
+            {
+            aError = KErrorInvalidArgument;
+            return tile_array;
+            }
+        int32 columns = std::min(aMetaTileSize,tiles_per_side - aX);
+        int32 rows = std::min(aMetaTileSize,tiles_per_side - aY);
+
+        // Get the bounds of the block in degrees; tiles use the spherical Mercator projection.
+        TRectFP bounds(TileLongitude(aX,tiles_per_side),TileLatitude(aY + rows,tiles_per_side),
+                       TileLongitude(aX + columns,tiles_per_side),TileLatitude(aY,tiles_per_side));
+
+        std::unique_ptr<CBitmap> block;
+            {
+            TContext context(*this);
+            const TBitmap* bitmap = context.Framework().TileBitmap(aError,columns * aTileSizeInPixels,rows * aTileSizeInPixels,bounds,EDegreeCoordType,aParam);
+            block = CopyBitmap(aError,bitmap);
+            }
+        if (aError)
+            return tile_array;
+        if (!block || block->BitsPerPixel() % 8 ||
+            block->Width() != columns * aTileSizeInPixels || block->Height() != rows * aTileSizeInPixels)
+            {
+            aError = KErrorGeneral;
+            return tile_array;
+            }
+
+        // Slice the block into tiles.
+        size_t bytes_per_pixel = block->BitsPerPixel() / 8;
+        size_t tile_row_bytes = bytes_per_pixel * aTileSizeInPixels;
+        tile_array.reserve(rows * columns);
+        for (int32 row = 0; row < rows; row++)
+            for (int32 column = 0; column < columns; column++)
+                {
+                TTileBitmapItem item;
+                item.m_x = aX + column;
+                item.m_y = aY + row;
+                item.m_bitmap.reset(new CBitmap(block->Type(),aTileSizeInPixels,aTileSizeInPixels,0,block->Palette()));
+                const uint8* source = block->Data() + (size_t)row * aTileSizeInPixels * block->RowBytes() + column * tile_row_bytes;
+                uint8* dest = item.m_bitmap->Data();
+                for (int32 y = 0; y < aTileSizeInPixels; y++)
+                    {
+                    memcpy(dest,source,tile_row_bytes);
+                    source += block->RowBytes();
+                    dest += item.m_bitmap->RowBytes();
+                    }
+                tile_array.push_back(std::move(item));
+                }
+        return tile_array;
+        }
+
+    /** Return the number of render contexts in the pool, which is the maximum number of tiles that can be drawn simultaneously. */
+    size_t ContextCount() const { return m_context_array.size(); }
+
+    private:
+    CTileBitmapPool() = default;
+    CTileBitmapPool(const CTileBitmapPool&) = delete;
+    CTileBitmapPool& operator=(const CTileBitmapPool&) = delete;
+
+    /** A render context borrowed from the pool for the lifetime of this object. */
+    class TContext
+        {
+        public:
+        TContext(CTileBitmapPool& aPool):
+            m_pool(aPool)
+            {
+            std::unique_lock<std::mutex> lock(m_pool.m_mutex);
+            while (m_pool.m_idle_context_array.empty())
+                m_pool.m_condition.wait(lock);
+            m_framework = m_pool.m_idle_context_array.back();
+            m_pool.m_idle_context_array.pop_back();
+            }
+        ~TContext()
+            {
+            std::lock_guard<std::mutex> lock(m_pool.m_mutex);
+            m_pool.m_idle_context_array.push_back(m_framework);
+            m_pool.m_condition.notify_one();
+            }
+        CFramework& Framework() { return *m_framework; }
+
+        private:
+        TContext(const TContext&) = delete;
+        TContext& operator=(const TContext&) = delete;
+
+        CTileBitmapPool& m_pool;
+        CFramework* m_framework = nullptr;
+        };
+
+    static double TileLongitude(int32 aX,int32 aTilesPerSide)
+        {
+        return double(aX) / aTilesPerSide * 360.0 - 180.0;
+        }
+
+    static double TileLatitude(int32 aY,int32 aTilesPerSide)
+        {
+        return atan(sinh(KPiDouble * (1.0 - 2.0 * double(aY) / aTilesPerSide))) * KRadiansToDegreesDouble;
+        }
+
+    static std::unique_ptr<CBitmap> CopyBitmap(TResult& aError,const TBitmap* aBitmap)
+        {
+        if (aError || !aBitmap)
+            return nullptr;
+        return std::unique_ptr<CBitmap>(new CBitmap(*aBitmap));
+        }
+
+    std::vector<std::unique_ptr<CFramework>> m_context_array;
+    std::vector<CFramework*> m_idle_context_array;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    };
+
+}
+
+#endif
@@ -243,6 +243,22 @@ template<class T,class K> class CPointerTree
         iCount--;
         }
 
+    /**
+    Prepare to change the key of an item in the tree, by removing it without deleting it.
+    This function and EndKeyChange allow CPointerTree to be used interchangeably with heaps
+    as the open set in TDijkstra.
+    */
+    void BeginKeyChange(T* aNode)
+        {
+        Delete(aNode,true);
+        }
+
+    /** Finish changing the key of an item by reinserting it in the tree. */
+    void EndKeyChange(T* aNode)
+        {
+        Insert(aNode);
+        }
+
     static T* Prev(T* aNode)
         {
         if (aNode->iLeft)
@@ -10,10 +10,14 @@ See www.cartotype.com for more information.
 #include <cartotype_framework.h>
 #include <queue>
 #include <set>
+#include <unordered_map>
+#include <algorithm>
+#include <atomic>
 #include <mutex>
 #include <condition_variable>
 #include <thread>
 #include <memory>
+#include <math.h>
 
 namespace CartoType
 {
@@ -209,6 +213,305 @@ class TTileRequest: public TTileSpec
     uint32 m_generation = 0;
     };
 
+/** A hash function for tile requests, allowing them to be used as keys in a TPriorityTaskQueue. */
+class TTileRequestHash
+    {
+    public:
+    size_t operator()(const TTileRequest& aRequest) const
+        {
+        uint64 h = uint64(uint32(aRequest.m_x)) * 0x9E3779B97F4A7C15ULL;
+        h ^= (uint64(uint32(aRequest.m_y)) + (h << 6) + (h >> 2)) * 0xC2B2AE3D27D4EB4FULL;
+        h ^= (uint64(uint32(aRequest.m_zoom)) << 32 | uint64(aRequest.m_type) << 24 | aRequest.m_generation) * 0x165667B19E3779F9ULL;
+        return size_t(h ^ (h >> 29));
+        }
+    };
+
+/**
+Return the priority of a request for a tile when the view has its center at aCenterX, aCenterY and is at zoom level aZoomLevel.
+The center is given in tile coordinates at zoom level 0: that is, as a fraction of the size of the single tile at that level,
+with axes in the same directions as the tile numbers. Lower values are more urgent: the priority is the distance of the center
+of the tile from the center of the view, in tiles at the tile's zoom level, plus KZoomLevelPriority for each level of difference
+between the tile's zoom level and that of the view.
+*/
+inline double TileRequestPriority(const TTileSpec& aTileSpec,double aCenterX,double aCenterY,double aZoomLevel)
+    {
+    static const double KZoomLevelPriority = 4;
+    double tiles = ldexp(1.0,aTileSpec.m_zoom);
+    double dx = aTileSpec.m_x + 0.5 - aCenterX * tiles;
+    double dy = aTileSpec.m_y + 0.5 - aCenterY * tiles;
+    return sqrt(dx * dx + dy * dy) + KZoomLevelPriority * fabs(aTileSpec.m_zoom - aZoomLevel);
+    }
+
+/**
+A queue of tasks with priorities, to be performed by a fixed number of worker threads.
+
+Lower priority values are more urgent; tasks with equal priorities are started in last-in, first-out order.
+The queue is indexed by a hash table, so a duplicate of a task that is queued or being performed is detected without
+searching the queue, and adding a duplicate with a more urgent priority makes the queued task more urgent.
+
+All the queued tasks are kept in a single heap guarded by one mutex, so StartTask always returns the most urgent task.
+Each operation holds the mutex only briefly: Add and StartTask take logarithmic time, and only Cancel and Reprioritize
+rebuild the heap. When a task is given a new priority its old heap item is left in place and discarded when it reaches the top.
+
+Queued tasks can be cancelled, or given new priorities, when they become obsolete or less urgent:
+for example, when the data used by the task changes, or when the view changes.
+
+This is a separate type from TTaskQueue, which is used by CVectorTileServer and must keep its layout.
+*/
+template<typename T,typename THash = std::hash<T>> class TPriorityTaskQueue
+    {
+    public:
+    /** Create a task queue for aWorkerCount worker threads, numbered from 0. */
+    explicit TPriorityTaskQueue(size_t aWorkerCount):
+        m_worker_count(aWorkerCount ? aWorkerCount : 1)
+        {
+        }
+
+    /** Add a task unless it is already queued or being performed. If it is queued with a less urgent priority, give it the new priority. */
+    void Add(T aRequest,double aPriority = 0)
+        {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto r = m_index.emplace(aRequest,TEntry());
+        TEntry& entry = r.first->second;
+        if (!r.second)
+            {
+            if (entry.m_pending || aPriority >= entry.m_priority)
+                return;
+            }
+        else
+            m_queued_count++;
+        entry.m_priority = aPriority;
+        entry.m_sequence = ++m_sequence;
+
+        // Any item for the old priority is now stale; rebuild the heap if stale items make up most of it.
+        if (m_heap.size() >= KMinRebuildSize && m_heap.size() >= 2 * m_queued_count)
+            RebuildHeap();
+        else
+            {
+            m_heap.push_back(THeapItem { aPriority,entry.m_sequence,aRequest });
+            std::push_heap(m_heap.begin(),m_heap.end());
+            }
+        lock.unlock();
+        m_condition.notify_one();
+        }
+
+    /** Wait for the most urgent task and return it, marking it as being performed. aWorker is the caller's worker number. */
+    T StartTask(size_t /*aWorker*/)
+        {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;)
+            {
+            while (m_heap.empty())
+                m_condition.wait(lock);
+            std::pop_heap(m_heap.begin(),m_heap.end());
+            THeapItem item = std::move(m_heap.back());
+            m_heap.pop_back();
+
+            auto p = m_index.find(item.m_task);
+            if (p != m_index.end() && !p->second.m_pending && p->second.m_sequence == item.m_sequence)
+                {
+                p->second.m_pending = true;
+                m_queued_count--;
+                return item.m_task;
+                }
+            // The item was superseded by one with a different priority.
+            }
+        }
+
+    /** Mark a task as finished, so that it can be added again. */
+    void EndTask(T aRequest)
+        {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto p = m_index.find(aRequest);
+        if (p != m_index.end() && p->second.m_pending)
+            m_index.erase(p);
+        }
+
+    /** Cancel all queued tasks for which aPredicate returns true, and return the number cancelled. Tasks being performed are not affected. */
+    template<typename TPredicate> size_t Cancel(TPredicate aPredicate)
+        {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        size_t cancelled = 0;
+        for (auto p = m_index.begin(); p != m_index.end(); )
+            {
+            if (!p->second.m_pending && aPredicate(p->first))
+                {
+                p = m_index.erase(p);
+                cancelled++;
+                }
+            else
+                ++p;
+            }
+        if (cancelled)
+            {
+            m_queued_count -= cancelled;
+            RebuildHeap();
+            }
+        return cancelled;
+        }
+
+    /**
+    Give every queued task the priority returned by aPriorityFunction, and return the number of tasks cancelled.
+    A task is cancelled if its new priority is negative.
+    */
+    template<typename TPriorityFunction> size_t Reprioritize(TPriorityFunction aPriorityFunction)
+        {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        size_t cancelled = 0;
+        for (auto p = m_index.begin(); p != m_index.end(); )
+            {
+            if (!p->second.m_pending)
+                {
+                double priority = aPriorityFunction(p->first);
+                if (priority < 0)
+                    {
+                    p = m_index.erase(p);
+                    cancelled++;
+                    continue;
+                    }
+                p->second.m_priority = priority;
+                }
+            ++p;
+            }
+        m_queued_count -= cancelled;
+        RebuildHeap();
+        return cancelled;
+        }
+
+    bool Empty() const
+        {
+        return m_queued_count == 0;
+        }
+
+    /** Return the number of tasks queued and not yet started. */
+    size_t QueuedCount() const { return m_queued_count; }
+    /** Return the number of workers. */
+    size_t WorkerCount() const { return m_worker_count; }
+
+    TPriorityTaskQueue(const TPriorityTaskQueue&) = delete;
+    TPriorityTaskQueue& operator=(const TPriorityTaskQueue&) = delete;
+
+    protected:
+    class TEntry
+        {
+        public:
+        double m_priority = 0;
+        uint64 m_sequence = 0;  // identifies the current heap item for a queued task
+        bool m_pending = false; // true if the task is being performed
+        };
+
+    class THeapItem
+        {
+        public:
+        // The item at the top of the heap is the most urgent, and the most recently added of equally urgent items.
+        bool operator<(const THeapItem& aOther) const
+            {
+            if (m_priority != aOther.m_priority)
+                return m_priority > aOther.m_priority;
+            return m_sequence < aOther.m_sequence;
+            }
+
+        double m_priority;
+        uint64 m_sequence;
+        T m_task;
+        };
+
+    static const size_t KMinRebuildSize = 64;
+
+    // Rebuild the heap from the index, discarding stale items. The caller must lock m_mutex.
+    void RebuildHeap()
+        {
+        m_heap.clear();
+        for (const auto& p : m_index)
+            if (!p.second.m_pending)
+                m_heap.push_back(THeapItem { p.second.m_priority,p.second.m_sequence,p.first });
+        std::make_heap(m_heap.begin(),m_heap.end());
+        }
+
+    std::unordered_map<T,TEntry,THash> m_index; // tasks queued or being performed
+    std::vector<THeapItem> m_heap;              // queued tasks, including stale items for superseded priorities
+    size_t m_worker_count;
+    uint64 m_sequence = 0;
+    std::atomic<size_t> m_queued_count { 0 };
+    mutable std::mutex m_mutex; // guards m_index, m_heap and m_sequence
+    std::condition_variable m_condition;
+    };
+
+/**
+A queue of tile requests for a tile server, ordered by the priority given by TileRequestPriority.
+
+The queue owns the current data generation for each type of tile, so that the generation can be changed and the requests made
+for earlier generations cancelled as one atomic step: SetGeneration cancels every queued request with a different generation,
+and Add refuses such requests, so a request can never be queued for data that has already been replaced.
+PrioritizeRequests gives new priorities to the queued requests when the view changes, and cancels those for zoom levels
+too far from that of the view, which become obsolete when the user zooms quickly.
+*/
+class CTileRequestQueue
+    {
+    public:
+    explicit CTileRequestQueue(size_t aWorkerCount):
+        m_queue(aWorkerCount)
+        {
+        }
+
+    /** Queue a request unless it is for an out-of-date generation; return true if it is queued or already queued or being performed. */
+    bool Add(const TTileRequest& aRequest,double aPriority)
+        {
+        std::lock_guard<std::mutex> lock(m_generation_mutex);
+        if (aRequest.m_generation != m_generation[aRequest.m_type])
+            return false;
+        m_queue.Add(aRequest,aPriority);
+        return true;
+        }
+
+    /** Wait for the most urgent request and return it. aWorker is the caller's worker number, from 0 to the worker count minus 1. */
+    TTileRequest StartTask(size_t aWorker) { return m_queue.StartTask(aWorker); }
+    void EndTask(const TTileRequest& aRequest) { m_queue.EndTask(aRequest); }
+
+    /** Return the current data generation for tiles of type aType. */
+    uint32 Generation(TTileSpec::TType aType) const
+        {
+        std::lock_guard<std::mutex> lock(m_generation_mutex);
+        return m_generation[aType];
+        }
+
+    /** Set the data generation for tiles of type aType, cancel the queued requests for other generations, and return the number cancelled. */
+    size_t SetGeneration(TTileSpec::TType aType,uint32 aGeneration)
+        {
+        std::lock_guard<std::mutex> lock(m_generation_mutex);
+        m_generation[aType] = aGeneration;
+        return m_queue.Cancel([aType,aGeneration](const TTileRequest& aRequest)
+            {
+            return aRequest.m_type == aType && aRequest.m_generation != aGeneration;
+            });
+        }
+
+    /**
+    Give queued requests new priorities for a view centered at aCenterX, aCenterY and at zoom level aZoomLevel (see TileRequestPriority),
+    cancelling requests for tiles more than aMaxZoomLevelDifference levels away from the view's zoom level. Return the number of requests cancelled.
+    */
+    size_t PrioritizeRequests(double aCenterX,double aCenterY,double aZoomLevel,double aMaxZoomLevelDifference = 1)
+        {
+        return m_queue.Reprioritize([=](const TTileRequest& aRequest)
+            {
+            if (fabs(aRequest.m_zoom - aZoomLevel) > aMaxZoomLevelDifference)
+                return -1.0;
+            return TileRequestPriority(aRequest,aCenterX,aCenterY,aZoomLevel);
+            });
+        }
+
+    bool Empty() const { return m_queue.Empty(); }
+    size_t QueuedCount() const { return m_queue.QueuedCount(); }
+
+    private:
+    CTileRequestQueue(const CTileRequestQueue&) = delete;
+    CTileRequestQueue& operator=(const CTileRequestQueue&) = delete;
+
+    TPriorityTaskQueue<TTileRequest,TTileRequestHash> m_queue;
+    mutable std::mutex m_generation_mutex; // guards m_generation; taken before the queue's mutex
+    uint32 m_generation[3] = { };
+    };
+
 class TVectorObjectStyle
     {
     public:
@@ -0,0 +1,213 @@
+/*
+CARTOTYPE_WAYPOINT_ORDER.H
+Copyright (C) 2017 CartoType Ltd.
+See www.cartotype.com for more information.
+*/
+
+#ifndef CARTOTYPE_WAYPOINT_ORDER_H__
+#define CARTOTYPE_WAYPOINT_ORDER_H__
+
+#include <cartotype_base.h>
+#include <cartotype_errors.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+namespace CartoType
+{
+
+/** Parameters for CWaypointOrderOptimizer::Optimize. */
+class TWaypointOrderParam
+    {
+    public:
+    /** If true, the first waypoint is always the start of the route. */
+    bool iStartFixed = true;
+    /** If true, the last waypoint is always the end of the route. */
+    bool iEndFixed = false;
+    /** The maximum time to spend improving the order, in milliseconds. Optimization also stops when no more improvements can be found. */
+    int32 iTimeLimitInMilliseconds = 200;
+    };
+
+/**
+Finds a good order in which to visit a set of waypoints, given the costs of travelling between every pair of them,
+as calculated by TDijkstra::CalculateCostMatrix or CCustomizableContractionHierarchy::CostMatrix.
+The costs need not be symmetric.
+
+A route is made by the nearest neighbour method, then improved by local search using 2-opt moves (reversing a sequence of waypoints)
+and Or-opt moves (moving a sequence of one to three waypoints elsewhere), until no move improves the route
+or the time limit is reached. Each move is evaluated in constant time, so routes of a few hundred waypoints can be optimized interactively.
+*/
+class CWaypointOrderOptimizer
+    {
+    public:
+    /**
+    Create an optimizer for aCount waypoints. aCostMatrix contains the cost from waypoint i to waypoint j in aCostMatrix[i * aCount + j];
+    UINT32_MAX means there is no route.
+    */
+    CWaypointOrderOptimizer(const std::vector<uint32>& aCostMatrix,size_t aCount):
+        iCost(aCostMatrix),
+        iCount(aCount)
+        {
+        }
+
+    /**
+    Find a good order for the waypoints, returning it in aOrder as a sequence of waypoint indexes.
+    Returns KErrorInvalidArgument if the cost matrix is the wrong size.
+    */
+    TResult Optimize(const TWaypointOrderParam& aParam,std::vector<uint32>& aOrder)
+        {
+        aOrder.clear();
+        if (iCost.size() != iCount * iCount)
+            return KErrorInvalidArgument;
+        for (size_t i = 0; i < iCount; i++)
+            aOrder.push_back(uint32(i));
+        if (iCount < 3)
+            return KErrorNone;
+
+        iOrder.swap(aOrder);
+        iFirst = aParam.iStartFixed ? 1 : 0;
+        iLast = aParam.iEndFixed ? iCount - 2 : iCount - 1;
+        NearestNeighbour(aParam.iStartFixed);
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(aParam.iTimeLimitInMilliseconds);
+        bool improved = true;
+        while (improved && std::chrono::steady_clock::now() < deadline)
+            {
+            improved = TwoOpt(deadline);
+            if (OrOpt(deadline))
+                improved = true;
+            }
+        iOrder.swap(aOrder);
+        return KErrorNone;
+        }
+
+    /** Return the total cost of visiting the waypoints in the order aOrder, or UINT64_MAX if any leg has no route. */
+    uint64 Cost(const std::vector<uint32>& aOrder) const
+        {
+        uint64 cost = 0;
+        for (size_t i = 1; i < aOrder.size(); i++)
+            {
+            uint32 c = iCost[aOrder[i - 1] * iCount + aOrder[i]];
+            if (c == UINT32_MAX)
+                return UINT64_MAX;
+            cost += c;
+            }
+        return cost;
+        }
+
+    private:
+    /** Costs without routes are treated as very large but finite so that they can be added and compared. */
+    static const int64 KNoRouteCost = int64(1) << 40;
+
+    int64 Leg(uint32 aFrom,uint32 aTo) const
+        {
+        uint32 c = iCost[aFrom * iCount + aTo];
+        return c == UINT32_MAX ? KNoRouteCost : c;
+        }
+
+    /** Return the cost of the leg between positions aFrom and aTo, or zero if either is outside the route. */
+    int64 LegAt(size_t aFrom,size_t aTo) const
+        {
+        if (aFrom >= iCount || aTo >= iCount)
+            return 0;
+        return Leg(iOrder[aFrom],iOrder[aTo]);
+        }
+
+    /** Rebuild the movable part of the route by always going to the nearest unvisited waypoint. */
+    void NearestNeighbour(bool aStartFixed)
+        {
+        size_t start = iFirst;
+        if (!aStartFixed)
+            {
+            // Start at the waypoint with the cheapest route to its nearest neighbour.
+            int64 best = INT64_MAX;
+            for (size_t i = iFirst; i <= iLast; i++)
+                for (size_t j = iFirst; j <= iLast; j++)
+                    if (i != j && Leg(iOrder[i],iOrder[j]) < best)
+                        {
+                        best = Leg(iOrder[i],iOrder[j]);
+                        start = i;
+                        }
+            std::swap(iOrder[iFirst],iOrder[start]);
+            start = iFirst + 1;
+            }
+        for (size_t i = start; i < iLast; i++)
+            {
+            size_t best = i;
+            for (size_t j = i + 1; j <= iLast; j++)
+                if (Leg(iOrder[i - 1],iOrder[j]) < Leg(iOrder[i - 1],iOrder[best]))
+                    best = j;
+            std::swap(iOrder[i],iOrder[best]);
+            }
+        }
+
+    /** Apply improving 2-opt moves: reverse the sequence of waypoints at positions i...j. */
+    bool TwoOpt(std::chrono::steady_clock::time_point aDeadline)
+        {
+        bool improved = false;
+        for (size_t i = iFirst; i < iLast && std::chrono::steady_clock::now() < aDeadline; i++)
+            {
+            // The costs of the legs inside the sequence, forwards and backwards, are accumulated as the sequence grows.
+            int64 forward = 0;
+            int64 backward = 0;
+            int64 before = LegAt(i - 1,i);
+            for (size_t j = i + 1; j <= iLast; j++)
+                {
+                forward += Leg(iOrder[j - 1],iOrder[j]);
+                backward += Leg(iOrder[j],iOrder[j - 1]);
+                int64 old_cost = before + forward + LegAt(j,j + 1);
+                int64 new_cost = (i > 0 ? Leg(iOrder[i - 1],iOrder[j]) : 0) + backward + (j + 1 < iCount ? Leg(iOrder[i],iOrder[j + 1]) : 0);
+                if (new_cost < old_cost)
+                    {
+                    std::reverse(iOrder.begin() + i,iOrder.begin() + j + 1);
+                    improved = true;
+                    forward = backward = 0;
+                    before = LegAt(i - 1,i);
+                    j = i;
+                    }
+                }
+            }
+        return improved;
+        }
+
+    /** Apply improving Or-opt moves: move a sequence of one to three waypoints to another place in the route. */
+    bool OrOpt(std::chrono::steady_clock::time_point aDeadline)
+        {
+        bool improved = false;
+        for (size_t length = 1; length <= 3; length++)
+            for (size_t i = iFirst; i + length - 1 <= iLast && std::chrono::steady_clock::now() < aDeadline; i++)
+                {
+                size_t end = i + length - 1;
+                // The saving made by removing the sequence from its current position.
+                int64 removal = LegAt(i - 1,i) + LegAt(end,end + 1) - (i > 0 && end + 1 < iCount ? Leg(iOrder[i - 1],iOrder[end + 1]) : 0);
+
+                // Try inserting it before each position q outside the sequence, where q == iLast + 1 means at the end of the movable part.
+                for (size_t q = iFirst; q <= iLast + 1; q++)
+                    {
+                    if (q >= i && q <= end + 1)
+                        continue;
+                    int64 insertion = (q > 0 ? Leg(iOrder[q - 1],iOrder[i]) : 0) + (q < iCount ? Leg(iOrder[end],iOrder[q]) : 0) -
+                                      (q > 0 && q < iCount ? Leg(iOrder[q - 1],iOrder[q]) : 0);
+                    if (insertion < removal)
+                        {
+                        std::vector<uint32> sequence(iOrder.begin() + i,iOrder.begin() + end + 1);
+                        iOrder.erase(iOrder.begin() + i,iOrder.begin() + end + 1);
+                        size_t insert_at = q > i ? q - length : q;
+                        iOrder.insert(iOrder.begin() + insert_at,sequence.begin(),sequence.end());
+                        improved = true;
+                        break;
+                        }
+                    }
+                }
+        return improved;
+        }
+
+    const std::vector<uint32>& iCost;
+    size_t iCount;
+    std::vector<uint32> iOrder;
+    size_t iFirst = 0;
+    size_t iLast = 0;
+    };
+
+}
+
+#endif